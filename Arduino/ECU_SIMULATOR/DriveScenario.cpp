@@ -0,0 +1,205 @@
+#include "DriveScenario.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ----------------------------------- Traces -----------------------------------
+
+static const DriveKeyframe IDLE_KEYS[] = {{0, 0}, {60, 0}};
+
+static const DriveKeyframe CITY_KEYS[] = {
+    {0, 0},    {8, 0},    {18, 32},  {35, 32},  {45, 50},  {70, 50},  {82, 0},
+    {95, 0},   {105, 25}, {115, 25}, {125, 45}, {150, 45}, {162, 0},  {180, 0},
+};
+
+static const DriveKeyframe HIGHWAY_KEYS[] = {
+    {0, 0},     {5, 0},     {30, 80},   {50, 100},  {70, 110},  {200, 120}, {215, 95},
+    {240, 95},  {260, 120}, {380, 120}, {400, 60},  {415, 0},   {420, 0},
+};
+
+// Phase lengths and top speeds of WLTP class 3, the stops and peaks in between simplified
+static const DriveKeyframe WLTP_KEYS[] = {
+    // Low, to 589 s, up to 56 km/h
+    {0, 0},      {11, 0},     {25, 24},    {40, 16},    {55, 0},     {70, 0},     {90, 40},    {110, 28},
+    {130, 50},   {150, 35},   {175, 0},    {200, 0},    {230, 45},   {260, 56},   {290, 30},   {320, 0},
+    {350, 0},    {380, 38},   {420, 52},   {460, 20},   {490, 40},   {540, 25},   {570, 0},    {589, 0},
+    // Medium, to 1022 s, up to 77 km/h
+    {610, 35},   {640, 62},   {680, 48},   {720, 76},   {760, 55},   {800, 30},   {830, 0},    {850, 0},
+    {880, 50},   {920, 70},   {960, 45},   {1000, 20},  {1022, 0},
+    // High, to 1477 s, up to 97 km/h
+    {1040, 0},   {1070, 60},  {1110, 85},  {1160, 97},  {1200, 70},  {1250, 90},  {1300, 60},  {1340, 80},
+    {1400, 95},  {1440, 50},  {1477, 0},
+    // Extra high, to 1800 s, up to 131 km/h
+    {1490, 0},   {1530, 70},  {1580, 110}, {1640, 125}, {1700, 131}, {1740, 120}, {1770, 80},  {1790, 20},
+    {1800, 0},
+};
+
+#define TRACE(name, keys) {name, keys, sizeof(keys) / sizeof(keys[0])}
+const DriveTrace TRACE_IDLE = TRACE("idle", IDLE_KEYS);
+const DriveTrace TRACE_CITY = TRACE("city", CITY_KEYS);
+const DriveTrace TRACE_HIGHWAY = TRACE("highway", HIGHWAY_KEYS);
+const DriveTrace TRACE_WLTP = TRACE("wltp", WLTP_KEYS);
+#undef TRACE
+
+const DriveTrace *traceByName(const char *name) {
+  static const DriveTrace *const TRACES[] = {&TRACE_IDLE, &TRACE_CITY, &TRACE_HIGHWAY, &TRACE_WLTP};
+  for (const DriveTrace *trace : TRACES) {
+    if (strcmp(name, trace->name) == 0) return trace;
+  }
+  return nullptr;
+}
+
+uint8_t parseKeyframes(const char *text, DriveKeyframe *out, uint8_t capacity) {
+  uint8_t count = 0;
+  const char *p = text;
+  while (*p) {
+    if (*p == ' ' || *p == ',') {
+      p++;
+      continue;
+    }
+    char *end;
+    long timeS = strtol(p, &end, 10);
+    if (end == p || *end != ':') return 0;
+    p = end + 1;
+    long speed = strtol(p, &end, 10);
+    if (end == p || (*end && *end != ' ' && *end != ',')) return 0;
+    p = end;
+
+    if (count >= capacity || timeS < 0 || timeS > 0xFFFF || speed < 0 || speed > 0xFF) return 0;
+    if (count > 0 && timeS <= out[count - 1].timeS) return 0;
+    out[count++] = {(uint16_t)timeS, (uint8_t)speed};
+  }
+  return count;
+}
+
+// ----------------------------------- Vehicle -----------------------------------
+
+static const float AMBIENT_C = 30.0f;
+static const float IDLE_RPM = 800.0f;
+static const float MASS_KG = 1250.0f;
+static const float ROLLING = 0.012f;         // Rolling resistance coefficient
+static const float DRAG_AREA = 0.7f;         // Cd * frontal area, m²
+static const float MAX_POWER_W = 85000.0f;   // At 6000 rpm, less below
+static const float IDLE_LOAD = 0.12f;        // Friction and accessories
+static const uint8_t GEARS = 5;
+static const float KMH_PER_1000_RPM[GEARS] = {8, 14, 21, 28, 35};
+
+static float clampf(float value, float low, float high) {
+  return value < low ? low : value > high ? high : value;
+}
+
+// First-order approach to target with time constant tauS
+static float follow(float value, float target, float tauS) {
+  float k = SCENARIO_STEP_MS / 1000.0f / tauS;
+  return value + (target - value) * (k < 1 ? k : 1);
+}
+
+void DriveScenario::begin(const DriveTrace &trace, bool loop) {
+  begin(trace.keyframes, trace.count, loop);
+}
+
+void DriveScenario::begin(const DriveKeyframe *keyframes, uint8_t count, bool loop) {
+  _keyframes = keyframes;
+  _count = count;
+  _loop = loop;
+  reset();
+}
+
+void DriveScenario::reset() {
+  _timeMs = 0;
+  _segment = 0;
+  _speedMs = 0;
+  _rpm = IDLE_RPM;
+  _load = IDLE_LOAD;
+  _ectC = AMBIENT_C;
+  _iatC = AMBIENT_C;
+  _gear = 0;
+}
+
+uint32_t DriveScenario::durationMs() const {
+  return _count ? _keyframes[_count - 1].timeS * 1000UL : 0;
+}
+
+float DriveScenario::targetSpeedKmh() const {
+  if (_count == 0) return 0;
+  uint32_t duration = durationMs();
+  uint32_t t = duration == 0 ? 0 : _loop ? _timeMs % duration : (_timeMs < duration ? _timeMs : duration);
+  if (_segment + 1 >= _count) return _keyframes[_count - 1].speedKmh;
+
+  const DriveKeyframe &a = _keyframes[_segment];
+  const DriveKeyframe &b = _keyframes[_segment + 1];
+  float fraction = (t - a.timeS * 1000.0f) / ((b.timeS - a.timeS) * 1000.0f);
+  return a.speedKmh + (b.speedKmh - a.speedKmh) * clampf(fraction, 0, 1);
+}
+
+void DriveScenario::advanceTo(uint32_t timeMs) {
+  while ((int32_t)(timeMs - _timeMs) >= SCENARIO_STEP_MS) step();
+}
+
+void DriveScenario::step() {
+  const float dt = SCENARIO_STEP_MS / 1000.0f;
+  _timeMs += SCENARIO_STEP_MS;
+
+  // Keyframe segment of the new time, from the start again when the trace loops
+  uint32_t duration = durationMs();
+  if (duration) {
+    uint32_t t = _loop ? _timeMs % duration : _timeMs;
+    if (_loop && t < (_timeMs - SCENARIO_STEP_MS) % duration) _segment = 0;  // Wrapped
+    while (_segment + 1 < _count && _keyframes[_segment + 1].timeS * 1000UL <= t) _segment++;
+  }
+  float target = targetSpeedKmh() / 3.6f;
+
+  // Driver closes the gap in about two seconds, as far as the car allows
+  float maxAccel = clampf(2.5f - _speedMs * 0.04f, 0.5f, 2.5f);
+  float accel = clampf((target - _speedMs) / 2.0f, -3.5f, maxAccel);
+  _speedMs += accel * dt;
+  if (_speedMs < 0) _speedMs = 0;
+  float kmh = _speedMs * 3.6f;
+
+  // Gearbox: first gear to pull away, shift up later under load
+  if (_gear == 0 && target > 0.3f) _gear = 1;
+  if (kmh < 2 && target < 0.3f) _gear = 0;
+  if (_gear > 0) {
+    float gearRpm = kmh / KMH_PER_1000_RPM[_gear - 1] * 1000;
+    if (_gear < GEARS && gearRpm > 2400 + 1600 * _load) _gear++;
+    else if (_gear > 1 && gearRpm < 1200) _gear--;
+  }
+  float targetRpm = IDLE_RPM;
+  if (_gear > 0) {
+    float gearRpm = kmh / KMH_PER_1000_RPM[_gear - 1] * 1000;
+    targetRpm = gearRpm > 1300 || _gear > 1 ? gearRpm : 1300;  // Clutch slips in first
+    if (targetRpm < IDLE_RPM) targetRpm = IDLE_RPM;
+  }
+  _rpm = follow(_rpm, targetRpm, 0.2f);
+
+  // Load: power for acceleration, rolling and air drag over what the engine has at this rpm
+  float force = MASS_KG * accel + (_speedMs > 0.1f ? ROLLING * MASS_KG * 9.81f : 0) +
+                0.5f * 1.2f * DRAG_AREA * _speedMs * _speedMs;
+  float power = _gear > 0 ? force * _speedMs / 0.9f : 0;
+  float available = MAX_POWER_W * clampf(_rpm / 6000, 0.15f, 1);
+  float targetLoad = power < 0 ? 0.05f : clampf(IDLE_LOAD + power / available, 0, 1);  // Overrun: fuel cut
+  _load = follow(_load, targetLoad, 0.1f);
+
+  // Coolant warms with the fuel burnt until the thermostat holds it near 90 °C
+  if (_ectC < 88) {
+    _ectC += (0.05f + 0.6f * _load * _rpm / 6000) * dt;
+  } else {
+    _ectC = follow(_ectC, 90 + 8 * _load, 30);
+  }
+  // Intake air heat-soaks when slow, cools with airflow
+  _iatC = follow(_iatC, AMBIENT_C + 14 / (1 + kmh / 20), 40);
+}
+
+EcuState DriveScenario::state() const {
+  EcuState state;
+  state.rpm = (int)lroundf(_rpm);
+  state.tps = (int)lroundf(clampf((_load - 0.1f) / 0.9f, 0, 1) * 100);
+  state.ignitionDeg = (int)lroundf(clampf(8 + 22 * fminf(_rpm / 4000, 1) - 10 * _load, 5, 40));
+  state.iat = _iatC;
+  state.ect = _ectC;
+  state.mbar = (int)lroundf(280 + 730 * _load);
+  state.batt = 13.6f + 0.2f * fminf(_rpm / 2000, 1);
+  state.speed = (int)lroundf(_speedMs * 3.6f);
+  return state;
+}
@@ -0,0 +1,77 @@
+#ifndef DRIVE_SCENARIO_H
+#define DRIVE_SCENARIO_H
+
+#include <stdint.h>
+
+#include "ECU_Responder.h"
+
+#ifndef SCENARIO_STEP_MS
+#define SCENARIO_STEP_MS 10  // Physics step; the same on the R4 and the host, so runs repeat exactly
+#endif
+#ifndef SCENARIO_MAX_KEYFRAMES
+#define SCENARIO_MAX_KEYFRAMES 48  // Keyframes of a trace parsed from text
+#endif
+
+// One point of a drive cycle: the vehicle speed the driver aims for at that
+// time. Speed in between is linear, the car follows it as well as it can.
+struct DriveKeyframe {
+  uint16_t timeS;
+  uint8_t speedKmh;
+};
+
+struct DriveTrace {
+  const char *name;
+  const DriveKeyframe *keyframes;
+  uint8_t count;
+};
+
+// Built-in cycles: idle, city stop-and-go, highway and a shortened trace
+// shaped like WLTP class 3 (low, medium, high, extra high phases)
+extern const DriveTrace TRACE_IDLE;
+extern const DriveTrace TRACE_CITY;
+extern const DriveTrace TRACE_HIGHWAY;
+extern const DriveTrace TRACE_WLTP;
+const DriveTrace *traceByName(const char *name);  // "idle", "city", "highway", "wltp"; nullptr if none
+
+// "<s>:<km/h> <s>:<km/h> ...", times rising; returns the keyframes read, 0 on a syntax error
+uint8_t parseKeyframes(const char *text, DriveKeyframe *out, uint8_t capacity);
+
+// Replays a trace as engine values at a fixed step: longitudinal dynamics
+// (drag, rolling resistance, limited acceleration), a five-speed gearbox,
+// load from the power needed, and coolant / intake temperatures warming up
+// with it. No randomness: the same trace gives the same values at the same
+// scenario time, whatever the caller's clock.
+class DriveScenario {
+ public:
+  void begin(const DriveTrace &trace, bool loop = true);
+  void begin(const DriveKeyframe *keyframes, uint8_t count, bool loop = true);  // Not copied
+  void reset();  // Back to t = 0, cold engine
+
+  // Steps up to timeMs of scenario time. With millis() it runs in real time;
+  // the host can pass a scaled or simulated clock to run faster.
+  void advanceTo(uint32_t timeMs);
+  void step();
+
+  uint32_t timeMs() const { return _timeMs; }
+  bool finished() const { return !_loop && _timeMs >= durationMs(); }
+  uint32_t durationMs() const;
+  float targetSpeedKmh() const;
+  uint8_t gear() const { return _gear; }  // 0 = clutch open / standing
+  EcuState state() const;
+
+ private:
+  const DriveKeyframe *_keyframes = nullptr;
+  uint8_t _count = 0;
+  bool _loop = true;
+
+  uint32_t _timeMs = 0;
+  uint8_t _segment = 0;  // Keyframe at or before the current time
+  float _speedMs = 0;    // m/s
+  float _rpm = 0;
+  float _load = 0;       // 0..1, share of the power available at this rpm
+  float _ectC = 0;
+  float _iatC = 0;
+  uint8_t _gear = 0;
+};
+
+#endif  // DRIVE_SCENARIO_H
@@ -0,0 +1,308 @@
+#include "ECU_Responder.h"
+
+void EcuResponder::setSlowInit(uint8_t address, uint8_t kw1, uint8_t kw2) {
+  _address = address;
+  _kw1 = kw1;
+  _kw2 = kw2;
+}
+
+void EcuResponder::setDTCs(uint8_t mode, uint8_t ecu, const uint16_t *codes, uint8_t count) {
+  if ((mode != 0x03 && mode != 0x07) || ecu > 1) return;
+  if (count > ECU_MAX_DTCS) count = ECU_MAX_DTCS;
+  memcpy(_dtcs[mode == 0x07][ecu], codes, count * sizeof(uint16_t));
+  _dtcCount[mode == 0x07][ecu] = count;
+}
+
+void EcuResponder::reset() {
+  _protocol = ECU_HONDA;
+  _rxLen = 0;
+  _lastByteMs = 0;
+  _txLen = 0;
+  _txPos = 0;
+  _isInit = false;
+  _awaitKw2 = false;
+}
+
+void EcuResponder::onWake(const WakeEvent &event, unsigned long endMs) {
+  if (event.kind == WAKE_NONE) return;
+  if (event.kind == WAKE_5BAUD && event.address != (_address & 0x7F)) return;  // Another module's address
+
+  while (_port->available()) _port->read();  // Break bytes the pulse left in the UART
+  reset();
+
+  switch (event.kind) {
+    case WAKE_HONDA:
+      _protocol = ECU_HONDA;
+      break;
+    case WAKE_FAST_INIT:
+      _protocol = ECU_KWP2000;  // StartCommunication follows
+      break;
+    case WAKE_5BAUD: {
+      _protocol = _kw1 == _kw2 ? ECU_ISO9141 : ECU_KWP2000;
+      const uint8_t sync[3] = {0x55, _kw1, _kw2};
+      queueBytes(sync, sizeof(sync), endMs + SLOW_INIT_W1_MS, SLOW_INIT_W2_MS);
+      _awaitKw2 = true;
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+void EcuResponder::poll(const EcuState &state, unsigned long nowMs) {
+  while (_port->available()) {
+    int v = _port->read();
+    if (v >= 0) {
+      if (_rxLen < sizeof(_rx)) {
+        _rx[_rxLen++] = (uint8_t)v;
+        _lastByteMs = nowMs;
+      } else {
+        _rxLen = 0;
+      }
+    }
+  }
+
+  if (_awaitKw2 && _rxLen > 0) {  // Slow init: the tester inverts KW2, we answer with the inverted address
+    if (_rx[_rxLen - 1] == (uint8_t)~_kw2) {
+      const uint8_t inverted = ~_address;
+      queueBytes(&inverted, 1, nowMs + SLOW_INIT_W4_MS, 0);
+      _awaitKw2 = false;
+      _isInit = true;
+    }
+    _rxLen = 0;
+  }
+
+  bool complete = completeFrame();
+  if ((_rxLen > 0 && (nowMs - _lastByteMs) >= _interByteTimeoutMs) || complete) {
+    if (complete) handleRequest(state, nowMs);
+    _rxLen = 0;
+    _lastByteMs = 0;
+  }
+
+  if (_txPos < _txLen && (long)(nowMs - _txDueMs) >= 0) {
+    if (_txGapMs == 0) {
+      _port->write(_tx + _txPos, _txLen - _txPos);
+      _txPos = _txLen;
+    } else {
+      _port->write(_tx[_txPos++]);
+      _txDueMs += _txGapMs;
+    }
+    _port->flush();
+    if (_txPos == _txLen) _lastResponseMs = nowMs;
+  }
+}
+
+uint8_t EcuResponder::checksum(const uint8_t* d, size_t n) const {
+  return _protocol == ECU_HONDA ? kwp_checksum(d, n) : sum_checksum(d, n);
+}
+
+bool EcuResponder::completeFrame() const {
+  return _rxLen >= 2 && _rx[_rxLen - 1] == checksum(_rx, _rxLen - 1);
+}
+
+void EcuResponder::handleRequest(const EcuState &state, unsigned long nowMs) {
+  if (_protocol == ECU_HONDA) handleHonda(state, nowMs);
+  else handleIso(state, nowMs);
+}
+
+void EcuResponder::handleHonda(const EcuState &state, unsigned long nowMs) {
+  static const uint8_t INIT_REQ[] = {0x72, 0x05, 0x00, 0xF0, 0x99};
+  if (_rxLen == sizeof(INIT_REQ) && memcmp(_rx, INIT_REQ, sizeof(INIT_REQ)) == 0) {
+    static const uint8_t RESP[] = {0x02, 0x04, 0x00};  // 02 04 00 FA, what the reader waits for
+    queueResponse(RESP, sizeof(RESP), nowMs);
+    _isInit = true;
+    return;
+  }
+
+  static const uint8_t LIVE_DATA_REQ[] = {0x72, 0x05, 0x71, 0x17, 0x01};
+  if (!_isInit || _rxLen != sizeof(LIVE_DATA_REQ) || memcmp(_rx, LIVE_DATA_REQ, sizeof(LIVE_DATA_REQ)) != 0) return;
+
+  uint8_t RESP[0x18 - 1] = {0x02, 0x18, 0x71, 0x17};  // 0x18 = whole frame length incl. checksum
+  uint8_t *payload = RESP + 4;
+  const size_t payloadLen = sizeof(RESP) - 4;
+
+  auto u8 = [](int v) -> uint8_t { return (uint8_t)constrain(v, 0, 255); };
+  auto u8f = [&](float v) -> uint8_t { return u8((int)lroundf(v)); };
+
+  memset(payload, 0xFF, payloadLen);
+
+  payload[0] = (state.rpm >> 8) & 0xFF;  // MSB
+  payload[1] = state.rpm & 0xFF;
+  payload[3] = u8(state.tps);
+  payload[4] = u8f((state.ignitionDeg * 2) + 64.0f);
+  payload[5] = u8f(state.iat + 40);
+  payload[7] = u8f(state.ect + 40);
+  payload[9] = u8f(state.mbar / 10.0f);
+  payload[10] = u8f(state.batt * 10.0f);
+  payload[16] = u8(state.speed);
+
+  queueResponse(RESP, sizeof(RESP), nowMs);
+}
+
+// StartCommunication (ISO 14230), mode 01 and, for KWP2000, local identifier
+// block requests after a fast or slow init
+void EcuResponder::handleIso(const EcuState &state, unsigned long nowMs) {
+  uint8_t resp[32];
+  uint8_t n = 0;
+
+  if (_protocol == ECU_KWP2000 && _rxLen == 5 && _rx[0] == 0xC1 && _rx[3] == 0x81) {
+    const uint8_t START_RESP[] = {0x83, 0xF1, 0x10, 0xC1, 0xE9, 0x8F};  // Positive response, keywords 8FE9
+    memcpy(resp, START_RESP, sizeof(START_RESP));
+    n = sizeof(START_RESP);
+    _isInit = true;
+  } else if (_isInit && _rxLen == 6 && _rx[3] == 0x01) {
+    uint8_t data = encodePid(_rx[4], state, resp + 5);
+    if (data == 0) return;  // Unsupported PID, stay silent like most ECUs
+    resp[3] = 0x41;
+    resp[4] = _rx[4];
+    if (_protocol == ECU_KWP2000) {
+      resp[0] = 0x80 | (2 + data);
+      resp[1] = 0xF1;
+      resp[2] = 0x10;
+    } else {
+      resp[0] = 0x48;
+      resp[1] = 0x6B;
+      resp[2] = 0x10;
+    }
+    n = 5 + data;
+  } else if (_isInit && _rxLen == 5 && (_rx[3] == 0x03 || _rx[3] == 0x04 || _rx[3] == 0x07)) {
+    handleDtc(nowMs);
+    return;
+  } else if (_isInit && _protocol == ECU_KWP2000 && _rxLen == 6 && _rx[3] == 0x21) {
+    uint8_t data = encodeLocalId(_rx[4], state, resp + 5);
+    resp[1] = 0xF1;
+    resp[2] = 0x10;
+    resp[4] = _rx[4];
+    if (data == 0) {  // requestOutOfRange
+      resp[0] = 0x83;
+      resp[3] = 0x7F;
+      resp[4] = 0x21;
+      resp[5] = 0x31;
+      n = 6;
+    } else {
+      resp[0] = 0x80 | (2 + data);
+      resp[3] = 0x61;
+      n = 5 + data;
+    }
+  } else {
+    return;
+  }
+
+  resp[n] = checksum(resp, n);
+  queueBytes(resp, n + 1, nowMs + _responseDelayMs, 0);
+}
+
+// Modes 03 / 07: every ECU answers, three codes to a frame padded with 00 00,
+// one frame of padding if it has none. Mode 04 clears both lists.
+void EcuResponder::handleDtc(unsigned long nowMs) {
+  uint8_t mode = _rx[3];
+  uint8_t resp[sizeof(_tx)];
+  uint8_t n = 0;
+
+  if (_refuseDTCs) {
+    const uint8_t refusal[] = {0x7F, mode, 0x22};
+    n = isoFrame(0x10, refusal, sizeof(refusal), resp);
+  } else if (mode == 0x04) {
+    memset(_dtcCount, 0, sizeof(_dtcCount));
+    const uint8_t cleared[] = {0x44};
+    n = isoFrame(0x10, cleared, sizeof(cleared), resp);
+  } else {
+    for (uint8_t ecu = 0; ecu < 2; ecu++) {
+      uint8_t count = _dtcCount[mode == 0x07][ecu];
+      const uint16_t *codes = _dtcs[mode == 0x07][ecu];
+      for (uint8_t first = 0; first == 0 || first < count; first += 3) {
+        uint8_t data[7] = {(uint8_t)(0x40 + mode)};
+        for (uint8_t i = 0; i < 3 && first + i < count; i++) {
+          data[1 + 2 * i] = codes[first + i] >> 8;
+          data[2 + 2 * i] = codes[first + i] & 0xFF;
+        }
+        n += isoFrame(ecu == 0 ? 0x10 : 0x18, data, sizeof(data), resp + n);
+      }
+    }
+  }
+  queueBytes(resp, n, nowMs + _responseDelayMs, 0);
+}
+
+// Header, data and checksum of an answer from source; returns the frame length
+uint8_t EcuResponder::isoFrame(uint8_t source, const uint8_t *data, uint8_t length, uint8_t *out) const {
+  out[0] = _protocol == ECU_KWP2000 ? (0x80 | length) : 0x48;
+  out[1] = _protocol == ECU_KWP2000 ? 0xF1 : 0x6B;
+  out[2] = source;
+  memcpy(out + 3, data, length);
+  out[3 + length] = checksum(out, 3 + length);
+  return 4 + length;
+}
+
+// Mode 01 data bytes of a PID, the inverse of the reader's decodePID(); 0 if not supported
+uint8_t EcuResponder::encodePid(uint8_t pid, const EcuState &state, uint8_t *out) const {
+  static const uint8_t SUPPORTED[] = {0x05, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x11};
+  auto u8f = [](float v) -> uint8_t { return (uint8_t)constrain((long)lroundf(v), 0L, 255L); };
+
+  switch (pid) {
+    case 0x00: {
+      uint32_t mask = 0;
+      for (uint8_t p : SUPPORTED) mask |= 1UL << (32 - p);
+      out[0] = mask >> 24;
+      out[1] = mask >> 16;
+      out[2] = mask >> 8;
+      out[3] = mask;
+      return 4;
+    }
+    case 0x05: out[0] = u8f(state.ect + 40); return 1;
+    case 0x0B: out[0] = u8f(state.mbar / 10.0f); return 1;
+    case 0x0C: {
+      uint16_t raw = (uint16_t)constrain((long)state.rpm * 4, 0L, 65535L);
+      out[0] = raw >> 8;
+      out[1] = raw & 0xFF;
+      return 2;
+    }
+    case 0x0D: out[0] = u8f(state.speed); return 1;
+    case 0x0E: out[0] = u8f((state.ignitionDeg + 64.0f) * 2); return 1;
+    case 0x0F: out[0] = u8f(state.iat + 40); return 1;
+    case 0x11: out[0] = u8f(state.tps * 2.55f); return 1;
+    default: return 0;
+  }
+}
+
+// Record of a readDataByLocalIdentifier block, what the reader's
+// SIMULATOR_BLOCK_01 layout decodes; 0 if there is no such block
+uint8_t EcuResponder::encodeLocalId(uint8_t localId, const EcuState &state, uint8_t *out) const {
+  if (localId != 0x01) return 0;
+  auto u8f = [](float v) -> uint8_t { return (uint8_t)constrain((long)lroundf(v), 0L, 255L); };
+
+  uint16_t rpm = (uint16_t)constrain((long)state.rpm * 4, 0L, 65535L);
+  out[0] = rpm >> 8;
+  out[1] = rpm & 0xFF;
+  out[2] = u8f(state.tps * 2.55f);
+  out[3] = u8f(state.ect + 40);
+  out[4] = u8f(state.iat + 40);
+  out[5] = u8f(state.mbar / 10.0f);
+  out[6] = u8f(state.batt * 10.0f);
+  out[7] = u8f(state.speed);
+  out[8] = u8f((state.ignitionDeg + 64.0f) * 2);
+  out[9] = u8f(state.mbar * 255.0f / 1013.0f);  // Load from MAP, as if at sea level
+  return 10;
+}
+
+bool EcuResponder::queueResponse(const uint8_t* d, size_t cap, unsigned long nowMs) {
+  if (!d || cap < 3) return false;        // [addr,len,data...]
+  uint8_t frameLen = d[1];                // Whole frame length incl. addr, len and checksum
+  if (frameLen < 3) return false;
+  size_t n_wo_cs = (size_t)frameLen - 1;  // addr + len + data
+  if (n_wo_cs > cap || frameLen > sizeof(_tx)) return false;
+
+  uint8_t frame[sizeof(_tx)];
+  memcpy(frame, d, n_wo_cs);
+  frame[n_wo_cs] = kwp_checksum(d, n_wo_cs);
+  queueBytes(frame, frameLen, nowMs + _responseDelayMs, 0);
+  return true;
+}
+
+void EcuResponder::queueBytes(const uint8_t* d, uint8_t n, unsigned long dueMs, uint8_t gapMs) {
+  if (n > sizeof(_tx)) n = sizeof(_tx);
+  memcpy(_tx, d, n);
+  _txLen = n;
+  _txPos = 0;
+  _txGapMs = gapMs;
+  _txDueMs = dueMs;
+}
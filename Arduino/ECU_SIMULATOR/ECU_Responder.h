@@ -0,0 +1,124 @@
+#ifndef ECU_RESPONDER_H
+#define ECU_RESPONDER_H
+
+#include <Arduino.h>
+
+#include "WakeDecoder.h"
+
+// Engine values reported in the Honda table 0x17 answer and the mode 01 PIDs
+struct EcuState {
+  int rpm;
+  int tps;          // %
+  int ignitionDeg;
+  float iat;        // °C
+  float ect;        // °C
+  int mbar;
+  float batt;       // V
+  int speed;        // km/h
+};
+
+// Honda checksum: 0x100 - sum, so the whole frame adds up to 0
+static inline uint8_t kwp_checksum(const uint8_t* d, size_t n) {
+  uint16_t s = 0;
+  for (size_t i = 0; i < n; ++i) s += d[i];
+  return (uint8_t)(0x100 - (s & 0xFF));
+}
+
+static inline bool checksum_complete_frame(const uint8_t* d, size_t n) {
+  if (n < 2) return false;               // Too short to check
+  uint8_t expect = kwp_checksum(d, n-1); // Sum of every byte except the last one
+  return d[n-1] == expect;
+}
+
+// ISO 9141 / ISO 14230 checksum: plain sum
+static inline uint8_t sum_checksum(const uint8_t* d, size_t n) {
+  uint8_t s = 0;
+  for (size_t i = 0; i < n; ++i) s += d[i];
+  return s;
+}
+
+// Slow init timing the simulator answers with (ISO 9141-2 / ISO 14230-2, ms)
+const uint16_t SLOW_INIT_W1_MS = 60;  // End of the address byte to 0x55
+const uint16_t SLOW_INIT_W2_MS = 10;  // 0x55 to KW1 and KW1 to KW2 (W2 / W3)
+const uint16_t SLOW_INIT_W4_MS = 30;  // Inverted KW2 to the inverted address
+
+const uint8_t ECU_MAX_DTCS = 18;  // Per ECU and mode, six answer frames
+
+enum EcuProtocol : uint8_t {
+  ECU_HONDA,    // Honda table reads, 0x100 - sum checksum
+  ECU_KWP2000,  // ISO 14230 fast or slow init, mode 01 in C2 33 F1 frames
+  ECU_ISO9141,  // ISO 9141-2 slow init, mode 01 in 68 6A F1 frames
+};
+
+// Collects requests from the K-Line and answers the Honda init and table 0x17
+// requests, or mode 01 PIDs, DTC modes 03 / 04 / 07 (and KWP2000 block 21 01)
+// after an ISO init. Answers go out responseDelay ms
+// (P2) after the request without blocking the sketch loop. Wake-up patterns
+// come in through onWake(); without one the responder speaks Honda.
+class EcuResponder {
+ public:
+  explicit EcuResponder(Stream &port) : _port(&port) {}
+
+  void setInterByteTimeout(uint16_t ms) { _interByteTimeoutMs = ms; }
+  void setResponseDelay(uint16_t ms) { _responseDelayMs = ms; }
+  // Address answered on a 5-baud init and the keywords sent back. KW1 == KW2
+  // makes it an ISO 9141 ECU (08 08), anything else ISO 14230 (E9 8F).
+  void setSlowInit(uint8_t address, uint8_t kw1, uint8_t kw2);
+  // Codes answered to mode 03 (stored) / 07 (pending) by ECU 0 (address 10)
+  // and ECU 1 (18), three to a frame; mode 04 clears them all. With refusal
+  // on, the DTC modes get 7F <mode> 22 (conditionsNotCorrect) instead.
+  void setDTCs(uint8_t mode, uint8_t ecu, const uint16_t *codes, uint8_t count);
+  void setDTCRefusal(bool refuse) { _refuseDTCs = refuse; }
+  void reset();
+  bool isInit() const { return _isInit; }
+  EcuProtocol protocol() const { return _protocol; }
+  unsigned long lastResponseMs() const { return _lastResponseMs; }
+
+  // A wake-up pattern ended at endMs (may be a little ahead of millis() for 5-baud)
+  void onWake(const WakeEvent &event, unsigned long endMs);
+
+  // Reads what arrived, answers complete requests and sends answers that are due
+  void poll(const EcuState &state, unsigned long nowMs);
+
+ private:
+  Stream *_port;
+  EcuProtocol _protocol = ECU_HONDA;
+
+  uint8_t _rx[128];
+  size_t _rxLen = 0;
+  unsigned long _lastByteMs = 0;
+
+  uint8_t _tx[2 * (ECU_MAX_DTCS / 3) * 11];  // Largest answer: both ECUs with a full DTC list
+  uint8_t _txLen = 0;
+  uint8_t _txPos = 0;
+  uint8_t _txGapMs = 0;  // Between bytes, 0 = all at once
+  unsigned long _txDueMs = 0;
+
+  uint16_t _interByteTimeoutMs = 60;
+  uint16_t _responseDelayMs = 20;
+  bool _isInit = false;
+  unsigned long _lastResponseMs = 0;
+
+  uint8_t _address = 0x33;
+  uint8_t _kw1 = 0xE9;
+  uint8_t _kw2 = 0x8F;
+  bool _awaitKw2 = false;  // Slow init: waiting for the inverted KW2
+
+  uint16_t _dtcs[2][2][ECU_MAX_DTCS];  // [pending][ecu]
+  uint8_t _dtcCount[2][2] = {};
+  bool _refuseDTCs = false;
+
+  uint8_t checksum(const uint8_t* d, size_t n) const;
+  bool completeFrame() const;
+  void handleRequest(const EcuState &state, unsigned long nowMs);
+  void handleHonda(const EcuState &state, unsigned long nowMs);
+  void handleIso(const EcuState &state, unsigned long nowMs);
+  void handleDtc(unsigned long nowMs);
+  uint8_t isoFrame(uint8_t source, const uint8_t *data, uint8_t length, uint8_t *out) const;
+  uint8_t encodePid(uint8_t pid, const EcuState &state, uint8_t *out) const;
+  uint8_t encodeLocalId(uint8_t localId, const EcuState &state, uint8_t *out) const;
+  bool queueResponse(const uint8_t* d, size_t cap, unsigned long nowMs);
+  void queueBytes(const uint8_t* d, uint8_t n, unsigned long dueMs, uint8_t gapMs);
+};
+
+#endif  // ECU_RESPONDER_H
@@ -1,4 +1,7 @@
 #include <LiquidCrystal_I2C.h>
+#include "ECU_Responder.h"
+#include "WakeDecoder.h"
+#include "DriveScenario.h"
 LiquidCrystal_I2C lcd(0x27, 16, 2);
 
 #define btn 8
@@ -9,6 +12,7 @@ LiquidCrystal_I2C lcd(0x27, 16, 2);
 #define minRpm 800
 
 HardwareSerial &Serial10400 = Serial1; 
+EcuResponder ecu(Serial10400);
 const int K_RX_PIN = 0;
 const int K_TX_PIN = 1;
 #define K_SENSE_PIN K_RX_PIN 
@@ -39,6 +43,12 @@ float temp_ect = 30; // เสื้อน้ำ / ใกล้เทอร์
 int ignitionTiming = 0;
 int ignitionDeg = 0;
 
+// ขับตาม drive cycle แทนการหมุน potentiometer: &TRACE_IDLE, &TRACE_CITY, &TRACE_HIGHWAY, &TRACE_WLTP
+// nullptr = ใช้ potentiometer เหมือนเดิม (ค่าเหมือนกันทุกครั้งที่กด B เพราะ step คงที่ 10 ms)
+const DriveTrace *SCENARIO = nullptr;
+DriveScenario scenario;
+long scenarioStartMs = 0;
+
 int lcdTime = 0;
 int lcdRate = 200;
 
@@ -48,38 +58,17 @@ long ingnitionWait = 0;
 
 // ------------------------- ECU Variable -------------------------
 bool wakeup = true;
-bool isInit = false;
 
 int sleepTimeMs = 5000;
 long ecuTimeoutTimeMs = millis();
 int interByteMs = 5;
 int interByteTimeoutMs = 60;
 int interByteTimeMs = millis();
-int toleranceMs = 20;
-
-int LOW_TIME = 70;
-int HIGH_TIME = 120;
-
-int pattern_timeout_ms = 500;
-
-enum PatternState {
-  IDLE_WAIT_HIGH,
-  GOT_FIRST_HIGH,
-  GOT_LOW,
-};
 
-PatternState pstate = IDLE_WAIT_HIGH;
-int lastLevel = -1;
-unsigned long edgeMicros = 0;          // เวลา edge ล่าสุด (us)
-unsigned long lastActivityMillis = 0;  // ใช้ไว้ reset ถ้านิ่งนาน
-unsigned long accHighMs = 0;           // ระยะเวลาช่วง HIGH ที่เพิ่งจบ
-unsigned long accLowMs  = 0;           // ระยะเวลาช่วง LOW ที่เพิ่งจบ
-unsigned long lastLowMs  = 0;
-
-static uint8_t rxBuf[128];
-static size_t  rxLen = 0;
-static unsigned long lastByteMs = 0;
-static unsigned long ecuWakeStartMs = 0;
+EdgeRing kEdges;         // เวลา edge ของสาย K จาก interrupt
+WakeDecoder wakeDecoder; // Honda 70/120 ms, fast init 25/25 ms, 5-baud
+bool kEdgeIrq = false;   // false = บอร์ดนี้ขา K_SENSE_PIN ไม่มี interrupt ใช้ poll ใน loop แทน
+int kLastLevel = HIGH;
 
 static inline float fmap(float x, float inMin, float inMax, float outMin, float outMax) {
   return (float)outMin + (float)(outMax - outMin) * (float)(x - inMin) / (float)(inMax - inMin);
@@ -133,159 +122,56 @@ void speedSimulator() {
 
 // ------------------------- ECU COMMUNICATION ------------------------- 
 
-static inline uint8_t kwp_checksum(const uint8_t* d, size_t n) {
-  uint16_t s = 0;
-  for (size_t i = 0; i < n; ++i) s += d[i];
-  return (uint8_t)(0x100 - (s & 0xFF));
-}
-
-static inline bool checksum_complete_frame(const uint8_t* d, size_t n) {
-  if (n < 2) return false;               // น้อยไปยังตรวจไม่ได้
-  uint8_t expect = kwp_checksum(d, n-1); // คำนวณจากทุกตัว "ยกเว้น" ตัวสุดท้าย
-  return d[n-1] == expect;
+// เก็บเวลา edge ตอนเกิดจริง ไม่ขึ้นกับว่า loop() (LCD, ปุ่ม) ใช้เวลานานแค่ไหน
+void onKLineEdge() {
+  kEdges.push(micros(), digitalRead(K_SENSE_PIN));
 }
 
-static inline bool within(int val, int target, int tol) {
-  return (val >= target - tol) && (val <= target + tol);
-}
-
-static bool send_response(const uint8_t* d, size_t cap) {
-  if (!d || cap < 3) return false;                  // [addr,len,data...]
-  uint8_t byteData = d[1];                          // จำนวนไบต์ใน DATA
-  size_t n_wo_cs = (size_t)2 + (size_t)byteData;    // addr + len + data(L)
-  // if (n_wo_cs + 1 > cap) return false;              // ต้องมีพื้นที่พอสำหรับอ่านและต่อ checksum
-
-  uint8_t cs = kwp_checksum(d, n_wo_cs);
-
-  Serial10400.write(d, n_wo_cs);
-  Serial10400.write(&cs, 1);
-  Serial10400.flush();
-  return true;
+void onWake(const WakeEvent &event) {
+  // endUs ของ 5-baud อาจอยู่หลังเวลาปัจจุบันเล็กน้อย (ตรวจเจอกลาง stop bit)
+  long agoMs = (long)(micros() - event.endUs) / 1000;
+  ecu.onWake(event, millis() - agoMs);
+  wakeup = true;
+  ecuTimeoutTimeMs = millis();
+
+  static const char *const NAMES[] = {"", "Honda", "fast init", "5-baud"};
+  Serial.print(F("WAKE "));
+  Serial.print(NAMES[event.kind]);
+  if (event.kind == WAKE_5BAUD) {
+    Serial.print(F(" 0x"));
+    Serial.print(event.address, HEX);
+    Serial.print(event.parityOdd ? F(" odd parity") : F(" even parity"));
+  }
+  Serial.println();
 }
 
 void ECU_COMM() {
-  int level = digitalRead(K_SENSE_PIN );
-  unsigned long ecuMicros = micros();
   unsigned long ecuMs = millis();
 
-  if (!wakeup) {
-    if (millis() - lastActivityMillis > pattern_timeout_ms) {
-      pstate = IDLE_WAIT_HIGH;
-      accHighMs = accLowMs = 0;
+  if (!kEdgeIrq) {
+    int level = digitalRead(K_SENSE_PIN);
+    if (level != kLastLevel) {
+      kEdges.push(micros(), level);
+      kLastLevel = level;
     }
+  }
 
-    if (level != lastLevel) {
-      unsigned long dur_us = ecuMicros - edgeMicros;
-      unsigned long dur_ms = dur_us / 1000UL;
-      edgeMicros = ecuMicros;
-      lastActivityMillis = millis();
-
-      if (lastLevel == HIGH) {
-        accHighMs = dur_ms;
-
-        if (pstate == IDLE_WAIT_HIGH) {
-          if ((int)accHighMs >= 100) {
-            pstate = GOT_FIRST_HIGH; 
-          } else {
-            pstate = IDLE_WAIT_HIGH;
-          }
-          
-        } else if (pstate == GOT_LOW) {
-          if (within((int)accHighMs, 120 , toleranceMs)) {
-            wakeup = true;
-            ecuTimeoutTimeMs = millis();
-          }
-
-          pstate = IDLE_WAIT_HIGH;
-          accHighMs = accLowMs = 0;
-        }
-
-      } else {
-        accLowMs = dur_ms;
-
-        if (pstate == GOT_FIRST_HIGH) {
-          if (within((int)accLowMs, 70, toleranceMs)) {
-            pstate = GOT_LOW;
-          } else {
-            pstate = IDLE_WAIT_HIGH;
-            accHighMs = accLowMs = 0;
-          }
-        }
-      }
-
-      lastLevel = level;
-    }
-  } else {
-    if (ecuWakeStartMs == 0) ecuWakeStartMs = ecuMs;
-  
-    while (Serial10400.available()) {
-      int v = Serial10400.read();
-      if (v >= 0) {
-        if (rxLen < sizeof(rxBuf)) {
-          rxBuf[rxLen++] = (uint8_t)v;
-          lastByteMs = ecuMs;
-        } else {
-          rxLen = 0;
-        }
-      }
-    }
+  // คำตอบช้าสุดหนึ่งรอบ loop() หลัง pattern จบ ส่วนเวลาของ pattern มาจาก edge
+  WakeEvent event;
+  Edge edge;
+  while (kEdges.pop(edge)) {
+    if (wakeDecoder.edge(edge.timeUs, edge.level, event)) onWake(event);
+  }
+  if (wakeDecoder.poll(micros(), event)) onWake(event);
 
-    if ((rxLen > 0 && (ecuMs - lastByteMs) >= interByteTimeoutMs) || checksum_complete_frame(rxBuf, rxLen)) {
-      bool ok = checksum_complete_frame(rxBuf, rxLen);
-
-      if (ok) {
-        static const uint8_t FE_REQ[] = {0x72, 0x05, 0x00, 0xF0, 0x99};
-        if (rxLen == sizeof(FE_REQ) && memcmp(rxBuf, FE_REQ, sizeof(FE_REQ)) == 0) {
-          static const uint8_t RESP[] = {0x0E, 0x04, 0x72};
-          delay(20);
-          send_response(RESP, sizeof(RESP));
-          isInit = true;
-          ecuWakeStartMs = ecuMs;
-        }
-
-        static const uint8_t LIVE_DATA_REQ[] = {0x72, 0x05, 0x71, 0x17, 0x01};
-        if (isInit) {
-          if (rxLen == sizeof(LIVE_DATA_REQ) && memcmp(rxBuf, LIVE_DATA_REQ, sizeof(LIVE_DATA_REQ)) == 0) {
-            uint8_t RESP[] = {0x02, 0x18, 0x71, 0x17};
-            uint8_t payload[16];
-
-            auto u8 = [](int v) -> uint8_t { return (uint8_t)constrain(v, 0, 255); };
-            auto u8f = [&](float v) -> uint8_t { return u8((int)lroundf(v)); };
-
-            memset(payload, 0xFF, 16);
-
-            uint16_t rpm16 = (uint16_t)constrain((int)rpm, 0, 65535);
-
-            payload[0] = (rpm >> 8) & 0xFF;   // ไบต์สูง (MSB)
-            payload[1] = rpm & 0xFF;
-            payload[3] = u8(tps);
-            payload[4] = u8f((ignitionDeg * 2) + 64.0f);
-            payload[5] = u8f(temp_iat + 40);
-            payload[7] = u8f(temp_ect + 40);
-            payload[9] = u8f(mbar / 10.0f);
-            payload[10] = u8f(batt * 10.0f);
-            payload[16] = u8(speed);
-
-            for (int i = 0; i < 16; i ++) {
-              RESP[i + 4] = payload[i];
-            }
-            
-            send_response(RESP, sizeof(RESP));
-            isInit = true;
-            ecuWakeStartMs = ecuMs;
-          }
-        }
-      }
-      rxLen = 0;
-      lastByteMs = 0;
-    }
+  if (wakeup) {
+    EcuState state = {rpm, tps, ignitionDeg, temp_iat, temp_ect, mbar, batt, speed};
+    ecu.poll(state, ecuMs);
 
     // เอาออก ละ ไม่อยากเพิ่ม Pin มาเช็ค pattern
-    // if (ecuMs - ecuWakeStartMs >= sleepTimeMs) {
+    // if (ecuMs - ecu.lastResponseMs() >= sleepTimeMs) {
     //   wakeup = false;
-    //   ecuWakeStartMs = 0;
-    //   rxLen = 0;
-    //   lastByteMs = 0;
+    //   ecu.reset();
     // }
   }
 }
@@ -295,6 +181,11 @@ void ECU_COMM() {
 void setup() {
   // Serial.begin(9600); // ISO14230 Honda ECU COMUNICATION RATE
   Serial10400.begin(10400);
+  ecu.setInterByteTimeout(interByteTimeoutMs);
+
+  int irq = digitalPinToInterrupt(K_SENSE_PIN);
+  kEdgeIrq = irq != NOT_AN_INTERRUPT;
+  if (kEdgeIrq) attachInterrupt(irq, onKLineEdge, CHANGE);
 
   pinMode(btn , INPUT_PULLUP);
   pinMode(l1 , OUTPUT);
@@ -335,6 +226,11 @@ void loop() {
     speedRpmNow = rpm;
 
     batt += 4.5;
+
+    if (SCENARIO) {
+      scenario.begin(*SCENARIO);
+      scenarioStartMs = timeNow;
+    }
   } else if (start && digitalRead(btn) == LOW) {
     mode = (mode + 1) % 2;
     delay(300);
@@ -356,8 +252,10 @@ void loop() {
         lcd.print("temp ECT : " + (String)(int)temp_ect + " C");
       }
 
-      tempSimulator();
-      speedSimulator();
+      if (!SCENARIO) {
+        tempSimulator();
+        speedSimulator();
+      }
       
       lcdTime = timeNow;
     }
@@ -373,6 +271,21 @@ void loop() {
     }
   }
 
+  if (SCENARIO && start) {
+    scenario.advanceTo(timeNow - scenarioStartMs);
+    EcuState s = scenario.state();
+    rpm = s.rpm;
+    tps = s.tps;
+    ignitionDeg = s.ignitionDeg;
+    mbar = s.mbar;
+    speed = s.speed;
+    temp_iat = s.iat;
+    temp_ect = s.ect;
+    batt = s.batt;
+    ignitionTiming = (int)map(rpm, minRpm, maxRpm, 150, 0);
+    return;
+  }
+
   int torqueB = analogRead(torque);
 
   rpm = (int)map(torqueB ,0, 1023, minRpm, maxRpm);
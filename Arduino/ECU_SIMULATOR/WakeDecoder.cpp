@@ -0,0 +1,132 @@
+#include "WakeDecoder.h"
+
+static inline bool within(uint32_t value, uint32_t target, uint32_t tolerance) {
+  return value + tolerance >= target && value <= target + tolerance;
+}
+
+// ----------------------------------- EdgeRing -----------------------------------
+
+void EdgeRing::push(uint32_t timeUs, uint8_t level) {
+  uint8_t head = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+  uint8_t next = (head + 1) % EDGE_RING_SIZE;
+  if (next == __atomic_load_n(&_tail, __ATOMIC_ACQUIRE)) {
+    _overflows++;
+    return;
+  }
+  _edges[head].timeUs = timeUs;
+  _edges[head].level = level;
+  __atomic_store_n(&_head, next, __ATOMIC_RELEASE);
+}
+
+bool EdgeRing::pop(Edge &edge) {
+  uint8_t tail = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+  if (tail == __atomic_load_n(&_head, __ATOMIC_ACQUIRE)) return false;
+  edge = _edges[tail];
+  __atomic_store_n(&_tail, (uint8_t)((tail + 1) % EDGE_RING_SIZE), __ATOMIC_RELEASE);
+  return true;
+}
+
+// ----------------------------------- WakeDecoder -----------------------------------
+
+void WakeDecoder::reset() {
+  _state = IDLE;
+  _bits = 0;
+  _bitCount = 0;
+}
+
+void WakeDecoder::startLow(uint32_t timeUs) {
+  _state = LOW_PULSE;
+  _startUs = timeUs;
+}
+
+bool WakeDecoder::edge(uint32_t timeUs, uint8_t level, WakeEvent &event) {
+  level = level ? 1 : 0;
+  if (level == _level) {
+    // An edge in between went missing (ring overflow): start over from here
+    _state = IDLE;
+  }
+  uint32_t duration = timeUs - _edgeUs;
+  uint8_t previous = _level;
+  _level = level;
+  _edgeUs = timeUs;
+
+  switch (_state) {
+    case IDLE:
+      if (level == 0) startLow(timeUs);
+      return false;
+
+    case LOW_PULSE:  // Rising edge, duration is the low pulse
+      if (within(duration, FAST_INIT_LOW_US, FAST_INIT_TOLERANCE_US)) {
+        _state = IDLE;
+        event = {WAKE_FAST_INIT, 0, false, timeUs};
+        return true;
+      }
+      if (within(duration, HONDA_LOW_US, HONDA_TOLERANCE_US)) {
+        _state = HONDA_HIGH;
+        return false;
+      }
+      _state = BAUD5;
+      _bits = 0;
+      _bitCount = 0;
+      // Falls through - the low pulse is the start bit plus any 0 data bits
+
+    case BAUD5: {
+      uint32_t count = (duration + BAUD5_BIT_US / 2) / BAUD5_BIT_US;
+      bool idleAfterStop = previous == 1 && _bitCount + count >= 10;  // High from the stop bit on, any length
+      if (!idleAfterStop &&
+          (count == 0 || _bitCount + count > 10 || !within(duration, count * BAUD5_BIT_US, BAUD5_TOLERANCE_US))) {
+        if (level == 0) startLow(timeUs);
+        else _state = IDLE;
+        return false;
+      }
+      bool done = addBits(previous, count, event);
+      if (done || _state != BAUD5) {
+        if (level == 0) startLow(timeUs);  // The next pattern may start right away
+        else _state = IDLE;
+      }
+      return done;
+    }
+
+    case HONDA_HIGH:  // Falling edge, duration is the high pulse
+      if (within(duration, HONDA_HIGH_US, HONDA_TOLERANCE_US)) {
+        _state = IDLE;
+        event = {WAKE_HONDA, 0, false, timeUs};
+        return true;
+      }
+      startLow(timeUs);
+      return false;
+  }
+  return false;
+}
+
+bool WakeDecoder::poll(uint32_t nowUs, WakeEvent &event) {
+  if (_state != BAUD5 || _level == 0) return false;
+
+  // Wait for the middle of the stop bit, then take the rest of the byte as high
+  uint32_t stopMiddleUs = _startUs + 9 * BAUD5_BIT_US + BAUD5_BIT_US / 2;
+  if ((int32_t)(nowUs - stopMiddleUs) < 0) return false;
+
+  bool done = addBits(1, 10 - _bitCount, event);
+  _state = IDLE;
+  return done;
+}
+
+bool WakeDecoder::addBits(uint8_t level, uint32_t count, WakeEvent &event) {
+  if (_bitCount + count > 10) count = 10 - _bitCount;  // Idle high after the stop bit
+  for (uint32_t i = 0; i < count; i++) {
+    if (level) _bits |= 1 << _bitCount;
+    _bitCount++;
+  }
+  if (_bitCount < 10) return false;
+
+  _state = IDLE;
+  bool startBit = _bits & 1;
+  bool stopBit = _bits & (1 << 9);
+  if (startBit || !stopBit) return false;
+
+  uint8_t address = (_bits >> 1) & 0x7F;
+  uint8_t ones = 0;
+  for (uint8_t i = 1; i <= 8; i++) ones += (_bits >> i) & 1;
+  event = {WAKE_5BAUD, address, (ones & 1) != 0, _startUs + 10 * BAUD5_BIT_US};
+  return true;
+}
@@ -0,0 +1,78 @@
+#ifndef WAKE_DECODER_H
+#define WAKE_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Wake-up patterns a tester sends on the K-Line before talking (µs)
+const uint32_t HONDA_LOW_US = 70000;   // Honda: 70 ms low, 120 ms high, then low
+const uint32_t HONDA_HIGH_US = 120000;
+const uint32_t HONDA_TOLERANCE_US = 20000;
+const uint32_t FAST_INIT_LOW_US = 25000;  // ISO 14230 fast init: 25 ms low, 25 ms high
+const uint32_t FAST_INIT_TOLERANCE_US = 5000;
+const uint32_t BAUD5_BIT_US = 200000;  // 5-baud address byte: start, 7 data bits LSB first, parity, stop
+const uint32_t BAUD5_TOLERANCE_US = 20000;
+
+enum WakeKind : uint8_t { WAKE_NONE, WAKE_HONDA, WAKE_FAST_INIT, WAKE_5BAUD };
+
+struct WakeEvent {
+  WakeKind kind;
+  uint8_t address;  // 5-baud: the 7-bit address
+  bool parityOdd;   // 5-baud: address and parity bit hold an odd number of ones (what ISO 9141 asks)
+  uint32_t endUs;   // When the pattern ended; for 5-baud the end of the stop bit
+};
+
+#ifndef EDGE_RING_SIZE
+#define EDGE_RING_SIZE 32
+#endif
+
+struct Edge {
+  uint32_t timeUs;
+  uint8_t level;  // Level the line changed to
+};
+
+// Line edges from the pin-change interrupt to loop(). One writer (the ISR)
+// and one reader; an edge that finds the ring full is dropped and counted.
+class EdgeRing {
+ public:
+  void push(uint32_t timeUs, uint8_t level);
+  bool pop(Edge &edge);
+  uint16_t overflows() const { return _overflows; }
+
+ private:
+  Edge _edges[EDGE_RING_SIZE];
+  uint8_t _head = 0;  // Written by push() only
+  uint8_t _tail = 0;  // Written by pop() only
+  uint16_t _overflows = 0;
+};
+
+// Recognises the Honda wake pattern, the fast-init pulse and a 5-baud address
+// byte from edge times, so the result doesn't depend on how often loop() runs.
+// UART traffic on the same pin is far shorter than any of the pulses and
+// just resets the decoder.
+class WakeDecoder {
+ public:
+  void reset();
+
+  // The line changed to level at timeUs; true and event filled when a pattern completed
+  bool edge(uint32_t timeUs, uint8_t level, WakeEvent &event);
+
+  // Completes a 5-baud byte whose last bits have no edge after them (the
+  // line stays high from the stop bit on). Call it from loop().
+  bool poll(uint32_t nowUs, WakeEvent &event);
+
+ private:
+  enum State : uint8_t { IDLE, LOW_PULSE, HONDA_HIGH, BAUD5 };
+
+  State _state = IDLE;
+  uint8_t _level = 1;
+  uint32_t _edgeUs = 0;   // Time of the last edge
+  uint32_t _startUs = 0;  // Falling edge that started the pattern
+  uint16_t _bits = 0;     // 5-baud bits so far, bit 0 = start bit
+  uint8_t _bitCount = 0;
+
+  void startLow(uint32_t timeUs);
+  bool addBits(uint8_t level, uint32_t count, WakeEvent &event);
+};
+
+#endif  // WAKE_DECODER_H
@@ -0,0 +1,189 @@
+#include "AdaptivePoller.h"
+
+#include <math.h>
+
+static const float ERROR_ALPHA = 0.3f;     // Weight of the newest prediction error
+static const float MAX_STEP = 2.0f;        // Rate changes at most x2 or /2 per reading
+static const float INITIAL_COST_MS = 120;  // Estimate until the first request is measured
+
+static float clampf(float value, float low, float high) {
+  return value < low ? low : value > high ? high : value;
+}
+
+AdaptivePoller::AdaptivePoller(OBD2_KLine &kline) : _kline(&kline) {}
+
+bool AdaptivePoller::addPid(uint8_t pid, float tolerance, float minHz, float maxHz) {
+  int8_t channel = channelForPid(pid);
+  if (channel < 0 || _count >= ADAPTIVE_MAX_PIDS || tolerance <= 0) return false;
+#if KLINE_SUPPORTED_PIDS
+  if (_kline->getSupportedCount(read_LiveData) > 0 && !_kline->isSupported(read_LiveData, pid)) return false;
+#endif
+
+  Entry &entry = _entries[_count++];
+  entry = Entry();
+  entry.pid = pid;
+  entry.channel = channel;
+  entry.tolerance = tolerance;
+  entry.costMs = INITIAL_COST_MS;
+  if (!setLimits(pid, minHz, maxHz)) {
+    _count--;
+    return false;
+  }
+  return true;
+}
+
+bool AdaptivePoller::setLimits(uint8_t pid, float minHz, float maxHz) {
+  if (minHz <= 0 || maxHz < minHz) return false;
+  for (uint8_t i = 0; i < _count; i++) {
+    Entry &entry = _entries[i];
+    if (entry.pid != pid) continue;
+    entry.minHz = minHz;
+    entry.maxHz = maxHz;
+    entry.wantHz = clampf(entry.readings < 2 ? maxHz : entry.wantHz, minHz, maxHz);  // Fast until it has learnt
+    rebalance();
+    return true;
+  }
+  return false;
+}
+
+void AdaptivePoller::clear() {
+  _count = 0;
+}
+
+void AdaptivePoller::setBusShare(uint8_t percent) {
+  _busSharePercent = percent > 100 ? 100 : percent;
+  rebalance();
+}
+
+void AdaptivePoller::setAdaptive(bool adaptive) {
+  _adaptive = adaptive;
+  for (uint8_t i = 0; i < _count; i++) {
+    if (!adaptive) _entries[i].wantHz = _entries[i].maxHz;
+  }
+  rebalance();
+}
+
+bool AdaptivePoller::poll(LiveSample &sample) {
+  uint32_t now = millis();
+
+  // Earn credit for the time that passed, capped at two requests
+  int32_t maxCreditMs = 0;
+  for (uint8_t i = 0; i < _count; i++) {
+    if (_entries[i].costMs * 2 > maxCreditMs) maxCreditMs = (int32_t)(_entries[i].costMs * 2);
+  }
+  // Whole milliseconds only, the rest stays on the clock: called every
+  // millisecond, 90 % of 1 ms would round to nothing each time
+  uint32_t earnedMs = (now - _lastUpdateMs) * _busSharePercent / 100;
+  _creditMs += (int32_t)earnedMs;
+  if (_creditMs >= maxCreditMs || _busSharePercent == 0) {
+    if (_creditMs > maxCreditMs) _creditMs = maxCreditMs;
+    _lastUpdateMs = now;
+  } else {
+    _lastUpdateMs += earnedMs * 100 / _busSharePercent;
+  }
+
+  if (_count == 0 || !_kline->isConnected()) return false;
+
+  // Most overdue: time since its last request in units of its own interval, never asked first
+  uint64_t nowUs = klineTimeUs();
+  int8_t next = -1;
+  float lateness = 0;
+  for (uint8_t i = 0; i < _count; i++) {
+    const Entry &entry = _entries[i];
+    if (entry.skipped) continue;
+    float late = entry.askedUs == 0 ? 1e9f : (nowUs - entry.askedUs) * entry.rateHz / 1e6f;
+    if (late >= 1 && late > lateness) {
+      lateness = late;
+      next = i;
+    }
+  }
+  if (next < 0) return false;
+  Entry &entry = _entries[next];
+  if (_creditMs < (int32_t)entry.costMs) return false;
+
+  float value = _kline->getLiveData(entry.pid);
+  entry.askedUs = nowUs ? nowUs : 1;
+  _requests++;
+
+  // The clock isn't moved on: the time of the request earns its share of
+  // credit on the next call, so the bus is busy for the share, not share / (1 + share)
+  uint32_t costMs = millis() - now;
+  if (costMs == 0) costMs = 1;
+  entry.costMs += ERROR_ALPHA * ((float)costMs - entry.costMs);
+  _creditMs -= costMs;
+
+  if (value == -3) {  // Not supported by the ECU
+    entry.skipped = true;
+    rebalance();
+    return false;
+  }
+  // Negative values can be readings (timing advance), so go by the answer itself
+  const FrameView response = _kline->lastResponse();
+  int8_t index = response.frames().find(0x40 + read_LiveData, entry.pid);
+  if (index < 0 || response.timeUs() < nowUs) return false;  // No answer, asked again after an interval
+
+  uint64_t timeUs = response.frames().frame(index).timeUs;
+  float channelValue = pidValueToChannel(entry.pid, value);
+  learn(entry, timeUs, channelValue);
+  rebalance();
+
+  sample.timeUs = timeUs;
+  sample.validMask = 1 << entry.channel;
+  sample.value[entry.channel] = channelValue;
+  return true;
+}
+
+void AdaptivePoller::learn(Entry &entry, uint64_t timeUs, float value) {
+  float error = 0;
+  if (entry.readings >= 2 && entry.lastUs > entry.previousUs) {
+    float slope = (entry.last - entry.previous) / (float)(entry.lastUs - entry.previousUs);
+    error = fabsf(value - (entry.last + slope * (float)(timeUs - entry.lastUs)));
+  } else if (entry.readings == 1) {
+    error = fabsf(value - entry.last);
+  }
+
+  if (entry.readings >= 1 && timeUs > entry.lastUs) {
+    entry.error = entry.readings == 1 ? error : entry.error + ERROR_ALPHA * (error - entry.error);
+
+    // The error of a straight-line prediction grows with the square of the
+    // interval, so the rate for an error at the tolerance is sqrt(error / tolerance)
+    // times this one. Scaled from what the channel asked for, not from what the
+    // share gave it, so a starved channel still climbs past the others.
+    if (_adaptive && entry.readings >= 2) {
+      float step = clampf(sqrtf(entry.error / entry.tolerance), 1 / MAX_STEP, MAX_STEP);
+      entry.wantHz = clampf(entry.wantHz * step, entry.minHz, entry.maxHz);
+    }
+  }
+
+  entry.previous = entry.last;
+  entry.previousUs = entry.lastUs;
+  entry.last = value;
+  entry.lastUs = timeUs;
+  if (entry.readings < 2) entry.readings++;
+}
+
+// Minimum rates first, what's left of the bus share to the channels that want
+// more in proportion to what they ask for; if even the minimums don't fit,
+// they are all scaled down alike
+void AdaptivePoller::rebalance() {
+  float budgetMs = _busSharePercent * 10.0f;  // Bus time per second
+  float floorMs = 0, demandMs = 0;
+  for (uint8_t i = 0; i < _count; i++) {
+    const Entry &entry = _entries[i];
+    if (entry.skipped) continue;
+    floorMs += entry.minHz * entry.costMs;
+    demandMs += entry.wantHz * entry.costMs;
+  }
+
+  for (uint8_t i = 0; i < _count; i++) {
+    Entry &entry = _entries[i];
+    if (demandMs <= budgetMs) {
+      entry.rateHz = entry.wantHz;
+    } else if (floorMs >= budgetMs) {
+      entry.rateHz = entry.minHz * budgetMs / floorMs;
+    } else {
+      float share = (budgetMs - floorMs) / (demandMs - floorMs);
+      entry.rateHz = entry.minHz + (entry.wantHz - entry.minHz) * share;
+    }
+  }
+}
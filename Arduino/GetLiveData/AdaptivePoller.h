@@ -0,0 +1,77 @@
+#ifndef ADAPTIVE_POLLER_H
+#define ADAPTIVE_POLLER_H
+
+#include "LiveChannels.h"
+#include "OBD2_KLine.h"
+
+#ifndef ADAPTIVE_MAX_PIDS
+#define ADAPTIVE_MAX_PIDS 8  // Mode 01 PIDs one poller schedules
+#endif
+
+// Polls mode 01 PIDs each at its own rate, set by how well the last readings
+// predict the next one. Each reading is compared with the straight line
+// through the two before it; a channel that is off by more than its
+// tolerance is read more often (up to maxHz), one that follows the line is
+// read less often (down to minHz). Rates are shared out so the polls stay
+// within the bus share: every channel gets its minimum first, the rest goes
+// to the channels that ask for more, in proportion. Idle engine: RPM and
+// temperatures slow down; a throttle stab or a gear change pulls TPS, RPM
+// and MAP up within a couple of readings.
+class AdaptivePoller {
+ public:
+  AdaptivePoller(OBD2_KLine &kline);
+
+  // tolerance in the channel unit (LiveChannels.h); false if the PID feeds no
+  // channel, the list is full or the ECU's PID bitmap says it's not supported
+  bool addPid(uint8_t pid, float tolerance, float minHz = 0.2f, float maxHz = 5.0f);
+  bool setLimits(uint8_t pid, float minHz, float maxHz);
+  void clear();
+
+  void setBusShare(uint8_t percent);  // Share of bus time for these polls (default 90 %)
+  void setAdaptive(bool adaptive);    // false = every PID as close to maxHz as the share allows
+
+  // Call from loop(). Reads at most one PID, the one most overdue, and only
+  // when the bus-time budget allows it. True with the reading in sample
+  // (its one channel valid).
+  bool poll(LiveSample &sample);
+
+  uint8_t count() const { return _count; }
+  uint8_t pidAt(uint8_t index) const { return _entries[index].pid; }
+  float rateHz(uint8_t index) const { return _entries[index].rateHz; }
+  float errorAt(uint8_t index) const { return _entries[index].error; }  // Smoothed, channel unit
+  uint32_t requests() const { return _requests; }
+
+ private:
+  struct Entry {
+    uint8_t pid;
+    int8_t channel;
+    bool skipped;       // ECU said no, not polled again
+    uint8_t readings;   // Up to 2, what the prediction can use
+    uint64_t askedUs;   // Last request, answered or not; 0 = never
+    float tolerance;
+    float minHz, maxHz;
+    float wantHz;       // What the prediction error asks for
+    float rateHz;       // What the bus share gives
+    float error;        // |reading - prediction|, EWMA
+    float costMs;       // Bus time per request, EWMA
+    float last, previous;
+    uint64_t lastUs, previousUs;
+  };
+
+  OBD2_KLine *_kline;
+  Entry _entries[ADAPTIVE_MAX_PIDS];
+  uint8_t _count = 0;
+  uint8_t _busSharePercent = 90;
+  bool _adaptive = true;
+  uint32_t _requests = 0;
+
+  // Bus-time budget as in DTCMonitor: credit grows by share * elapsed time
+  // and each request costs the time it kept the bus busy
+  int32_t _creditMs = 0;
+  uint32_t _lastUpdateMs = 0;
+
+  void learn(Entry &entry, uint64_t timeUs, float value);
+  void rebalance();
+};
+
+#endif  // ADAPTIVE_POLLER_H
@@ -0,0 +1,132 @@
+#include "CaptureBuffer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool CaptureBuffer::setWindow(uint8_t preSamples, uint8_t postSamples) {
+  if ((uint16_t)preSamples + 1 + postSamples > CAPTURE_RING_SIZE) return false;
+  _preSamples = preSamples;
+  _postSamples = postSamples;
+  return true;
+}
+
+bool CaptureBuffer::addTrigger(const char *expression) {
+  const char *op = expression;
+  while (*op && !strchr("<>+-~", *op)) op++;
+  if (!*op || op == expression) return false;
+
+  int8_t channel = channelByName(expression, op - expression);
+  if (channel < 0) return false;
+
+  char *end = nullptr;
+  float threshold = strtod(op + 1, &end);
+  if (end == op + 1 || *end) return false;
+
+  return addTrigger(channel, *op, threshold);
+}
+
+bool CaptureBuffer::addTrigger(uint8_t channel, char op, float threshold) {
+  if (_triggerCount >= MAX_TRIGGERS || channel >= CHANNEL_COUNT) return false;
+  _triggers[_triggerCount++] = {channel, op, threshold, true};
+  return true;
+}
+
+void CaptureBuffer::clearTriggers() {
+  _triggerCount = 0;
+}
+
+void CaptureBuffer::onSnapshot(SnapshotHandler handler, void *context) {
+  _handler = handler;
+  _handlerContext = context;
+}
+
+const LiveSample *CaptureBuffer::previous() const {
+  if (_filled == 0) return nullptr;
+  return &_ring[(_head + CAPTURE_RING_SIZE - 1) % CAPTURE_RING_SIZE];
+}
+
+void CaptureBuffer::push(const LiveSample &sample) {
+  // Keep a copy, the slot `before` points to may be overwritten below
+  LiveSample before;
+  const LiveSample *last = previous();
+  if (last) before = *last;
+
+  _ring[_head] = sample;
+  _head = (_head + 1) % CAPTURE_RING_SIZE;
+  if (_filled < CAPTURE_RING_SIZE) _filled++;
+
+  if (_postRemaining > 0 && --_postRemaining == 0) freeze();
+
+  // Triggers are evaluated while capturing too so they stay edge-triggered,
+  // but only fire when no capture is running
+  for (uint8_t i = 0; i < _triggerCount; i++) {
+    if (!evaluate(_triggers[i], sample, last ? &before : nullptr) || isCapturing()) continue;
+
+    char reason[sizeof(_snapshot.reason)];
+    snprintf(reason, sizeof(reason), "%s%c%g", CHANNEL_NAMES[_triggers[i].channel], _triggers[i].op,
+             (double)_triggers[i].threshold);
+    start(reason, sample.timeUs);
+  }
+}
+
+bool CaptureBuffer::trigger(const char *reason) {
+  if (isCapturing()) return false;
+  const LiveSample *last = previous();
+  start(reason, last ? last->timeUs : 0);
+  return true;
+}
+
+bool CaptureBuffer::evaluate(CaptureTrigger &trigger, const LiveSample &sample, const LiveSample *before) {
+  uint16_t bit = 1 << trigger.channel;
+  if (!(sample.validMask & bit)) return false;
+
+  float value = sample.value[trigger.channel];
+  bool hasDelta = before && (before->validMask & bit);
+  float delta = hasDelta ? value - before->value[trigger.channel] : 0.0f;
+  bool condition = false;
+
+  switch (trigger.op) {
+    case TRIGGER_ABOVE: condition = value > trigger.threshold; break;
+    case TRIGGER_BELOW: condition = value < trigger.threshold; break;
+    case TRIGGER_RISE: condition = hasDelta && delta > trigger.threshold; break;
+    case TRIGGER_FALL: condition = hasDelta && -delta > trigger.threshold; break;
+    case TRIGGER_CHANGE: condition = hasDelta && fabsf(delta) > trigger.threshold; break;
+  }
+
+  if (!condition) {
+    trigger.armed = true;
+    return false;
+  }
+  if (!trigger.armed) return false;
+
+  trigger.armed = false;
+  return true;
+}
+
+void CaptureBuffer::start(const char *reason, uint64_t timeUs) {
+  strncpy(_pendingReason, reason, sizeof(_pendingReason) - 1);
+  _pendingReason[sizeof(_pendingReason) - 1] = '\0';
+  _pendingTimeUs = timeUs;
+
+  _postRemaining = _postSamples;
+  if (_postRemaining == 0) freeze();
+}
+
+void CaptureBuffer::freeze() {
+  uint8_t wanted = _preSamples + 1 + _postSamples;
+  uint8_t count = _filled < wanted ? _filled : wanted;
+  uint8_t first = (_head + CAPTURE_RING_SIZE - count) % CAPTURE_RING_SIZE;
+
+  for (uint8_t i = 0; i < count; i++) {
+    _snapshot.samples[i] = _ring[(first + i) % CAPTURE_RING_SIZE];
+  }
+  memcpy(_snapshot.reason, _pendingReason, sizeof(_snapshot.reason));
+  _snapshot.triggerTimeUs = _pendingTimeUs;
+  _snapshot.count = count;
+  _snapshot.triggerIndex = count > _postSamples ? count - 1 - _postSamples : 0;
+  _hasSnapshot = true;
+
+  if (_handler) _handler(_snapshot, _handlerContext);
+}
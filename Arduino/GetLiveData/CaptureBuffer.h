@@ -0,0 +1,83 @@
+#ifndef CAPTURE_BUFFER_H
+#define CAPTURE_BUFFER_H
+
+#include "LiveChannels.h"
+
+#ifndef CAPTURE_RING_SIZE
+#define CAPTURE_RING_SIZE 64  // Samples kept in RAM, pre + 1 + post must fit
+#endif
+
+// Trigger conditions, written as <channel><op><threshold>: "ECT>105", "TPS~25"
+enum TriggerOp : char {
+  TRIGGER_ABOVE = '>',   // value > threshold
+  TRIGGER_BELOW = '<',   // value < threshold
+  TRIGGER_RISE = '+',    // rose by more than threshold since the previous sample
+  TRIGGER_FALL = '-',    // fell by more than threshold since the previous sample
+  TRIGGER_CHANGE = '~',  // moved either way by more than threshold
+};
+
+struct CaptureTrigger {
+  uint8_t channel;
+  char op;
+  float threshold;
+  bool armed;  // Fires on the edge only, re-armed once the condition is false again
+};
+
+struct Snapshot {
+  char reason[24];
+  uint64_t triggerTimeUs;
+  uint8_t triggerIndex;  // samples[triggerIndex] is the sample that fired
+  uint8_t count;
+  LiveSample samples[CAPTURE_RING_SIZE];
+};
+
+typedef void (*SnapshotHandler)(const Snapshot &snapshot, void *context);
+
+// Always-on ring of recent samples. When a trigger fires, the samples before
+// it and the next postSamples after it are frozen into a snapshot.
+class CaptureBuffer {
+ public:
+  static const uint8_t MAX_TRIGGERS = 8;
+
+  bool setWindow(uint8_t preSamples, uint8_t postSamples);
+  bool addTrigger(const char *expression);
+  bool addTrigger(uint8_t channel, char op, float threshold);
+  void clearTriggers();
+  void onSnapshot(SnapshotHandler handler, void *context = nullptr);
+
+  void push(const LiveSample &sample);
+  bool trigger(const char *reason);  // Trigger from outside, e.g. a new DTC
+
+  bool isCapturing() const { return _postRemaining > 0; }
+  bool hasSnapshot() const { return _hasSnapshot; }
+  const Snapshot &lastSnapshot() const { return _snapshot; }
+
+ private:
+  LiveSample _ring[CAPTURE_RING_SIZE];
+  uint8_t _head = 0;  // Next slot to write
+  uint8_t _filled = 0;
+
+  uint8_t _preSamples = 40;
+  uint8_t _postSamples = 20;
+  uint8_t _postRemaining = 0;
+
+  CaptureTrigger _triggers[MAX_TRIGGERS];
+  uint8_t _triggerCount = 0;
+
+  // The running capture's trigger, copied into _snapshot by freeze() so the
+  // last snapshot keeps its own label until the new one replaces it
+  char _pendingReason[sizeof(Snapshot::reason)];
+  uint64_t _pendingTimeUs = 0;
+
+  Snapshot _snapshot;
+  bool _hasSnapshot = false;
+  SnapshotHandler _handler = nullptr;
+  void *_handlerContext = nullptr;
+
+  const LiveSample *previous() const;
+  bool evaluate(CaptureTrigger &trigger, const LiveSample &sample, const LiveSample *before);
+  void start(const char *reason, uint64_t timeUs);
+  void freeze();
+};
+
+#endif  // CAPTURE_BUFFER_H
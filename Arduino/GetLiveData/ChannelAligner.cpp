@@ -0,0 +1,100 @@
+#include "ChannelAligner.h"
+
+#include <string.h>
+
+void ChannelAligner::reset() {
+  memset(_head, 0, sizeof(_head));
+  memset(_count, 0, sizeof(_count));
+  _newestUs = 0;
+  _gridUs = 0;
+}
+
+void ChannelAligner::setGrid(uint32_t periodUs, uint32_t latencyUs) {
+  _periodUs = periodUs;
+  _latencyUs = latencyUs;
+  _gridUs = 0;
+}
+
+void ChannelAligner::push(uint8_t channel, uint64_t timeUs, float value) {
+  if (channel >= CHANNEL_COUNT) return;
+
+  uint8_t count = _count[channel];
+  if (count > 0) {
+    uint8_t last = (_head[channel] + ALIGNER_HISTORY - 1) % ALIGNER_HISTORY;
+    if (timeUs < _history[channel][last].timeUs) return;  // Out of order
+  }
+
+  _history[channel][_head[channel]] = {timeUs, value};
+  _head[channel] = (_head[channel] + 1) % ALIGNER_HISTORY;
+  if (count < ALIGNER_HISTORY) _count[channel] = count + 1;
+
+  if (timeUs > _newestUs) _newestUs = timeUs;
+  if (_gridUs == 0 && _periodUs > 0) _gridUs = roundUp(timeUs);  // First grid point at or after the first reading
+}
+
+void ChannelAligner::push(const LiveSample &sample) {
+  for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+    if (sample.validMask & (1 << ch)) push(ch, sample.timeUs, sample.value[ch]);
+  }
+}
+
+bool ChannelAligner::at(uint64_t timeUs, LiveSample &out) const {
+  out.timeUs = timeUs;
+  out.validMask = 0;
+
+  for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+    // Walk from the newest reading back to the last one at or before timeUs
+    const Reading *before = nullptr;
+    const Reading *after = nullptr;
+    for (uint8_t i = 1; i <= _count[ch]; i++) {
+      const Reading &reading = _history[ch][(_head[ch] + ALIGNER_HISTORY - i) % ALIGNER_HISTORY];
+      if (reading.timeUs <= timeUs) {
+        before = &reading;
+        break;
+      }
+      after = &reading;
+    }
+    if (!before || timeUs - before->timeUs > _maxAgeUs) continue;
+
+    float value = before->value;
+    if (_mode == ALIGN_LINEAR && after && after->timeUs > before->timeUs) {
+      float fraction = (float)(timeUs - before->timeUs) / (float)(after->timeUs - before->timeUs);
+      value += (after->value - before->value) * fraction;
+    }
+    out.value[ch] = value;
+    out.validMask |= 1 << ch;
+  }
+  return out.validMask != 0;
+}
+
+bool ChannelAligner::next(LiveSample &out, bool flush) {
+  if (_periodUs == 0 || _gridUs == 0) return false;
+
+  while (flush ? _gridUs <= _newestUs : _gridUs + _latencyUs <= _newestUs) {
+    uint64_t timeUs = _gridUs;
+    _gridUs += _periodUs;
+    if (at(timeUs, out)) return true;
+
+    // No channel has a value here: jump over the gap to the next reading
+    uint64_t resume = firstReadingAfter(timeUs);
+    if (resume > _gridUs) _gridUs = roundUp(resume);
+  }
+  return false;
+}
+
+uint64_t ChannelAligner::roundUp(uint64_t timeUs) const {
+  uint64_t gridUs = (timeUs + _periodUs - 1) / _periodUs * _periodUs;
+  return gridUs ? gridUs : _periodUs;
+}
+
+uint64_t ChannelAligner::firstReadingAfter(uint64_t timeUs) const {
+  uint64_t first = UINT64_MAX;
+  for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+    for (uint8_t i = 1; i <= _count[ch]; i++) {
+      uint64_t readingUs = _history[ch][(_head[ch] + ALIGNER_HISTORY - i) % ALIGNER_HISTORY].timeUs;
+      if (readingUs <= timeUs) break;
+      if (readingUs < first) first = readingUs;
+    }
+  }
+  return first == UINT64_MAX ? 0 : first;
+}
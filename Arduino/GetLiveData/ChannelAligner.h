@@ -0,0 +1,63 @@
+#ifndef CHANNEL_ALIGNER_H
+#define CHANNEL_ALIGNER_H
+
+#include "LiveChannels.h"
+
+#ifndef ALIGNER_HISTORY
+#define ALIGNER_HISTORY 8  // Readings kept per channel
+#endif
+
+enum AlignMode : uint8_t {
+  ALIGN_HOLD,    // Last reading at or before the record time
+  ALIGN_LINEAR,  // Interpolated between the readings around the record time
+};
+
+// Builds time-aligned records out of channels read at different times.
+// Readings are pushed as answers arrive; the record for time t takes every
+// channel's value at t. Readings of a channel must come in time order.
+class ChannelAligner {
+ public:
+  ChannelAligner() { reset(); }
+
+  void reset();
+  void setMode(AlignMode mode) { _mode = mode; }
+  // A channel whose last reading before t is older than this is left out of the record
+  void setMaxAge(uint32_t us) { _maxAgeUs = us; }
+  // Records every periodUs (on multiples of it) for next(). A record is held
+  // back until a reading latencyUs newer has arrived, so ALIGN_LINEAR has the
+  // reading after it; keep latency below ALIGNER_HISTORY - 1 readings of the
+  // fastest channel or the reading before t is already gone.
+  void setGrid(uint32_t periodUs, uint32_t latencyUs);
+
+  void push(uint8_t channel, uint64_t timeUs, float value);
+  void push(const LiveSample &sample);  // Every valid channel at sample.timeUs
+
+  // Record at timeUs; false if no channel has a value there
+  bool at(uint64_t timeUs, LiveSample &out) const;
+
+  // Next grid record that is ready. flush = true once no more readings will
+  // come, so the records up to the newest reading go out without the latency.
+  bool next(LiveSample &out, bool flush = false);
+
+ private:
+  struct Reading {
+    uint64_t timeUs;
+    float value;
+  };
+
+  Reading _history[CHANNEL_COUNT][ALIGNER_HISTORY];
+  uint8_t _head[CHANNEL_COUNT];   // Slot the next reading goes to
+  uint8_t _count[CHANNEL_COUNT];
+
+  AlignMode _mode = ALIGN_LINEAR;
+  uint32_t _maxAgeUs = 2000000;
+  uint32_t _periodUs = 0;
+  uint32_t _latencyUs = 0;
+  uint64_t _newestUs = 0;
+  uint64_t _gridUs = 0;  // Time of the next grid record, 0 before the first reading
+
+  uint64_t roundUp(uint64_t timeUs) const;  // Grid point at or after timeUs
+  uint64_t firstReadingAfter(uint64_t timeUs) const;
+};
+
+#endif  // CHANNEL_ALIGNER_H
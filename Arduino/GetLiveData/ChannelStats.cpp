@@ -0,0 +1,269 @@
+#include "ChannelStats.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// Histogram range of each channel until setRange() changes it, the usual
+// running range so the bins (and the quantiles) stay narrow
+static const float DEFAULT_RANGE[CHANNEL_COUNT][2] = {
+    {0, 8000},    // RPM
+    {0, 100},     // TPS
+    {40, 120},    // ECT
+    {-10, 70},    // IAT
+    {0, 1100},    // MAP
+    {10, 15},     // BATT
+    {0, 160},     // VSS
+    {0, 16},      // INJ
+    {-10, 50},    // IGN
+    {0, 100},     // IACV
+    {0, 100},     // IACVC
+    {0, 100},     // LOAD
+};
+
+// Readings further apart than this don't count towards the time above a threshold
+static const uint64_t MAX_GAP_US = 2000000;
+
+// ----------------------------------- Accumulator -----------------------------------
+
+void ChannelStats::Accumulator::clear() {
+  memset(this, 0, sizeof(*this));
+}
+
+void ChannelStats::Accumulator::add(float value, uint8_t bin) {
+  count++;
+  float delta = value - mean;
+  mean += delta / count;
+  m2 += delta * (value - mean);
+  if (count == 1 || value < min) min = value;
+  if (count == 1 || value > max) max = value;
+  bins[bin]++;
+}
+
+// Chan et al.: mean and m2 of both sets together
+void ChannelStats::Accumulator::merge(const Accumulator &other) {
+  aboveUs += other.aboveUs;
+  coveredUs += other.coveredUs;
+  if (other.count == 0) return;
+  if (count == 0) {
+    *this = other;
+    return;
+  }
+
+  uint32_t total = count + other.count;
+  float delta = other.mean - mean;
+  mean += delta * other.count / total;
+  m2 += other.m2 + delta * delta * ((float)count * other.count / total);
+  if (other.min < min) min = other.min;
+  if (other.max > max) max = other.max;
+  for (uint8_t i = 0; i < STATS_HISTOGRAM_BINS; i++) bins[i] += other.bins[i];
+  count = total;
+}
+
+// ----------------------------------- ChannelStats -----------------------------------
+
+ChannelStats::ChannelStats() {
+  for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+    _low[ch] = DEFAULT_RANGE[ch][0];
+    _high[ch] = DEFAULT_RANGE[ch][1];
+    _threshold[ch] = NAN;
+  }
+  reset();
+}
+
+void ChannelStats::reset() {
+  for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+    _trip[ch].clear();
+    _lastUs[ch] = 0;
+    _lastValue[ch] = 0;
+  }
+  for (uint8_t w = 0; w < STATS_MAX_WINDOWS; w++) {
+    for (uint8_t s = 0; s < STATS_WINDOW_SLICES; s++) _sliceIndex[w][s] = UINT32_MAX;
+  }
+  _newestUs = 0;
+}
+
+bool ChannelStats::setRange(uint8_t channel, float low, float high) {
+  if (channel >= CHANNEL_COUNT || !(high > low)) return false;
+  _low[channel] = low;
+  _high[channel] = high;
+  return true;
+}
+
+void ChannelStats::setThreshold(uint8_t channel, float threshold) {
+  if (channel < CHANNEL_COUNT) _threshold[channel] = threshold;
+}
+
+int8_t ChannelStats::addWindow(uint32_t seconds) {
+  if (_windowCount >= STATS_MAX_WINDOWS || seconds == 0) return -1;
+  _windowSeconds[_windowCount] = seconds;
+  for (uint8_t s = 0; s < STATS_WINDOW_SLICES; s++) _sliceIndex[_windowCount][s] = UINT32_MAX;
+  return _windowCount++;
+}
+
+uint32_t ChannelStats::windowSeconds(int8_t window) const {
+  return window >= 0 && window < _windowCount ? _windowSeconds[window] : 0;
+}
+
+int8_t ChannelStats::windowBySeconds(uint32_t seconds) const {
+  for (uint8_t w = 0; w < _windowCount; w++) {
+    if (_windowSeconds[w] == seconds) return w;
+  }
+  return -1;
+}
+
+uint8_t ChannelStats::binOf(uint8_t channel, float value) const {
+  float position = (value - _low[channel]) / (_high[channel] - _low[channel]) * STATS_HISTOGRAM_BINS;
+  if (!(position > 0)) return 0;  // NAN too
+  if (position >= STATS_HISTOGRAM_BINS) return STATS_HISTOGRAM_BINS - 1;
+  return (uint8_t)position;
+}
+
+uint32_t ChannelStats::currentSlice(int8_t window, uint64_t timeUs) const {
+  uint64_t sliceUs = (uint64_t)_windowSeconds[window] * 1000000 / STATS_WINDOW_SLICES;
+  return timeUs / sliceUs;
+}
+
+// Slot of the slice timeUs falls in, emptied if it still holds an older slice
+ChannelStats::Accumulator *ChannelStats::sliceFor(int8_t window, uint64_t timeUs) {
+  uint32_t index = currentSlice(window, timeUs);
+  uint8_t slot = index % STATS_WINDOW_SLICES;
+  if (_sliceIndex[window][slot] != index) {
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) _slices[window][slot][ch].clear();
+    _sliceIndex[window][slot] = index;
+  }
+  return _slices[window][slot];
+}
+
+void ChannelStats::push(const LiveSample &sample) {
+  if (sample.timeUs < _newestUs) return;  // Out of order
+  _newestUs = sample.timeUs;
+
+  Accumulator *slices[STATS_MAX_WINDOWS];
+  for (uint8_t w = 0; w < _windowCount; w++) slices[w] = sliceFor(w, sample.timeUs);
+
+  for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+    if (!(sample.validMask & (1 << ch))) continue;
+    float value = sample.value[ch];
+    uint8_t bin = binOf(ch, value);
+
+    // The time since the previous reading goes to the state that reading was in
+    uint64_t elapsed = _lastUs[ch] ? sample.timeUs - _lastUs[ch] : 0;
+    if (elapsed > MAX_GAP_US) elapsed = 0;
+    uint64_t above = _lastValue[ch] > _threshold[ch] ? elapsed : 0;  // False for a NAN threshold
+
+    _trip[ch].add(value, bin);
+    _trip[ch].aboveUs += above;
+    _trip[ch].coveredUs += elapsed;
+    for (uint8_t w = 0; w < _windowCount; w++) {
+      slices[w][ch].add(value, bin);
+      slices[w][ch].aboveUs += above;
+      slices[w][ch].coveredUs += elapsed;
+    }
+
+    _lastUs[ch] = sample.timeUs;
+    _lastValue[ch] = value;
+  }
+}
+
+// Statistics of a channel over a window: the trip, or the slices still inside it
+bool ChannelStats::collect(uint8_t channel, int8_t window, Accumulator &out) const {
+  out.clear();
+  if (channel >= CHANNEL_COUNT) return false;
+  if (window == STATS_TRIP) {
+    out = _trip[channel];
+    return out.count > 0;
+  }
+  if (window < 0 || window >= _windowCount || _newestUs == 0) return false;
+
+  uint32_t current = currentSlice(window, _newestUs);
+  for (uint8_t s = 0; s < STATS_WINDOW_SLICES; s++) {
+    uint32_t index = _sliceIndex[window][s];
+    if (index != UINT32_MAX && index <= current && current - index < STATS_WINDOW_SLICES) {
+      out.merge(_slices[window][s][channel]);
+    }
+  }
+  return out.count > 0;
+}
+
+bool ChannelStats::summary(uint8_t channel, int8_t window, StatsSummary &out) const {
+  Accumulator total;
+  bool any = collect(channel, window, total);
+  out.count = total.count;
+  out.min = total.min;
+  out.max = total.max;
+  out.mean = total.mean;
+  out.stddev = total.count > 1 ? sqrtf(total.m2 / (total.count - 1)) : 0.0f;
+  out.aboveUs = total.aboveUs;
+  out.coveredUs = total.coveredUs;
+  return any;
+}
+
+// Walks the histogram to the bin holding the q-th reading and interpolates
+// inside it; off by at most one bin width
+float ChannelStats::quantile(uint8_t channel, int8_t window, float q) const {
+  Accumulator total;
+  if (!collect(channel, window, total)) return NAN;
+  if (q <= 0) return total.min;
+  if (q >= 1) return total.max;
+
+  float width = (_high[channel] - _low[channel]) / STATS_HISTOGRAM_BINS;
+  float rank = q * total.count;
+  uint32_t below = 0;
+  for (uint8_t i = 0; i < STATS_HISTOGRAM_BINS; i++) {
+    if (below + total.bins[i] >= rank && total.bins[i] > 0) {
+      // Edge bins also hold values outside the range, and no bin holds anything beyond min / max
+      float low = i == 0 ? total.min : fmaxf(_low[channel] + width * i, total.min);
+      float high = i == STATS_HISTOGRAM_BINS - 1 ? total.max : fminf(_low[channel] + width * (i + 1), total.max);
+      return low + (high - low) * (rank - below) / total.bins[i];
+    }
+    below += total.bins[i];
+  }
+  return total.max;
+}
+
+void ChannelStats::histogram(uint8_t channel, int8_t window, uint32_t bins[STATS_HISTOGRAM_BINS]) const {
+  Accumulator total;
+  collect(channel, window, total);
+  memcpy(bins, total.bins, sizeof(total.bins));
+}
+
+static int windowLabel(const ChannelStats &stats, int8_t window, char *out, int capacity) {
+  if (window == STATS_TRIP) return snprintf(out, capacity, "trip");
+  return snprintf(out, capacity, "%lus", (unsigned long)stats.windowSeconds(window));
+}
+
+int ChannelStats::formatSummary(uint8_t channel, int8_t window, char *out, int capacity) const {
+  if (channel >= CHANNEL_COUNT || capacity <= 0) return 0;
+  char label[12];
+  windowLabel(*this, window, label, sizeof(label));
+
+  StatsSummary s;
+  if (!summary(channel, window, s)) {
+    int n = snprintf(out, capacity, "%s %s n:0", CHANNEL_NAMES[channel], label);
+    return n < capacity ? n : capacity - 1;
+  }
+
+  int n = snprintf(out, capacity, "%s %s n:%lu min:%g max:%g mean:%.2f sd:%.2f p50:%.4g p90:%.4g p99:%.4g",
+                   CHANNEL_NAMES[channel], label, (unsigned long)s.count, s.min, s.max, s.mean, s.stddev,
+                   quantile(channel, window, 0.5f), quantile(channel, window, 0.9f), quantile(channel, window, 0.99f));
+  if (!isnan(_threshold[channel]) && n < capacity) {
+    n += snprintf(out + n, capacity - n, " above%g:%.1f/%.1fs", _threshold[channel], s.aboveUs / 1e6f,
+                  s.coveredUs / 1e6f);
+  }
+  return n < capacity ? n : capacity - 1;
+}
+
+int ChannelStats::formatHistogram(uint8_t channel, int8_t window, char *out, int capacity) const {
+  if (channel >= CHANNEL_COUNT || capacity <= 0) return 0;
+  char label[12];
+  windowLabel(*this, window, label, sizeof(label));
+
+  uint32_t bins[STATS_HISTOGRAM_BINS];
+  histogram(channel, window, bins);
+  int n = snprintf(out, capacity, "%s %s %g..%g", CHANNEL_NAMES[channel], label, _low[channel], _high[channel]);
+  for (uint8_t i = 0; i < STATS_HISTOGRAM_BINS && n < capacity; i++) {
+    n += snprintf(out + n, capacity - n, " %lu", (unsigned long)bins[i]);
+  }
+  return n < capacity ? n : capacity - 1;
+}
@@ -0,0 +1,93 @@
+#ifndef CHANNEL_STATS_H
+#define CHANNEL_STATS_H
+
+#include "LiveChannels.h"
+
+#ifndef STATS_HISTOGRAM_BINS
+#define STATS_HISTOGRAM_BINS 16
+#endif
+#ifndef STATS_MAX_WINDOWS
+#define STATS_MAX_WINDOWS 2  // Rolling windows besides the trip
+#endif
+#ifndef STATS_WINDOW_SLICES
+#define STATS_WINDOW_SLICES 6  // A window moves on in steps of 1/slices of its length
+#endif
+
+const int8_t STATS_TRIP = -1;  // Window index of "everything since reset()"
+
+struct StatsSummary {
+  uint32_t count;
+  float min;
+  float max;
+  float mean;
+  float stddev;
+  uint64_t aboveUs;    // Time spent above the channel's threshold
+  uint64_t coveredUs;  // Time the channel was being read (gaps left out)
+};
+
+// Running statistics of every channel in constant memory: count, min / max,
+// mean and variance (Welford), a fixed-bin histogram with quantiles
+// estimated from it, and time above a threshold. Kept for the whole trip
+// and for rolling windows made of slices, each slice summarised on its own
+// and merged when asked.
+class ChannelStats {
+ public:
+  ChannelStats();
+
+  void reset();  // Starts a new trip, the window lengths and settings stay
+  // Histogram range of a channel, values outside land in the first / last bin
+  bool setRange(uint8_t channel, float low, float high);
+  void setThreshold(uint8_t channel, float threshold);  // NAN turns it off
+  int8_t addWindow(uint32_t seconds);  // Window index, -1 if all are taken
+  uint8_t windowCount() const { return _windowCount; }
+  uint32_t windowSeconds(int8_t window) const;
+  int8_t windowBySeconds(uint32_t seconds) const;  // -1 if there is no such window
+
+  void push(const LiveSample &sample);  // Samples in time order
+
+  bool summary(uint8_t channel, int8_t window, StatsSummary &out) const;  // false if no reading yet
+  float quantile(uint8_t channel, int8_t window, float q) const;          // NAN if no reading yet
+  void histogram(uint8_t channel, int8_t window, uint32_t bins[STATS_HISTOGRAM_BINS]) const;
+
+  // "ECT 60s n:600 min:82 max:104 mean:91.60 sd:4.20 p50:91 p90:99 p99:103 above100:12.3/60.0s"
+  // (above<threshold> only with a threshold set); returns the length
+  int formatSummary(uint8_t channel, int8_t window, char *out, int capacity) const;
+  // "ECT 60s -40..140 0 0 3 ...", bin counts low to high
+  int formatHistogram(uint8_t channel, int8_t window, char *out, int capacity) const;
+
+ private:
+  struct Accumulator {
+    uint32_t count;
+    float mean;
+    float m2;  // Sum of squared differences from the mean
+    float min;
+    float max;
+    uint64_t aboveUs;
+    uint64_t coveredUs;
+    uint32_t bins[STATS_HISTOGRAM_BINS];
+
+    void clear();
+    void add(float value, uint8_t bin);
+    void merge(const Accumulator &other);
+  };
+
+  Accumulator _trip[CHANNEL_COUNT];
+  Accumulator _slices[STATS_MAX_WINDOWS][STATS_WINDOW_SLICES][CHANNEL_COUNT];
+  uint32_t _sliceIndex[STATS_MAX_WINDOWS][STATS_WINDOW_SLICES];  // Which slice of time a slot holds
+  uint32_t _windowSeconds[STATS_MAX_WINDOWS];
+  uint8_t _windowCount = 0;
+
+  float _low[CHANNEL_COUNT];
+  float _high[CHANNEL_COUNT];
+  float _threshold[CHANNEL_COUNT];
+  uint64_t _lastUs[CHANNEL_COUNT];  // Previous reading, 0 = none
+  float _lastValue[CHANNEL_COUNT];
+  uint64_t _newestUs = 0;
+
+  uint8_t binOf(uint8_t channel, float value) const;
+  uint32_t currentSlice(int8_t window, uint64_t timeUs) const;
+  Accumulator *sliceFor(int8_t window, uint64_t timeUs);
+  bool collect(uint8_t channel, int8_t window, Accumulator &out) const;
+};
+
+#endif  // CHANNEL_STATS_H
@@ -0,0 +1,138 @@
+#include "CommandQueue.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Default deadline of each kind: what the app waits on comes first
+static const uint16_t DEFAULT_DEADLINE_MS[] = {
+    1000,  // DTC
+    250,   // CLEAR, within one poll slot
+    5000,  // VIN, several frames and nobody in a hurry
+    250,   // TABLE
+    500,   // PID
+};
+
+static const char *const COMMAND_NAMES[] = {"DTC", "CLEAR", "VIN", "TABLE", "PID"};
+
+const char *commandName(CommandKind kind) {
+  return kind <= COMMAND_READ_PID ? COMMAND_NAMES[kind] : "";
+}
+
+bool commandFitsProtocol(const KLineCommand &command, KLineProtocol protocol) {
+  if (command.kind == COMMAND_READ_TABLE) return protocol == PROTOCOL_ISO14230_HONDA;
+  return protocolHasObdDiagnostics(protocol);
+}
+
+static bool parseHexByte(const char *word, uint8_t &out) {
+  if (!word) return false;
+  char *end;
+  unsigned long value = strtoul(word, &end, 16);
+  if (*end || end == word || value > 0xFF) return false;
+  out = value;
+  return true;
+}
+
+static bool fail(const char **error, const char *reason) {
+  if (error) *error = reason;
+  return false;
+}
+
+bool parseCommand(const char *line, uint32_t nowMs, KLineCommand &out, const char **error) {
+  char args[64];
+  strncpy(args, line, sizeof(args) - 1);
+  args[sizeof(args) - 1] = '\0';
+
+  // A trailing @<ms> is the deadline, whatever the command
+  int32_t deadlineMs = -1;
+  char *at = strchr(args, '@');
+  if (at) {
+    char *end;
+    deadlineMs = strtol(at + 1, &end, 10);
+    if (end == at + 1 || *end || deadlineMs < 0) return fail(error, "bad deadline");
+    *at = '\0';
+  }
+
+  char *word = strtok(args, " ");
+  if (!word) return fail(error, "empty command");
+
+  memset(&out, 0, sizeof(out));
+  if (strcmp(word, "DTC") == 0) {
+    out.kind = COMMAND_READ_DTCS;
+    word = strtok(nullptr, " ");
+    if (!word || strcmp(word, "STORED") == 0) {
+      out.mode = 0x03;
+    } else if (strcmp(word, "PENDING") == 0) {
+      out.mode = 0x07;
+    } else {
+      return fail(error, "DTC takes STORED or PENDING");
+    }
+  } else if (strcmp(word, "CLEAR") == 0) {
+    out.kind = COMMAND_CLEAR_DTCS;
+    out.mode = 0x04;
+  } else if (strcmp(word, "VIN") == 0) {
+    out.kind = COMMAND_READ_VIN;
+    out.mode = 0x09;
+    out.pid = 0x02;
+  } else if (strcmp(word, "TABLE") == 0) {
+    out.kind = COMMAND_READ_TABLE;
+    out.mode = 0x01;
+    if (!parseHexByte(strtok(nullptr, " "), out.pid)) return fail(error, "TABLE needs a hex table number");
+  } else if (strcmp(word, "PID") == 0) {
+    out.kind = COMMAND_READ_PID;
+    if (!parseHexByte(strtok(nullptr, " "), out.mode) || !parseHexByte(strtok(nullptr, " "), out.pid)) {
+      return fail(error, "PID needs a hex mode and PID");
+    }
+    if (out.mode != 0x01 && out.mode != 0x02) return fail(error, "PID mode must be 01 or 02");
+  } else {
+    return fail(error, "unknown command");
+  }
+  if (strtok(nullptr, " ")) return fail(error, "too many arguments");
+
+  out.queuedMs = nowMs;
+  out.deadlineMs = nowMs + (deadlineMs >= 0 ? (uint32_t)deadlineMs : DEFAULT_DEADLINE_MS[out.kind]);
+  return true;
+}
+
+// ----------------------------------- CommandQueue -----------------------------------
+
+bool CommandQueue::before(const KLineCommand &a, const KLineCommand &b) {
+  int32_t diff = (int32_t)(a.deadlineMs - b.deadlineMs);  // millis() wraps
+  if (diff != 0) return diff < 0;
+  return (int32_t)(a.sequence - b.sequence) < 0;
+}
+
+bool CommandQueue::push(KLineCommand command) {
+  if (_count >= COMMAND_QUEUE_SIZE) {
+    _rejected++;
+    return false;
+  }
+  command.sequence = _nextSequence++;
+
+  uint8_t i = _count++;
+  while (i > 0) {
+    uint8_t parent = (i - 1) / 2;
+    if (!before(command, _heap[parent])) break;
+    _heap[i] = _heap[parent];
+    i = parent;
+  }
+  _heap[i] = command;
+  return true;
+}
+
+bool CommandQueue::pop(KLineCommand &out) {
+  if (_count == 0) return false;
+  out = _heap[0];
+
+  KLineCommand last = _heap[--_count];
+  uint8_t i = 0;
+  while (true) {
+    uint8_t child = 2 * i + 1;
+    if (child >= _count) break;
+    if (child + 1 < _count && before(_heap[child + 1], _heap[child])) child++;
+    if (!before(_heap[child], last)) break;
+    _heap[i] = _heap[child];
+    i = child;
+  }
+  _heap[i] = last;
+  return true;
+}
@@ -0,0 +1,68 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <stdint.h>
+
+#include "KLineProtocol.h"
+
+#ifndef COMMAND_QUEUE_SIZE
+#define COMMAND_QUEUE_SIZE 8  // Commands waiting for the bus, from all clients together
+#endif
+
+// K-Line requests a client asks for, run by loop() between live polls.
+// Written one per line, an optional @<ms> sets the deadline:
+//   DTC [STORED|PENDING]   CLEAR   VIN   TABLE <hex>   PID <mode hex> <pid hex>
+enum CommandKind : uint8_t {
+  COMMAND_READ_DTCS,   // mode 03 / 07
+  COMMAND_CLEAR_DTCS,  // mode 04
+  COMMAND_READ_VIN,    // mode 09 PID 02
+  COMMAND_READ_TABLE,  // Honda table, the raw bytes
+  COMMAND_READ_PID,
+};
+
+struct KLineCommand {
+  CommandKind kind;
+  uint8_t mode;         // OBD mode (DTC, PID)
+  uint8_t pid;          // PID or Honda table
+  uint16_t client;      // Who gets the answer (Wifi_K client id)
+  uint32_t queuedMs;
+  uint32_t deadlineMs;  // millis() by which the request must have started
+  uint32_t sequence;    // Order of arrival, among equal deadlines
+};
+
+// Fills out (all but client and sequence) from an upper-case line; on a
+// syntax error returns false and points error at the reason
+bool parseCommand(const char *line, uint32_t nowMs, KLineCommand &out, const char **error = nullptr);
+
+const char *commandName(CommandKind kind);
+
+// Whether the protocol has the request at all: TABLE only on Honda, the
+// OBD services everywhere else. Checked before the command touches the bus.
+bool commandFitsProtocol(const KLineCommand &command, KLineProtocol protocol);
+
+// Earliest deadline first: a CLEAR from the app (short deadline) goes ahead
+// of a VIN read queued earlier. A binary heap, so push and pop stay
+// O(log n) however many clients queue at once.
+class CommandQueue {
+ public:
+  bool push(KLineCommand command);  // false if full
+  bool pop(KLineCommand &out);      // false if empty
+  const KLineCommand *peek() const { return _count ? &_heap[0] : nullptr; }
+  uint8_t size() const { return _count; }
+  uint32_t rejected() const { return _rejected; }  // push() calls that found the queue full
+
+  // Past its deadline: answer with an error instead of running it late
+  static bool expired(const KLineCommand &command, uint32_t nowMs) {
+    return (int32_t)(nowMs - command.deadlineMs) > 0;
+  }
+
+ private:
+  KLineCommand _heap[COMMAND_QUEUE_SIZE];
+  uint8_t _count = 0;
+  uint32_t _nextSequence = 0;
+  uint32_t _rejected = 0;
+
+  static bool before(const KLineCommand &a, const KLineCommand &b);
+};
+
+#endif  // COMMAND_QUEUE_H
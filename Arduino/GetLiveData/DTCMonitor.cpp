@@ -0,0 +1,130 @@
+#include "DTCMonitor.h"
+
+DTCMonitor::DTCMonitor(OBD2_KLine &kline) : _kline(&kline) {}
+
+void DTCMonitor::setEnabled(bool enabled) {
+  _enabled = enabled;
+}
+
+void DTCMonitor::setBusShare(uint8_t percent) {
+  _busSharePercent = percent > 100 ? 100 : percent;
+}
+
+void DTCMonitor::setMinInterval(uint32_t intervalMs) {
+  _minIntervalMs = intervalMs;
+}
+
+void DTCMonitor::setModes(bool stored, bool pending) {
+  _watchStored = stored;
+  _watchPending = pending;
+}
+
+bool DTCMonitor::subscribe(DTCEventHandler handler, void *context) {
+  for (int i = 0; i < MAX_SUBSCRIBERS; i++) {
+    if (!_handlers[i]) {
+      _handlers[i] = handler;
+      _contexts[i] = context;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool DTCMonitor::poll() {
+  uint32_t now = millis();
+
+  // Earn credit for the time that passed, capped so a long idle phase
+  // can't turn into a burst of back-to-back requests. Time that earned less
+  // than a whole ms carries over, or a loop polling every ms never earns any.
+  int32_t maxCreditMs = (int32_t)_lastCostMs * 2;
+  uint32_t earnedMs = (now - _lastUpdateMs) * _busSharePercent / 100;
+  _creditMs += (int32_t)earnedMs;
+  if (_creditMs > maxCreditMs) _creditMs = maxCreditMs;
+  _lastUpdateMs = _busSharePercent ? _lastUpdateMs + earnedMs * 100 / _busSharePercent : now;
+
+  if (!_enabled || (!_watchStored && !_watchPending)) return false;
+  if (!_kline->isConnected()) return false;
+  if (_lastRequestMs != 0 && now - _lastRequestMs < _minIntervalMs) return false;
+  if (_creditMs < (int32_t)_lastCostMs) return false;
+
+  // Alternate between stored and pending codes
+  uint8_t mode = read_storedDTCs;
+  if (!_watchStored || (_watchPending && _nextIsPending)) mode = read_pendingDTCs;
+  _nextIsPending = (mode == read_storedDTCs);
+
+  uint16_t codes[MAX_DTCS + 1];  // One over, to tell a full set from a cut-off one
+  int count = _kline->readDTCCodes(mode, codes, MAX_DTCS + 1);
+
+  uint32_t done = millis();
+  _lastCostMs = (done - now) > 0xFFFF ? 0xFFFF : (done - now);
+  if (_lastCostMs == 0) _lastCostMs = 1;
+  _creditMs -= _lastCostMs;
+  _lastUpdateMs = done;
+  _lastRequestMs = done;
+
+  // No answer says nothing about the codes, keep the previous set
+  if (count >= 0) update(mode, mode == read_storedDTCs ? _stored : _pending, codes, count, done);
+  return true;
+}
+
+void DTCMonitor::update(uint8_t mode, CodeSet &previous, uint16_t *codes, uint8_t count, uint32_t now) {
+  // More codes than MAX_DTCS: the read was cut off, and a code missing from
+  // it may only be past the cut, so nothing is reported as cleared
+  bool complete = count <= MAX_DTCS;
+  sortCodes(codes, count);
+
+  // Drop duplicates (the same code reported by two ECUs)
+  uint8_t unique = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    if (unique == 0 || codes[unique - 1] != codes[i]) codes[unique++] = codes[i];
+  }
+  count = unique < MAX_DTCS ? unique : MAX_DTCS;
+
+  // Walk both sorted sets once: codes only in the new set appeared, codes
+  // only in the old set were cleared
+  uint8_t o = 0, n = 0;
+  uint8_t oldCount = previous.valid ? previous.count : 0;
+  while (o < oldCount || n < count) {
+    if (n >= count || (o < oldCount && previous.codes[o] < codes[n])) {
+      if (complete) emit(previous.codes[o], mode, false, now);
+      o++;
+    } else if (o >= oldCount || codes[n] < previous.codes[o]) {
+      emit(codes[n++], mode, true, now);
+    } else {
+      o++;
+      n++;
+    }
+  }
+
+  memcpy(previous.codes, codes, count * sizeof(uint16_t));
+  previous.count = count;
+  previous.valid = true;
+}
+
+void DTCMonitor::emit(uint16_t code, uint8_t mode, bool appeared, uint32_t now) {
+  DTCEvent event = {code, mode, appeared, now};
+  for (int i = 0; i < MAX_SUBSCRIBERS; i++) {
+    if (_handlers[i]) _handlers[i](event, _contexts[i]);
+  }
+}
+
+void DTCMonitor::sortCodes(uint16_t *codes, uint8_t count) {
+  for (uint8_t i = 1; i < count; i++) {
+    uint16_t value = codes[i];
+    uint8_t j = i;
+    while (j > 0 && codes[j - 1] > value) {
+      codes[j] = codes[j - 1];
+      j--;
+    }
+    codes[j] = value;
+  }
+}
+
+uint8_t DTCMonitor::count(uint8_t mode) {
+  return (mode == read_storedDTCs ? _stored : _pending).count;
+}
+
+uint16_t DTCMonitor::code(uint8_t mode, uint8_t index) {
+  CodeSet &set = (mode == read_storedDTCs) ? _stored : _pending;
+  return index < set.count ? set.codes[index] : 0;
+}
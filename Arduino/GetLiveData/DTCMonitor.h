@@ -0,0 +1,69 @@
+#ifndef DTC_MONITOR_H
+#define DTC_MONITOR_H
+
+#include "OBD2_KLine.h"
+
+struct DTCEvent {
+  uint16_t code;      // Raw 2-byte DTC, formatDTC() turns it into "P0171"
+  uint8_t mode;       // read_storedDTCs or read_pendingDTCs
+  bool appeared;      // true = new code, false = code cleared
+  uint32_t timeMs;    // millis() when the change was seen
+};
+
+typedef void (*DTCEventHandler)(const DTCEvent &event, void *context);
+
+// Reads stored/pending DTCs in the background, between live-data requests,
+// and reports only what changed since the previous read.
+class DTCMonitor {
+ public:
+  static const uint8_t MAX_DTCS = 32;
+  static const uint8_t MAX_SUBSCRIBERS = 4;
+
+  DTCMonitor(OBD2_KLine &kline);
+
+  void setEnabled(bool enabled);
+  void setBusShare(uint8_t percent);       // Share of bus time the monitor may use (default 5 %)
+  void setMinInterval(uint32_t intervalMs);  // Never read more often than this (default 2000 ms)
+  void setModes(bool stored, bool pending);
+  bool subscribe(DTCEventHandler handler, void *context = nullptr);
+
+  // Call from loop() between polls. Runs at most one DTC request, and only
+  // when the bus-time budget allows it. Returns true if a request was made.
+  bool poll();
+
+  uint8_t count(uint8_t mode);
+  uint16_t code(uint8_t mode, uint8_t index);
+
+ private:
+  OBD2_KLine *_kline;
+  bool _enabled = true;
+  uint8_t _busSharePercent = 5;
+  uint32_t _minIntervalMs = 2000;
+  bool _watchStored = true;
+  bool _watchPending = true;
+
+  // Bus-time budget: credit grows by share * elapsed time and each request
+  // costs the time it actually kept the bus busy.
+  int32_t _creditMs = 0;
+  uint32_t _lastUpdateMs = 0;
+  uint32_t _lastRequestMs = 0;
+  uint16_t _lastCostMs = 150;  // Estimate until the first request is measured
+  bool _nextIsPending = false;
+
+  struct CodeSet {
+    uint16_t codes[MAX_DTCS];
+    uint8_t count = 0;
+    bool valid = false;  // false until the first successful read
+  };
+  CodeSet _stored;
+  CodeSet _pending;
+
+  DTCEventHandler _handlers[MAX_SUBSCRIBERS] = {nullptr};
+  void *_contexts[MAX_SUBSCRIBERS] = {nullptr};
+
+  void update(uint8_t mode, CodeSet &previous, uint16_t *codes, uint8_t count, uint32_t now);
+  void emit(uint16_t code, uint8_t mode, bool appeared, uint32_t now);
+  static void sortCodes(uint16_t *codes, uint8_t count);
+};
+
+#endif  // DTC_MONITOR_H
@@ -0,0 +1,58 @@
+#include "FramePool.h"
+
+// ----------------------------------- FrameView -----------------------------------
+
+FrameView::FrameView(const FrameView &other) : _buffer(other.retain()) {}
+
+FrameView &FrameView::operator=(const FrameView &other) {
+  FrameBuffer *buffer = other.retain();  // Before release(), other may be *this
+  release();
+  _buffer = buffer;
+  return *this;
+}
+
+FrameView FrameView::adopt(FrameBuffer *buffer) {
+  FrameView view;
+  view._buffer = buffer;
+  return view;
+}
+
+FrameBuffer *FrameView::retain() const {
+  if (_buffer) __atomic_add_fetch(&_buffer->refs, 1, __ATOMIC_RELAXED);
+  return _buffer;
+}
+
+void FrameView::release() {
+  // Release order: the last holder's reads are done before the buffer can be reused
+  if (_buffer) __atomic_sub_fetch(&_buffer->refs, 1, __ATOMIC_RELEASE);
+  _buffer = nullptr;
+}
+
+const KLineFrameSplitter &FrameView::frames() const {
+  static const KLineFrameSplitter NONE = KLineFrameSplitter();
+  return _buffer ? _buffer->frames : NONE;
+}
+
+// ----------------------------------- FramePool -----------------------------------
+
+FrameBuffer *FramePool::acquire() {
+  for (FrameBuffer &buffer : _buffers) {
+    uint8_t free = 0;
+    if (__atomic_compare_exchange_n(&buffer.refs, &free, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      buffer.length = 0;
+      buffer.timeUs = 0;
+      buffer.status = FRAME_OK;
+      return &buffer;
+    }
+  }
+  _exhausted++;
+  return nullptr;
+}
+
+uint8_t FramePool::freeCount() const {
+  uint8_t count = 0;
+  for (const FrameBuffer &buffer : _buffers) {
+    if (__atomic_load_n(&buffer.refs, __ATOMIC_RELAXED) == 0) count++;
+  }
+  return count;
+}
@@ -0,0 +1,73 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include "KLineConfig.h"
+#include "KLineFrame.h"
+
+#ifndef FRAME_POOL_SIZE
+#define FRAME_POOL_SIZE 4  // Receive buffers; one is the reader's last answer, the rest can be held by consumers
+#endif
+#ifndef FRAME_BUFFER_SIZE
+#define FRAME_BUFFER_SIZE 160  // Bytes of one readData()
+#endif
+static_assert(FRAME_BUFFER_SIZE <= 255, "readData() returns the byte count as uint8_t");
+
+enum FrameStatus : uint8_t {
+  FRAME_OK,        // Every byte belonged to a valid frame
+  FRAME_DROPPED,   // Some bytes weren't part of any frame (noise, bad checksum, cut off)
+  FRAME_OVERFLOW,  // The buffer filled up before the bus went quiet
+};
+
+// The bytes of one readData() and the frames cut out of them. Written by the
+// reader only while it holds the sole reference, read-only once published.
+struct FrameBuffer {
+  uint8_t data[FRAME_BUFFER_SIZE];
+  uint16_t length = 0;
+  uint64_t timeUs = 0;  // First byte
+  FrameStatus status = FRAME_OK;
+  KLineFrameSplitter frames;
+  uint8_t refs = 0;  // Views holding the buffer, changed with __atomic only
+};
+
+// Read-only, reference-counted view of a FrameBuffer. Copies share the buffer;
+// it goes back to the pool with the last view, so a logger, a decoder and a
+// network writer can each keep the same answer without copying it.
+class FrameView {
+ public:
+  FrameView() {}
+  FrameView(const FrameView &other);
+  FrameView &operator=(const FrameView &other);
+  ~FrameView() { release(); }
+
+  // Takes over a reference the caller already holds (FramePool::acquire(), retain())
+  static FrameView adopt(FrameBuffer *buffer);
+  // A reference as a plain pointer, for a FreeRTOS queue; adopt() it on the other side
+  FrameBuffer *retain() const;
+  void release();
+
+  explicit operator bool() const { return _buffer != nullptr; }
+  const uint8_t *data() const { return _buffer ? _buffer->data : nullptr; }
+  uint16_t length() const { return _buffer ? _buffer->length : 0; }
+  uint64_t timeUs() const { return _buffer ? _buffer->timeUs : 0; }
+  FrameStatus status() const { return _buffer ? _buffer->status : FRAME_OK; }
+  const KLineFrameSplitter &frames() const;  // An empty splitter for an empty view
+  uint8_t operator[](uint16_t index) const { return index < length() ? _buffer->data[index] : 0; }
+
+ private:
+  FrameBuffer *_buffer = nullptr;
+};
+
+class FramePool {
+ public:
+  // A free buffer with one reference, owned by the caller until it is
+  // published with FrameView::adopt(); nullptr if every buffer is held
+  FrameBuffer *acquire();
+  uint8_t freeCount() const;
+  uint32_t exhausted() const { return _exhausted; }  // acquire() calls that found no buffer
+
+ private:
+  FrameBuffer _buffers[FRAME_POOL_SIZE];
+  uint32_t _exhausted = 0;
+};
+
+#endif  // FRAME_POOL_H
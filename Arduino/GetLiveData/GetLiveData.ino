@@ -2,12 +2,25 @@
 //#include <AltSoftSerial.h>  // Optional alternative software serial (not used here)
 //AltSoftSerial Alt_Serial;   // Create an alternative serial object (commented out)
 
+#include "AdaptivePoller.h"
+#include "CaptureBuffer.h"
+#include "ChannelStats.h"
+#include "CommandQueue.h"
+#include "DTCMonitor.h"
+#include "LocalIdBlocks.h"
+#include "UdpStream.h"
 #include "wifi_K.h"
 #include "freertos/queue.h"
 
 Wifi_K wifiManager;
 QueueHandle_t log_queue = nullptr;
 OBD2_KLine KLine(Serial1, 10400, 16, 17);
+DTCMonitor dtcMonitor(KLine);
+AdaptivePoller poller(KLine);  // Mode 01 PIDs each at its own rate (ISO9141 / ISO14230 protocols)
+CaptureBuffer capture;
+ChannelStats stats;
+CommandQueue commands;
+UdpStream udpStream;
 
 HondaLiveData myHondaData;
 
@@ -24,23 +37,239 @@ void logf(const char *fmt, ...) {
   }
 }
 
+void onDTCChange(const DTCEvent &event, void *context) {
+  char code[6];
+  formatDTC(event.code, code);
+  logf("DTC %s %s (%s) @%lu ms\n",
+       event.appeared ? "appeared" : "cleared",
+       code,
+       event.mode == read_storedDTCs ? "stored" : "pending",
+       (unsigned long)event.timeMs
+  );
+
+  if (event.appeared) {
+    char reason[12];
+    snprintf(reason, sizeof(reason), "DTC %s", code);
+    capture.trigger(reason);
+  }
+}
+
+void onSnapshot(const Snapshot &snapshot, void *context) {
+  // Too many lines at once for the log queue, send them straight to the clients
+  char line[LOG_BUFFER_SIZE];
+  snprintf(line, sizeof(line), "SNAPSHOT %s @%lu ms, %u samples, trigger at #%u\n",
+           snapshot.reason, (unsigned long)(snapshot.triggerTimeUs / 1000), snapshot.count, snapshot.triggerIndex);
+  Serial.print(line);
+  wifiManager.broadcast(line);
+
+  for (uint8_t i = 0; i < snapshot.count; i++) {
+    int n = formatSample(snapshot.samples[i], line, sizeof(line) - 1);
+    line[n++] = '\n';
+    line[n] = '\0';
+    Serial.print(line);
+    wifiManager.broadcast(line);
+  }
+}
+
+// K-Line commands wait in the queue and loop() runs one per poll slot;
+// the answer goes back to the client that asked
+void queueCommand(const char *line, Print &reply, uint16_t client) {
+  KLineCommand command;
+  const char *error;
+  if (!parseCommand(line, millis(), command, &error)) {
+    reply.print("ERR ");
+    reply.print(error);
+    reply.print("\n");
+    return;
+  }
+  if (KLine.isConnected() && !commandFitsProtocol(command, KLine.protocol())) {
+    reply.print("ERR ");
+    reply.print(commandName(command.kind));
+    reply.print(" not supported\n");
+    return;
+  }
+  command.client = client;
+  if (!commands.push(command)) reply.print("ERR busy\n");
+}
+
+void runCommand(const KLineCommand &command) {
+  if (!wifiManager.isConnected(command.client)) return;  // Nobody left to answer, keep the bus for polling
+
+  char out[LOG_BUFFER_SIZE];
+  const char *name = commandName(command.kind);
+  int n = 0;
+  if (!commandFitsProtocol(command, KLine.protocol())) {  // Protocol changed while it waited
+    n = snprintf(out, sizeof(out), "ERR %s not supported", name);
+  } else if (CommandQueue::expired(command, millis())) {
+    n = snprintf(out, sizeof(out), "ERR %s missed its deadline", name);
+  } else if (command.kind == COMMAND_READ_DTCS) {
+    uint16_t codes[DTCMonitor::MAX_DTCS];
+    int count = KLine.readDTCCodes(command.mode, codes, DTCMonitor::MAX_DTCS);
+    if (count < 0) {
+      n = snprintf(out, sizeof(out), "ERR %s no answer", name);
+    } else {
+      n = snprintf(out, sizeof(out), "DTC %s %d", command.mode == read_storedDTCs ? "stored" : "pending", count);
+      for (int i = 0; i < count && n < (int)sizeof(out) - 8; i++) {
+        out[n++] = ' ';
+        formatDTC(codes[i], out + n);
+        n += 5;
+      }
+    }
+  } else if (command.kind == COMMAND_CLEAR_DTCS) {
+    n = snprintf(out, sizeof(out), KLine.clearDTCs() ? "CLEAR ok" : "ERR CLEAR no answer");
+  } else if (command.kind == COMMAND_READ_VIN) {
+    String vin = KLine.getVehicleInfo(read_VIN);
+    n = vin.length() ? snprintf(out, sizeof(out), "VIN %s", vin.c_str()) : snprintf(out, sizeof(out), "ERR VIN no answer");
+  } else if (command.kind == COMMAND_READ_TABLE) {
+    HondaLiveData data;
+    FrameView response;
+    if (KLine.getHondaLiveData(command.pid, data)) response = KLine.lastResponse();
+    int8_t index = response.frames().find(0x71, command.pid, 0x02);
+    if (index < 0) {
+      n = snprintf(out, sizeof(out), "ERR TABLE %02X no answer", command.pid);
+    } else {
+      const KLineFrameSplitter &frames = response.frames();
+      n = snprintf(out, sizeof(out), "TABLE %02X", command.pid);
+      for (uint8_t i = 2; i < frames.frame(index).dataLength && n < (int)sizeof(out) - 4; i++) {
+        n += snprintf(out + n, sizeof(out) - n, " %02X", frames.data(index)[i]);
+      }
+    }
+  } else if (command.kind == COMMAND_READ_PID) {
+    // A negative value is either an error code or a reading (timing advance):
+    // only a decoded answer moves responseTimeUs()
+    uint64_t lastAnswerUs = KLine.responseTimeUs();
+    float value = KLine.getPID(command.mode, command.pid);
+    if (KLine.responseTimeUs() != lastAnswerUs) {
+      n = snprintf(out, sizeof(out), "PID %02X %02X %.2f", command.mode, command.pid, value);
+    } else {
+      n = snprintf(out, sizeof(out), "ERR PID %02X %02X %s", command.mode, command.pid,
+                   value == -3 ? "not supported" : value == -2 ? "unexpected answer" : "no answer");
+    }
+  }
+  out[n++] = '\n';
+  out[n] = '\0';
+  wifiManager.sendTo(command.client, out);
+}
+
+// Commands from TCP clients, one per line:
+//   STATS [<channel>] [<seconds>]   summary of one or all channels, the trip or a rolling window
+//   STATS HIST <channel> [<seconds>]
+//   STATS RESET                     starts a new trip
+//   DTC [STORED|PENDING], CLEAR, VIN, TABLE <hex>, PID <mode> <pid>   queued, see CommandQueue.h;
+//   a trailing @<ms> sets the deadline ("CLEAR @100")
+void onCommand(const char *line, Print &reply, uint16_t client, void *context) {
+  char args[COMMAND_BUFFER_SIZE];
+  strncpy(args, line, sizeof(args) - 1);
+  args[sizeof(args) - 1] = '\0';
+  for (char *c = args; *c; c++) *c = toupper((unsigned char)*c);  // Channel names are upper case
+
+  if (strncmp(args, "STATS", 5) != 0) {
+    queueCommand(args, reply, client);
+    return;
+  }
+
+  char *word = strtok(args, " ");
+  if (!word || strcmp(word, "STATS") != 0) {
+    reply.print("ERR unknown command\n");
+    return;
+  }
+
+  word = strtok(nullptr, " ");
+  bool histogram = word && strcmp(word, "HIST") == 0;
+  if (word && strcmp(word, "RESET") == 0) {
+    stats.reset();
+    reply.print("STATS reset\n");
+    return;
+  }
+  if (histogram) word = strtok(nullptr, " ");
+
+  int8_t channel = -1;
+  if (word && !isdigit((unsigned char)word[0])) {
+    channel = channelByName(word, strlen(word));
+    if (channel < 0) {
+      reply.print("ERR unknown channel\n");
+      return;
+    }
+    word = strtok(nullptr, " ");
+  }
+  if (histogram && channel < 0) {
+    reply.print("ERR STATS HIST needs a channel\n");
+    return;
+  }
+
+  int8_t window = STATS_TRIP;
+  if (word) {
+    window = stats.windowBySeconds(strtoul(word, nullptr, 10));
+    if (window < 0) {
+      reply.print("ERR no such window\n");
+      return;
+    }
+  }
+
+  char out[LOG_BUFFER_SIZE];
+  for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+    if (channel >= 0 && ch != channel) continue;
+    int n = histogram ? stats.formatHistogram(ch, window, out, sizeof(out) - 1)
+                      : stats.formatSummary(ch, window, out, sizeof(out) - 1);
+    out[n++] = '\n';
+    out[n] = '\0';
+    reply.print(histogram ? "HIST " : "STATS ");
+    reply.print(out);
+  }
+}
+
 void setup() {
   Serial.begin(115200);
   wifiManager.begin();
   log_queue = wifiManager.getQueueHandle();
+  wifiManager.onCommand(onCommand);  // "STATS ..." queries and K-Line commands from TCP clients
+  udpStream.begin();                // Live samples over UDP port 3334 (clients send "SUB"), TCP 3333 stays for logs
+  // udpStream.setBroadcast(IPAddress(192, 168, 4, 255), 3334);  // Optional: also broadcast to the whole AP subnet
+  // udpStream.setCompression(1000);  // Optional: compressed sample blocks, ~8x less airtime for up to 1 s latency
   logf("OBD2 K-Line Get Live Data Example");
 
   KLine.setDebug(Serial);          // Optional: outputs debug messages to the selected serial port
-  KLine.setProtocol("ISO14230_Honda");  // Optional: communication protocol (default: Automatic; supported: ISO9141, ISO14230_Slow, ISO14230_Fast, Automatic)
+  KLine.setProtocol(PROTOCOL_ISO14230_HONDA);  // Optional: communication protocol (default: PROTOCOL_AUTOMATIC; supported: PROTOCOL_ISO9141, _ISO14230_SLOW, _ISO14230_FAST, _ISO14230_HONDA)
   KLine.setByteWriteInterval(5);   // Optional: delay (ms) between bytes when writing
   KLine.setInterByteTimeout(60);   // Optional: sets the maximum inter-byte timeout (ms) while receiving data
   KLine.setReadTimeout(1000);      // Optional: maximum time (ms) to wait for a response after sending a request
+  // setLocalIdLayout(0x01, SIMULATOR_BLOCK_01, 9);  // Optional (ISO14230_Fast / _Slow): layout of a KWP2000 0x21 block, then KLine.readLocalIdentifier(0x01, sample) reads all its values in one request
+  // KLine.loadSupportedData(blob, len);  // Optional: restore PID bitmaps kept with saveSupportedData() (e.g. in Preferences) instead of reading them again
+
+  // Honda tables have no OBD DTC service (readDTCCodes() is always -1), so the
+  // monitor only runs with the other protocols; with PROTOCOL_AUTOMATIC it stays
+  // quiet if the ECU turns out to be a Honda
+  if (KLine.protocol() != PROTOCOL_ISO14230_HONDA) {
+    dtcMonitor.setBusShare(5);      // Optional: share of K-Line time (%) used for background DTC reads
+    dtcMonitor.subscribe(onDTCChange);
+  } else {
+    dtcMonitor.setEnabled(false);
+  }
+
+  // poller.addPid(0x0C, 50);  // Optional (mode 01 protocols): PID and the error allowed in its unit, read faster while it moves
+  // poller.addPid(0x11, 2, 0.5f, 10);  // ... and minimum / maximum rate (Hz, default 0.2 / 5)
+  // poller.addPid(0x05, 1);
+  // poller.setBusShare(80);   // Optional: share of K-Line time (%) for these reads, leave room for dtcMonitor
+
+  capture.setWindow(40, 20);        // Optional: samples kept before / after a trigger
+  capture.addTrigger("ECT>105");    // Overheating
+  capture.addTrigger("RPM+2000");   // RPM spike between two samples
+  capture.addTrigger("TPS~25");     // Sudden throttle change
+  capture.onSnapshot(onSnapshot);
+
+  stats.addWindow(60);                      // Optional: rolling windows (s) next to the whole trip
+  stats.addWindow(600);
+  stats.setThreshold(CH_COOLANT_TEMP, 100);  // Optional: time spent above a value
+  stats.setThreshold(CH_ENGINE_SPEED, 4000);
 
   logf("OBD2 Starting.");
 }
 
 void loop() {
   if (KLine.initOBD2()) {
+    KLineCommand command;
+    if (commands.pop(command)) runCommand(command);  // One per poll slot, ahead of the live request
+
     if (KLine.getHondaLiveData(0x17, myHondaData)) {
       logf("RPM:%.0f, TPS:%.1f, ECT:%d, IAT:%d, VSS:%d, MAP:%d, BATT:%.2f\n",
            myHondaData.engineSpeed_rpm,
@@ -51,7 +280,17 @@ void loop() {
            myHondaData.map_mbar,
            myHondaData.battery_volt
       );
+
+      LiveSample sample = {myHondaData.timeUs, 0};
+      hondaToSample(myHondaData, sample);
+      capture.push(sample);
+      stats.push(sample);
+      udpStream.send(sample);
     }
+    // LiveSample reading;   // With the mode 01 protocols instead of getHondaLiveData(): one PID per call, the most overdue
+    // if (poller.poll(reading)) { capture.push(reading); stats.push(reading); udpStream.send(reading); }
+    dtcMonitor.poll();
   }
   wifiManager.handle();
+  udpStream.handle();
 }
@@ -0,0 +1,59 @@
+#ifndef KLINE_CONFIG_H
+#define KLINE_CONFIG_H
+
+// Compile-time sizes and optional parts of the K-Line reader. Every value can
+// be set with -D (arduino-cli --build-property compiler.cpp.extra_flags=...)
+// or changed here; a feature set to 0 isn't compiled in and takes no RAM or
+// flash. Host/Makefile `make sizes` shows what each setting costs.
+
+// Small AVRs (ATmega328P: 2 KB RAM) get one receive buffer sized for a
+// single OBD answer and no extras; everything else the full reader
+#if defined(__AVR__)
+#ifndef FRAME_POOL_SIZE
+#define FRAME_POOL_SIZE 1
+#endif
+#ifndef FRAME_BUFFER_SIZE
+#define FRAME_BUFFER_SIZE 64
+#endif
+#ifndef KLINE_MAX_FRAMES
+#define KLINE_MAX_FRAMES 4
+#endif
+#ifndef KLINE_DTC_STORAGE
+#define KLINE_DTC_STORAGE 0
+#endif
+#ifndef KLINE_VEHICLE_INFO
+#define KLINE_VEHICLE_INFO 0
+#endif
+#ifndef KLINE_SUPPORTED_PIDS
+#define KLINE_SUPPORTED_PIDS 0
+#endif
+#ifndef KLINE_DEBUG
+#define KLINE_DEBUG 0
+#endif
+#endif
+
+#ifndef KLINE_MAX_FRAMES
+#define KLINE_MAX_FRAMES 16  // Frames cut out of one readData()
+#endif
+#ifndef KLINE_DTC_STORAGE
+#define KLINE_DTC_STORAGE 1  // readDTCs() / getStoredDTC() / getPendingDTC() text copies
+#endif
+#ifndef KLINE_MAX_DTCS
+#define KLINE_MAX_DTCS 32  // Codes kept per mode by readDTCs()
+#endif
+#ifndef KLINE_VEHICLE_INFO
+#define KLINE_VEHICLE_INFO 1  // getVehicleInfo(): VIN and calibration ids
+#endif
+#ifndef KLINE_SUPPORTED_PIDS
+#define KLINE_SUPPORTED_PIDS 1  // Supported-PID bitmaps; without them every PID is requested
+#endif
+#ifndef KLINE_DEBUG
+#define KLINE_DEBUG 1  // setDebug() output
+#endif
+
+// Defined to one KLineProtocol (e.g. PROTOCOL_ISO14230_HONDA), the reader
+// speaks only that protocol: setProtocol() is ignored, the other inits and
+// request formats aren't compiled in.
+// #define KLINE_FIXED_PROTOCOL PROTOCOL_ISO14230_HONDA
+
+#endif  // KLINE_CONFIG_H
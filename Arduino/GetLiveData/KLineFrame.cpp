@@ -0,0 +1,176 @@
+#include "KLineFrame.h"
+
+uint8_t klineChecksum(KLineFraming framing, const uint8_t *data, uint16_t length) {
+  uint8_t sum = 0;
+  for (uint16_t i = 0; i < length; i++) sum += data[i];
+  return framing == FRAMING_HONDA ? (uint8_t)(0x100 - sum) : sum;
+}
+
+void KLineFrameSplitter::begin(KLineFraming framing, const uint8_t *stream) {
+  _framing = framing;
+  _stream = stream;
+  _scan = 0;
+  _stamped = 0xFFFF;
+  _dropped = 0;
+  _count = 0;
+}
+
+uint8_t KLineFrameSplitter::feed(uint16_t available, bool complete, uint64_t timeUs) {
+  if (!_stream) return 0;
+
+  while (_count < MAX_FRAMES && _scan < available) {
+    if (_stamped != _scan) {  // First time this byte is looked at as a frame start
+      _stamped = _scan;
+      _scanTimeUs = timeUs;
+    }
+
+    KLineFrame frame;
+    int8_t result = tryFrame(available, complete, frame);
+
+    if (result == 0 && !complete) break;  // Wait for the rest of the frame
+    if (result <= 0) {                    // Garbage or a cut-off frame: resync on the next byte
+      _scan++;
+      _dropped++;
+      continue;
+    }
+
+    frame.timeUs = _scanTimeUs;
+    _frames[_count++] = frame;
+    _scan += frame.length;
+  }
+
+  return _count;
+}
+
+int8_t KLineFrameSplitter::tryFrame(uint16_t available, bool complete, KLineFrame &frame) const {
+  const uint8_t *s = _stream + _scan;
+  uint16_t left = available - _scan;
+
+  frame.offset = _scan;
+  frame.target = 0;
+  frame.source = 0;
+
+  if (_framing == FRAMING_KWP2000) {
+    // Format byte: A1 A0 L5 L4 L3 L2 L1 L0
+    bool hasAddress = (s[0] & 0xC0) != 0;
+    uint8_t headerLength = 1 + (hasAddress ? 2 : 0);
+    uint16_t dataLength = s[0] & 0x3F;
+
+    if (dataLength == 0) {  // Length didn't fit in 6 bits, extra length byte follows
+      headerLength++;
+      if (left < headerLength) return 0;
+      dataLength = s[headerLength - 1];
+      if (dataLength == 0) return -1;
+    }
+
+    uint16_t total = headerLength + dataLength + 1;
+    if (total > 0xFF) return -1;
+    if (left < total) return 0;
+
+    if (klineChecksum(FRAMING_KWP2000, s, total - 1) != s[total - 1]) return -1;
+
+    frame.length = total;
+    frame.dataOffset = headerLength;
+    frame.dataLength = dataLength;
+    if (hasAddress) {
+      frame.target = s[1];
+      frame.source = s[2];
+    }
+    return 1;
+  }
+
+  if (_framing == FRAMING_HONDA) {
+    if (left < 2) return 0;
+    uint8_t total = s[1];
+    if (total < 3) return -1;
+    if (left < total) return 0;
+
+    if (klineChecksum(FRAMING_HONDA, s, total - 1) != s[total - 1]) return -1;
+
+    frame.length = total;
+    frame.dataOffset = 2;
+    frame.dataLength = total - 3;
+    frame.source = s[0];
+    return 1;
+  }
+
+  // ISO 9141: 48 6B <source> <data 1..7> <checksum>. There is no length in the
+  // header and a data byte can equal the running sum, so the frame ends at the
+  // checksum match right before the next 48 6B header, or at the last match
+  // once no header can follow any more.
+  const uint8_t headerLength = 3;
+  const uint8_t maxTotal = headerLength + 7 + 1;
+  if (left < 2) return 0;
+  if (s[0] != 0x48 || s[1] != 0x6B) return -1;
+
+  uint8_t sum = 0;
+  uint8_t total = 0;  // Up to the last checksum match seen
+  for (uint16_t i = 0; i < left && i < maxTotal; i++) {
+    if (i > headerLength && s[i] == sum) {
+      total = i + 1;
+      if (i + 2 < left && s[i + 1] == 0x48 && s[i + 2] == 0x6B) break;
+    }
+    sum += s[i];
+  }
+
+  bool headerFollows = total > 0 && total + 1 < left && s[total] == 0x48 && s[total + 1] == 0x6B;
+  if (!headerFollows && !complete && left < maxTotal + 2) return 0;  // A later match may still be the end
+  if (total == 0) return -1;
+
+  frame.length = total;
+  frame.dataOffset = headerLength;
+  frame.dataLength = total - 1 - headerLength;
+  frame.target = s[1];
+  frame.source = s[2];
+  return 1;
+}
+
+int8_t KLineFrameSplitter::find(uint8_t serviceId, int16_t pid, uint8_t source) const {
+  for (uint8_t i = 0; i < _count; i++) {
+    const uint8_t *d = data(i);
+    if (_frames[i].dataLength < 1 || d[0] != serviceId) continue;
+    if (pid >= 0 && (_frames[i].dataLength < 2 || d[1] != pid)) continue;
+    if (source != 0 && _frames[i].source != source) continue;
+    return i;
+  }
+  return -1;
+}
+
+uint8_t KLineFrameSplitter::reassemble(uint8_t serviceId, int16_t pid, uint8_t skip, bool sequenced,
+                                       uint8_t *out, uint8_t capacity, uint8_t source) const {
+  uint8_t order[MAX_FRAMES];
+  uint8_t orderCount = 0;
+  uint8_t firstByte = 1 + skip;
+
+  // Several ECUs may answer: lock onto the first one unless a source was asked for
+  int8_t first = find(serviceId, pid, source);
+  if (first < 0) return 0;
+  source = _frames[first].source;
+
+  for (uint8_t i = first; i < _count; i++) {
+    const uint8_t *d = data(i);
+    if (_frames[i].dataLength < firstByte || d[0] != serviceId || _frames[i].source != source) continue;
+    if (pid >= 0 && d[1] != pid) continue;
+
+    // Insertion sort on the message number keeps this a single pass for in-order frames
+    uint8_t pos = orderCount++;
+    if (sequenced) {
+      while (pos > 0 && data(order[pos - 1])[skip] > d[skip]) {
+        order[pos] = order[pos - 1];
+        pos--;
+      }
+    }
+    order[pos] = i;
+  }
+
+  uint8_t written = 0;
+  for (uint8_t n = 0; n < orderCount; n++) {
+    const uint8_t *d = data(order[n]);
+    uint8_t partLength = _frames[order[n]].dataLength - firstByte;
+    if (partLength > capacity - written) partLength = capacity - written;
+    memcpy(out + written, d + firstByte, partLength);
+    written += partLength;
+  }
+
+  return written;
+}
@@ -0,0 +1,78 @@
+#ifndef KLINE_FRAME_H
+#define KLINE_FRAME_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "KLineConfig.h"
+
+// How the header of a frame tells us where the frame ends
+enum KLineFraming : uint8_t {
+  FRAMING_ISO9141,  // 48 6B <source>, no length; the frame ends at the checksum match before the next header
+  FRAMING_KWP2000,  // format byte with address mode + length bits, optional length byte
+  FRAMING_HONDA,    // [address, total length incl. checksum, data..., 0x100 - sum]
+};
+
+// Checksum byte for the first `length` bytes of a frame: the plain sum for
+// ISO 9141 / KWP2000, 0x100 - sum for Honda so the whole frame adds up to 0.
+uint8_t klineChecksum(KLineFraming framing, const uint8_t *data, uint16_t length);
+
+// One validated frame inside a receive stream
+struct KLineFrame {
+  uint16_t offset;      // first byte of the frame in the stream
+  uint8_t length;       // whole frame, header and checksum included
+  uint8_t dataOffset;   // first byte after the header (service id), relative to offset
+  uint8_t dataLength;   // bytes between header and checksum
+  uint8_t target;       // target address (0 if the header has none)
+  uint8_t source;       // source address (the ECU that answered)
+  uint64_t timeUs;      // when the first byte arrived, from the feed() that brought it
+};
+
+class KLineFrameSplitter {
+ public:
+  static const uint8_t MAX_FRAMES = KLINE_MAX_FRAMES;
+
+  // Starts a new receive stream. The stream buffer is owned by the caller and
+  // must stay valid while frames are read from the splitter.
+  void begin(KLineFraming framing, const uint8_t *stream);
+
+  // Consumes everything received so far. Call it after every new byte or once
+  // at the end; bytes already cut into frames are never scanned again.
+  // Pass complete = true once nothing more will arrive so a cut-off frame at
+  // the tail is dropped and the frames behind it are still found.
+  // timeUs stamps frames starting in the new bytes. After garbage, the frame
+  // found behind it gets the time of the feed() that resynced.
+  uint8_t feed(uint16_t available, bool complete = false, uint64_t timeUs = 0);
+
+  uint8_t frameCount() const { return _count; }
+  uint16_t droppedBytes() const { return _dropped; }
+  uint16_t consumed() const { return _scan; }  // Bytes already cut into frames or dropped
+  const KLineFrame &frame(uint8_t index) const { return _frames[index]; }
+  const uint8_t *data(uint8_t index) const { return _stream + _frames[index].offset + _frames[index].dataOffset; }
+
+  // Index of the first frame whose data starts with serviceId (and pid, if
+  // pid >= 0) coming from source (any source if source is 0), or -1.
+  int8_t find(uint8_t serviceId, int16_t pid = -1, uint8_t source = 0) const;
+
+  // Joins the data of every frame that answers serviceId into out, skipping the
+  // service id and `skip` more bytes of each frame. If sequenced is true the
+  // byte right before the joined part is a message number (mode 09) and the
+  // frames are put in that order, whatever order they arrived in.
+  uint8_t reassemble(uint8_t serviceId, int16_t pid, uint8_t skip, bool sequenced,
+                     uint8_t *out, uint8_t capacity, uint8_t source = 0) const;
+
+ private:
+  KLineFraming _framing = FRAMING_KWP2000;
+  const uint8_t *_stream = nullptr;
+  uint16_t _scan = 0;
+  uint16_t _stamped = 0xFFFF;  // Stream position _scanTimeUs belongs to
+  uint64_t _scanTimeUs = 0;
+  uint16_t _dropped = 0;
+  uint8_t _count = 0;
+  KLineFrame _frames[MAX_FRAMES];
+
+  // 1 = frame found, 0 = need more bytes, -1 = not a frame at _scan
+  int8_t tryFrame(uint16_t available, bool complete, KLineFrame &frame) const;
+};
+
+#endif  // KLINE_FRAME_H
@@ -0,0 +1,53 @@
+#include "KLineLog.h"
+
+#include <string.h>
+
+void writeLogFileHeader(uint8_t *out) {
+  out[0] = 'K';
+  out[1] = 'L';
+  out[2] = 'O';
+  out[3] = 'G';
+  out[4] = KLOG_VERSION;
+  out[5] = out[6] = out[7] = 0;
+}
+
+bool isLogFileHeader(const uint8_t *data, size_t available) {
+  return available >= KLOG_FILE_HEADER_SIZE && memcmp(data, "KLOG", 4) == 0 && data[4] == KLOG_VERSION;
+}
+
+uint16_t encodeLogRecord(uint8_t type, uint64_t timeUs, const uint8_t *payload, uint8_t length,
+                         uint8_t *out, uint16_t capacity) {
+  uint16_t total = KLOG_RECORD_HEADER_SIZE + length + 1;
+  if (capacity < total) return 0;
+
+  out[0] = KLOG_SYNC;
+  out[1] = type;
+  out[2] = length;
+  for (uint8_t i = 0; i < 8; i++) out[3 + i] = (timeUs >> (8 * i)) & 0xFF;
+  memcpy(out + KLOG_RECORD_HEADER_SIZE, payload, length);
+
+  uint8_t sum = 0;
+  for (uint16_t i = 1; i < total - 1; i++) sum += out[i];
+  out[total - 1] = sum;
+  return total;
+}
+
+int parseLogRecord(const uint8_t *data, size_t available, KLogRecord &record) {
+  if (available < 1) return 0;
+  if (data[0] != KLOG_SYNC) return -1;
+  if (available < KLOG_RECORD_HEADER_SIZE) return 0;
+
+  uint16_t total = KLOG_RECORD_HEADER_SIZE + data[2] + 1;
+  if (available < total) return 0;
+
+  uint8_t sum = 0;
+  for (uint16_t i = 1; i < total - 1; i++) sum += data[i];
+  if (sum != data[total - 1]) return -1;
+
+  record.type = data[1];
+  record.length = data[2];
+  record.timeUs = 0;
+  for (uint8_t i = 0; i < 8; i++) record.timeUs |= (uint64_t)data[3 + i] << (8 * i);
+  record.payload = data + KLOG_RECORD_HEADER_SIZE;
+  return total;
+}
@@ -0,0 +1,44 @@
+#ifndef KLINE_LOG_H
+#define KLINE_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary log (.klog): an 8-byte file header followed by records
+//
+//   file header:  'K' 'L' 'O' 'G' <version> 0 0 0
+//   record:       A5 <type> <length> <time_us, 8 bytes LE> <payload, length bytes> <checksum>
+//
+// The checksum is the sum of every record byte after the sync byte, so a
+// reader that lands in the middle of a file can resync on the next record.
+
+const uint8_t KLOG_VERSION = 1;
+const uint8_t KLOG_FILE_HEADER_SIZE = 8;
+const uint8_t KLOG_SYNC = 0xA5;
+const uint8_t KLOG_RECORD_HEADER_SIZE = 11;
+const uint16_t KLOG_MAX_RECORD_SIZE = KLOG_RECORD_HEADER_SIZE + 255 + 1;
+
+enum KLogRecordType : uint8_t {
+  KLOG_FRAME = 1,    // payload: <KLineFraming> <frame bytes as received, checksum included>
+  KLOG_SAMPLES = 2,  // payload: a SampleCodec block of decoded samples, time_us = first sample
+};
+
+struct KLogRecord {
+  uint8_t type;
+  uint8_t length;
+  uint64_t timeUs;
+  const uint8_t *payload;
+};
+
+void writeLogFileHeader(uint8_t *out);
+bool isLogFileHeader(const uint8_t *data, size_t available);
+
+// Returns the record size, or 0 if out is too small
+uint16_t encodeLogRecord(uint8_t type, uint64_t timeUs, const uint8_t *payload, uint8_t length,
+                         uint8_t *out, uint16_t capacity);
+
+// Record size if data starts with a valid record, 0 if more bytes are
+// needed to tell, -1 if it isn't a record
+int parseLogRecord(const uint8_t *data, size_t available, KLogRecord &record);
+
+#endif  // KLINE_LOG_H
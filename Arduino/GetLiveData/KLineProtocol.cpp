@@ -0,0 +1,22 @@
+#include "KLineProtocol.h"
+
+#include <string.h>
+
+static const char *const PROTOCOL_NAMES[] = {
+    "Automatic", "ISO9141", "ISO14230_Slow", "ISO14230_Fast", "ISO14230_Honda",
+};
+static const uint8_t PROTOCOL_COUNT = sizeof(PROTOCOL_NAMES) / sizeof(PROTOCOL_NAMES[0]);
+
+const char *protocolName(KLineProtocol protocol) {
+  return protocol < PROTOCOL_COUNT ? PROTOCOL_NAMES[protocol] : "";
+}
+
+bool parseProtocol(const char *name, KLineProtocol &out) {
+  for (uint8_t i = 0; i < PROTOCOL_COUNT; i++) {
+    if (strcmp(name, PROTOCOL_NAMES[i]) == 0) {
+      out = (KLineProtocol)i;
+      return true;
+    }
+  }
+  return false;
+}
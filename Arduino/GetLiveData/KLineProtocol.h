@@ -0,0 +1,135 @@
+#ifndef KLINE_PROTOCOL_H
+#define KLINE_PROTOCOL_H
+
+#include <stdint.h>
+
+#include "KLineFrame.h"
+
+enum KLineProtocol : uint8_t {
+  PROTOCOL_AUTOMATIC,       // Selected only: slow, fast then Honda init
+  PROTOCOL_ISO9141,         // ISO 9141-2, 5 baud init with KW1 == KW2
+  PROTOCOL_ISO14230_SLOW,   // KWP2000, 5 baud init
+  PROTOCOL_ISO14230_FAST,   // KWP2000, fast init
+  PROTOCOL_ISO14230_HONDA,  // Honda tables, Honda wake-up
+};
+
+// Name as setProtocol() / the sketch use it ("ISO14230_Fast"), "" if unknown
+const char *protocolName(KLineProtocol protocol);
+bool parseProtocol(const char *name, KLineProtocol &out);
+
+enum KLineInit : uint8_t { INIT_SLOW, INIT_FAST, INIT_HONDA };
+
+// What each protocol decides on its own: the init that brings it up, how
+// frames are cut and checksummed (FRAMING) and how a request is put on the
+// bus. A new ECU dialect is a new policy plus an enum value and a case in
+// the dispatch functions below.
+//
+// requestData() writes `mode pid ...` into message and returns its length
+// without checksum, 0 if the protocol has no such request.
+
+// Data bytes of an OBD request: mode, PID unless DTC service, frame number for 02 / 05
+inline uint8_t obdRequestData(uint8_t mode, uint8_t pid, uint8_t *data) {
+  data[0] = mode;
+  if (mode == 0x03 || mode == 0x04 || mode == 0x07) return 1;
+  data[1] = pid;
+  if (mode != 0x02 && mode != 0x05) return 2;
+  data[2] = 0x00;
+  return 3;
+}
+
+struct Iso9141Policy {
+  static const KLineInit INIT = INIT_SLOW;
+  static const KLineFraming FRAMING = FRAMING_ISO9141;
+  static const bool OBD_DIAGNOSTICS = true;  // DTC services 03 / 04 / 07
+  static const bool LOCAL_IDENTIFIERS = false;
+
+  static uint8_t requestData(uint8_t mode, uint8_t pid, uint8_t *message) {
+    uint8_t length = obdRequestData(mode, pid, message + 3);
+    message[0] = length == 3 ? 0x69 : 0x68;
+    message[1] = 0x6A;
+    message[2] = 0xF1;
+    return 3 + length;
+  }
+};
+
+// ISO 14230 slow and fast init talk the same once connected
+template <KLineInit Init>
+struct Kwp2000Policy {
+  static const KLineInit INIT = Init;
+  static const KLineFraming FRAMING = FRAMING_KWP2000;
+  static const bool OBD_DIAGNOSTICS = true;
+  static const bool LOCAL_IDENTIFIERS = true;  // Service 0x21
+
+  static uint8_t requestData(uint8_t mode, uint8_t pid, uint8_t *message) {
+    uint8_t length = obdRequestData(mode, pid, message + 3);
+    message[0] = 0xC0 | length;  // Functional address, length in the format byte
+    message[1] = 0x33;
+    message[2] = 0xF1;
+    return 3 + length;
+  }
+};
+
+struct HondaPolicy {
+  static const KLineInit INIT = INIT_HONDA;
+  static const KLineFraming FRAMING = FRAMING_HONDA;
+  static const bool OBD_DIAGNOSTICS = false;
+  static const bool LOCAL_IDENTIFIERS = false;
+
+  // Mode 01 only, the PID is the table number: 72 05 71 <table>
+  static uint8_t requestData(uint8_t mode, uint8_t pid, uint8_t *message) {
+    if (mode != 0x01) return 0;
+    message[0] = 0x72;
+    message[1] = 0x05;  // Whole frame, checksum included
+    message[2] = 0x71;
+    message[3] = pid;
+    return 4;
+  }
+};
+
+// Enum dispatch for a protocol known only at run time. With a constant
+// argument (KLINE_FIXED_PROTOCOL) the switch folds to the one policy.
+// PROTOCOL_AUTOMATIC, before anything is connected, follows KWP2000.
+
+inline KLineInit protocolInit(KLineProtocol protocol) {
+  switch (protocol) {
+    case PROTOCOL_ISO9141: return Iso9141Policy::INIT;
+    case PROTOCOL_ISO14230_FAST: return Kwp2000Policy<INIT_FAST>::INIT;
+    case PROTOCOL_ISO14230_HONDA: return HondaPolicy::INIT;
+    default: return Kwp2000Policy<INIT_SLOW>::INIT;
+  }
+}
+
+inline KLineFraming protocolFraming(KLineProtocol protocol) {
+  switch (protocol) {
+    case PROTOCOL_ISO9141: return Iso9141Policy::FRAMING;
+    case PROTOCOL_ISO14230_HONDA: return HondaPolicy::FRAMING;
+    default: return Kwp2000Policy<INIT_SLOW>::FRAMING;
+  }
+}
+
+inline bool protocolHasObdDiagnostics(KLineProtocol protocol) {
+  switch (protocol) {
+    case PROTOCOL_ISO9141: return Iso9141Policy::OBD_DIAGNOSTICS;
+    case PROTOCOL_ISO14230_HONDA: return HondaPolicy::OBD_DIAGNOSTICS;
+    default: return Kwp2000Policy<INIT_SLOW>::OBD_DIAGNOSTICS;
+  }
+}
+
+inline bool protocolHasLocalIdentifiers(KLineProtocol protocol) {
+  switch (protocol) {
+    case PROTOCOL_ISO14230_SLOW:
+    case PROTOCOL_ISO14230_FAST: return Kwp2000Policy<INIT_SLOW>::LOCAL_IDENTIFIERS;
+    case PROTOCOL_ISO9141: return Iso9141Policy::LOCAL_IDENTIFIERS;
+    default: return false;  // Honda, or not connected
+  }
+}
+
+inline uint8_t protocolRequestData(KLineProtocol protocol, uint8_t mode, uint8_t pid, uint8_t *message) {
+  switch (protocol) {
+    case PROTOCOL_ISO9141: return Iso9141Policy::requestData(mode, pid, message);
+    case PROTOCOL_ISO14230_HONDA: return HondaPolicy::requestData(mode, pid, message);
+    default: return Kwp2000Policy<INIT_SLOW>::requestData(mode, pid, message);
+  }
+}
+
+#endif  // KLINE_PROTOCOL_H
@@ -0,0 +1,85 @@
+#include "LiveChannels.h"
+
+#include "LocalIdBlocks.h"
+
+#include <stdio.h>
+#include <string.h>
+
+int8_t channelByName(const char *name, uint8_t length) {
+  for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+    if (strlen(CHANNEL_NAMES[ch]) == length && strncmp(CHANNEL_NAMES[ch], name, length) == 0) return ch;
+  }
+  return -1;
+}
+
+int8_t channelForPid(uint8_t pid) {
+  switch (pid) {
+    case 0x04: return CH_ENGINE_LOAD;
+    case 0x05: return CH_COOLANT_TEMP;
+    case 0x0B: return CH_MAP;
+    case 0x0C: return CH_ENGINE_SPEED;
+    case 0x0D: return CH_VEHICLE_SPEED;
+    case 0x0E: return CH_IGNITION;
+    case 0x0F: return CH_INTAKE_TEMP;
+    case 0x11: return CH_THROTTLE;
+    case 0x42: return CH_BATTERY;
+    default: return -1;
+  }
+}
+
+float pidValueToChannel(uint8_t pid, float value) {
+  if (pid == 0x0B) return value * 10.0f;  // kPa -> mbar
+  return value;
+}
+
+void hondaToSample(const HondaLiveData &data, LiveSample &sample) {
+  sample.value[CH_ENGINE_SPEED] = data.engineSpeed_rpm;
+  sample.value[CH_THROTTLE] = data.tps_percent;
+  sample.value[CH_COOLANT_TEMP] = data.ect_celsius;
+  sample.value[CH_INTAKE_TEMP] = data.iat_celsius;
+  sample.value[CH_MAP] = data.map_mbar;
+  sample.value[CH_BATTERY] = data.battery_volt;
+  sample.value[CH_VEHICLE_SPEED] = data.vehicleSpeed_kmh;
+  sample.value[CH_IGNITION] = data.ignition_deg;
+  sample.validMask |= HONDA_TABLE17_CHANNELS;
+}
+
+bool decodeFrameData(const uint8_t *data, uint8_t length, LiveSample &sample) {
+  if (length >= 2 + 17 && data[0] == 0x71 && data[1] == 0x17) {
+    HondaLiveData honda;
+    parseHondaTable17(data + 2, honda);
+    hondaToSample(honda, sample);
+    return true;
+  }
+
+  if (length >= 3 && data[0] == 0x41) {
+    uint8_t pid = data[1];
+    int8_t channel = channelForPid(pid);
+    if (channel < 0) return false;
+
+    // Same byte rules as OBD2_KLine::getPID: missing bytes read as 0
+    uint8_t A = data[2];
+    uint8_t B = (length >= 4) ? data[3] : 0;
+    uint8_t C = (length >= 5) ? data[4] : 0;
+    uint8_t D = (length >= 6) ? data[5] : 0;
+    sample.value[channel] = pidValueToChannel(pid, decodePID(pid, A, B, C, D));
+    sample.validMask |= 1 << channel;
+    return true;
+  }
+
+  if (length >= 2 && data[0] == 0x61) {  // KWP2000 local identifier block, if its layout is known
+    const LocalIdLayout *layout = findLocalIdLayout(data[1]);
+    return layout && localIdToSample(*layout, data + 2, length - 2, sample) != 0;
+  }
+
+  return false;
+}
+
+int formatSample(const LiveSample &sample, char *out, int capacity) {
+  int n = snprintf(out, capacity, "t:%lu.%03u", (unsigned long)(sample.timeUs / 1000), (unsigned)(sample.timeUs % 1000));
+  for (uint8_t ch = 0; ch < CHANNEL_COUNT && n < capacity; ch++) {
+    if (!(sample.validMask & (1 << ch))) continue;
+    n += snprintf(out + n, capacity - n, ", %s:%.2f", CHANNEL_NAMES[ch], (double)sample.value[ch]);
+  }
+  return n < capacity ? n : capacity - 1;
+}
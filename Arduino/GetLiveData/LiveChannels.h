@@ -0,0 +1,59 @@
+#ifndef LIVE_CHANNELS_H
+#define LIVE_CHANNELS_H
+
+#include "OBD2_Decode.h"
+
+#include <stddef.h>
+
+// Decoded values in one place, whether they came from a Honda table or an OBD PID
+enum LiveChannel : uint8_t {
+  CH_ENGINE_SPEED,   // rpm
+  CH_THROTTLE,       // %
+  CH_COOLANT_TEMP,   // °C
+  CH_INTAKE_TEMP,    // °C
+  CH_MAP,            // mbar
+  CH_BATTERY,        // V
+  CH_VEHICLE_SPEED,  // km/h
+  CH_INJECTOR,       // ms
+  CH_IGNITION,       // °
+  CH_IACV_PULSE,
+  CH_IACV_CMD,
+  CH_ENGINE_LOAD,    // %
+  CHANNEL_COUNT
+};
+
+const char *const CHANNEL_NAMES[CHANNEL_COUNT] = {
+    "RPM", "TPS", "ECT", "IAT", "MAP", "BATT", "VSS", "INJ", "IGN", "IACV", "IACVC", "LOAD"};
+
+struct LiveSample {
+  uint64_t timeUs;     // First RX byte of the answer the values came from
+  uint16_t validMask;  // bit n set = value[n] holds a reading
+  float value[CHANNEL_COUNT];
+};
+
+// Channel name ("ECT") to channel, -1 if unknown
+int8_t channelByName(const char *name, uint8_t length);
+
+// Mode 01 PID to the channel it feeds, -1 if it has none
+int8_t channelForPid(uint8_t pid);
+
+// getPID() value of a channel's PID converted to the channel unit (MAP kPa -> mbar)
+float pidValueToChannel(uint8_t pid, float value);
+
+// Channels parseHondaTable17() fills in (injector and IACV aren't decoded yet)
+const uint16_t HONDA_TABLE17_CHANNELS = (1 << CH_ENGINE_SPEED) | (1 << CH_THROTTLE) | (1 << CH_COOLANT_TEMP) |
+                                        (1 << CH_INTAKE_TEMP) | (1 << CH_MAP) | (1 << CH_BATTERY) |
+                                        (1 << CH_VEHICLE_SPEED) | (1 << CH_IGNITION);
+
+void hondaToSample(const HondaLiveData &data, LiveSample &sample);
+
+// Decodes the data of one answer frame (service id onwards): a Honda table
+// 0x17 read, a mode 01 PID or a KWP2000 0x21 block with a layout set
+// (LocalIdBlocks.h). Returns false if it carries no channel.
+bool decodeFrameData(const uint8_t *data, uint8_t length, LiveSample &sample);
+
+// "t:1234.567, RPM:3000, TPS:12.5, ..." (time in ms) with the valid channels only;
+// returns the length
+int formatSample(const LiveSample &sample, char *out, int capacity);
+
+#endif  // LIVE_CHANNELS_H
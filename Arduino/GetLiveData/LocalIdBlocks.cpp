@@ -0,0 +1,67 @@
+#include "LocalIdBlocks.h"
+
+#include <math.h>
+
+static LocalIdLayout layouts[LOCAL_ID_MAX_LAYOUTS];
+static uint8_t layoutCount = 0;
+
+const LocalIdField SIMULATOR_BLOCK_01[9] = {
+    {{0, 2, 1.0f, 4.0f, 0.0f}, CH_ENGINE_SPEED},      // rpm, like PID 0C
+    {{2, 1, 100.0f, 255.0f, 0.0f}, CH_THROTTLE},      // %
+    {{3, 1, 1.0f, 1.0f, -40.0f}, CH_COOLANT_TEMP},    // °C
+    {{4, 1, 1.0f, 1.0f, -40.0f}, CH_INTAKE_TEMP},     // °C
+    {{5, 1, 10.0f, 1.0f, 0.0f}, CH_MAP},              // kPa -> mbar
+    {{6, 1, 1.0f, 10.0f, 0.0f}, CH_BATTERY},          // V
+    {{7, 1, 1.0f, 1.0f, 0.0f}, CH_VEHICLE_SPEED},     // km/h
+    {{8, 1, 1.0f, 2.0f, -64.0f}, CH_IGNITION},        // °, like PID 0E
+    {{9, 1, 100.0f, 255.0f, 0.0f}, CH_ENGINE_LOAD},   // %
+};
+
+bool setLocalIdLayout(uint8_t localId, const LocalIdField *fields, uint8_t count) {
+  for (uint8_t i = 0; i < layoutCount; i++) {
+    if (layouts[i].localId == localId) {
+      layouts[i] = {localId, count, fields};
+      return true;
+    }
+  }
+  if (layoutCount >= LOCAL_ID_MAX_LAYOUTS) return false;
+  layouts[layoutCount++] = {localId, count, fields};
+  return true;
+}
+
+void clearLocalIdLayouts() {
+  layoutCount = 0;
+}
+
+const LocalIdLayout *findLocalIdLayout(uint8_t localId) {
+  for (uint8_t i = 0; i < layoutCount; i++) {
+    if (layouts[i].localId == localId) return &layouts[i];
+  }
+  return nullptr;
+}
+
+static bool fits(const ScaledField &field, uint8_t length) {
+  return field.offset + field.size <= length;
+}
+
+uint8_t decodeLocalIdBlock(const LocalIdLayout &layout, const uint8_t *record, uint8_t length, float *values,
+                           uint8_t capacity) {
+  uint8_t count = layout.fieldCount < capacity ? layout.fieldCount : capacity;
+  for (uint8_t i = 0; i < count; i++) {
+    const ScaledField &field = layout.fields[i].scale;
+    values[i] = fits(field, length) ? decodeField(field, record) : NAN;
+  }
+  return count;
+}
+
+uint16_t localIdToSample(const LocalIdLayout &layout, const uint8_t *record, uint8_t length, LiveSample &sample) {
+  uint16_t mask = 0;
+  for (uint8_t i = 0; i < layout.fieldCount; i++) {
+    const LocalIdField &field = layout.fields[i];
+    if (field.channel >= CHANNEL_COUNT || !fits(field.scale, length)) continue;
+    sample.value[field.channel] = decodeField(field.scale, record);
+    mask |= 1 << field.channel;
+  }
+  sample.validMask |= mask;
+  return mask;
+}
@@ -0,0 +1,45 @@
+#ifndef LOCAL_ID_BLOCKS_H
+#define LOCAL_ID_BLOCKS_H
+
+#include "ScaledField.h"
+#include "LiveChannels.h"
+
+#ifndef LOCAL_ID_MAX_LAYOUTS
+#define LOCAL_ID_MAX_LAYOUTS 4
+#endif
+
+// KWP2000 readDataByLocalIdentifier (0x21): one request returns a whole block
+// of values, 61 <local id> <record>. What sits where in the record is up to
+// the ECU maker, so every block read needs a layout set for its local id.
+
+const uint8_t LOCAL_ID_NO_CHANNEL = 0xFF;
+
+struct LocalIdField {
+  ScaledField scale;  // Offset counted from the first record byte (after 61 <local id>)
+  uint8_t channel;    // LiveChannel the value feeds, LOCAL_ID_NO_CHANNEL if none
+};
+
+struct LocalIdLayout {
+  uint8_t localId;
+  uint8_t fieldCount;
+  const LocalIdField *fields;  // Not copied, keep the array alive (a const table)
+};
+
+// Replaces the layout of the same local id; false if the table is full
+bool setLocalIdLayout(uint8_t localId, const LocalIdField *fields, uint8_t count);
+void clearLocalIdLayouts();
+const LocalIdLayout *findLocalIdLayout(uint8_t localId);  // nullptr if none was set
+
+// Values of the record in field order; a field past the end of the record is NAN.
+// Returns the number of values written.
+uint8_t decodeLocalIdBlock(const LocalIdLayout &layout, const uint8_t *record, uint8_t length, float *values,
+                           uint8_t capacity);
+
+// The fields that feed a channel into sample; returns the channels set
+uint16_t localIdToSample(const LocalIdLayout &layout, const uint8_t *record, uint8_t length, LiveSample &sample);
+
+// Block 0x01 as the ECU simulator answers it: RPM, TPS, ECT, IAT, MAP, BATT,
+// VSS, IGN and LOAD in mode 01 scaling. A starting point for a real ECU's layout.
+extern const LocalIdField SIMULATOR_BLOCK_01[9];
+
+#endif  // LOCAL_ID_BLOCKS_H
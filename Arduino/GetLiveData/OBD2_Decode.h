@@ -0,0 +1,37 @@
+#ifndef OBD2_DECODE_H
+#define OBD2_DECODE_H
+
+#include <stdint.h>
+
+// Decoding that doesn't need the bus, shared by the reader and host tools
+
+// Honda data
+struct HondaLiveData {
+  float engineSpeed_rpm;
+  float tps_percent;
+  int   ect_celsius;
+  int   iat_celsius;
+  int   map_mbar;
+  float battery_volt;
+  int   vehicleSpeed_kmh;
+  float injector_ms;
+  float ignition_deg;
+  int   iacv_pulse;
+  int   iacv_cmd;
+  uint64_t timeUs;  // First RX byte of the answer (set by getHondaLiveData, not by the parser)
+};
+
+// Mode 01/02 PID value from its data bytes, -4 for an unknown PID
+float decodePID(uint8_t pid, uint8_t A, uint8_t B, uint8_t C, uint8_t D);
+
+// Table 0x17 payload (the bytes after 71 17) of a Honda ECU
+void parseHondaTable17(const uint8_t* payload, HondaLiveData& data);
+
+// Writes the 5-character code ("P0171") of a DTC plus a terminating 0 into out[6]
+void formatDTC(uint8_t byte1, uint8_t byte2, char *out);
+
+inline void formatDTC(uint16_t code, char *out) {
+  formatDTC((uint8_t)(code >> 8), (uint8_t)(code & 0xFF), out);
+}
+
+#endif  // OBD2_DECODE_H
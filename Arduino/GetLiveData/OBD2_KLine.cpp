@@ -1,7 +1,9 @@
 #include "OBD2_KLine.h"
 
+#include "LocalIdBlocks.h"
+
 OBD2_KLine::OBD2_KLine(SerialType &serialPort, uint32_t baudRate, uint8_t rxPin, uint8_t txPin)
-    : _serial(&serialPort), _rxPin(rxPin), _txPin(txPin), _baudRate(baudRate) {
+    : _serial(&serialPort), _baudRate(baudRate), _rxPin(rxPin), _txPin(txPin) {
   // Start serial
   setSerial(true);
 }
@@ -30,18 +32,11 @@ bool OBD2_KLine::initOBD2() {
 
   debugPrintln(F("Initializing OBD2..."));
 
-  if (selectedProtocol == "Automatic" || selectedProtocol == "ISO14230_Slow" || selectedProtocol == "ISO9141") {
-    if (trySlowInit()) return true;
-  }
-
-  if (selectedProtocol == "Automatic" || selectedProtocol == "ISO14230_Fast") {
-    if (tryFastInit()) return true;
-  }
-
-  if (selectedProtocol == "Automatic" || selectedProtocol == "ISO14230_Honda") {
-    if (tryHondaInit()) return true;
-  }
+  if (mayTry(INIT_SLOW) && trySlowInit()) return true;
+  if (mayTry(INIT_FAST) && tryFastInit()) return true;
+  if (mayTry(INIT_HONDA) && tryHondaInit()) return true;
 
+  _protocol = _selectedProtocol;  // Not left on the last init tried
   debugPrintln(F("❌ No Protocol Matched. Initialization Failed."));
   debugPrintln(F(""));
   return false;
@@ -49,6 +44,7 @@ bool OBD2_KLine::initOBD2() {
 
 bool OBD2_KLine::tryHondaInit() {
   debugPrintln(F("🔁 Trying ISO9141 / ISO14230_Honda"));
+  _protocol = PROTOCOL_ISO14230_HONDA;  // Honda checksum on the init frames
 
   setSerial(false);
 
@@ -66,11 +62,10 @@ bool OBD2_KLine::tryHondaInit() {
   readData();
 
 
-  if (resultBuffer[3] == 0xFA || resultBuffer[0] == 0x02) {
+  if (_response[3] == 0xFA || _response[0] == 0x02) {
     debugPrintln(F("✅ Protocol Detected: ISO14230_Honda"));
     debugPrintln(F("✅ Connection established with car"));
     connectionStatus = true;
-    connectedProtocol = "ISO14230_Honda";
     return true;
   }
 
@@ -79,6 +74,7 @@ bool OBD2_KLine::tryHondaInit() {
 
 bool OBD2_KLine::trySlowInit() {
   debugPrintln(F("🔁 Trying ISO9141 / ISO14230_Slow"));
+  _protocol = PROTOCOL_ISO14230_SLOW;
 
   setSerial(false);
   send5baud(0x33);
@@ -90,14 +86,14 @@ bool OBD2_KLine::trySlowInit() {
     setInterByteTimeout(60);
     return false;
   }
-  if (resultBuffer[0] != 0x55) return false;
+  if (_response[0] != 0x55) return false;
 
-  String detectedProtocol = (resultBuffer[1] == resultBuffer[2]) ? "ISO9141" : "ISO14230_Slow";
+  KLineProtocol detectedProtocol = (_response[1] == _response[2]) ? PROTOCOL_ISO9141 : PROTOCOL_ISO14230_SLOW;
   debugPrint(F("✅ Protocol Detected: "));
-  debugPrintln(detectedProtocol.c_str());
+  debugPrintln(protocolName(detectedProtocol));
 
   debugPrintln(F("Writing inverted KW2"));
-  _serial->write(~resultBuffer[2]);
+  _serial->write(~_response[2]);
   delay(_byteWriteInterval);
   clearEcho();
 
@@ -105,9 +101,9 @@ bool OBD2_KLine::trySlowInit() {
 
   if (!readData()) return false;
 
-  if (resultBuffer[0] == 0xCC) {
+  if (_response[0] == 0xCC) {
     connectionStatus = true;
-    connectedProtocol = detectedProtocol;
+    _protocol = detectedProtocol;
     debugPrintln(F("✅ Connection established with car"));
     return true;
   }
@@ -118,6 +114,7 @@ bool OBD2_KLine::trySlowInit() {
 
 bool OBD2_KLine::tryFastInit() {
   debugPrintln(F("🔁 Trying ISO14230_Fast"));
+  _protocol = PROTOCOL_ISO14230_FAST;
 
   setSerial(false);
 
@@ -131,11 +128,10 @@ bool OBD2_KLine::tryFastInit() {
 
   if (!readData()) return false;
 
-  if (resultBuffer[3] == 0xC1) {
+  if (_response[3] == 0xC1) {
     debugPrintln(F("✅ Protocol Detected: ISO14230_Fast"));
     debugPrintln(F("✅ Connection established with car"));
     connectionStatus = true;
-    connectedProtocol = "ISO14230_Fast";
     return true;
   }
 
@@ -150,7 +146,7 @@ void OBD2_KLine::writeRawData(const uint8_t *dataArray, uint8_t length) {
   sendData[length] = calculateChecksum(dataArray, length);
 
   debugPrint(F("> : [ "));
-  for (size_t i = 0; i < length + 1; i++) {
+  for (size_t i = 0; i < (size_t)length + 1; i++) {
     _serial->write(sendData[i]);
     debugPrintHex(sendData[i]);
     debugPrint(F(" "));
@@ -161,38 +157,16 @@ void OBD2_KLine::writeRawData(const uint8_t *dataArray, uint8_t length) {
   clearEcho();
 }
 
-void OBD2_KLine::writeData(uint8_t mode, uint8_t pid) {
-  uint8_t message[7] = {0};
-  size_t length = (mode == read_FreezeFrame || mode == test_OxygenSensors)                    ? 7 :
-                  (mode == read_storedDTCs || mode == clear_DTCs || mode == read_pendingDTCs) ? 5 :
-                                                                                                6;
-
-  if (connectedProtocol == "ISO9141") {
-    message[0] = (mode == read_FreezeFrame || mode == test_OxygenSensors) ? 0x69 : 0x68;
-    message[1] = 0x6A;
-    message[2] = 0xF1;
-    message[3] = mode;
-  } else if (connectedProtocol == "ISO14230_Fast" || connectedProtocol == "ISO14230_Slow") {
-    message[0] = (mode == read_FreezeFrame || mode == test_OxygenSensors)                    ? 0xC3 :
-                 (mode == read_storedDTCs || mode == clear_DTCs || mode == read_pendingDTCs) ? 0xC1 :
-                                                                                               0xC2;
-    message[1] = 0x33;
-    message[2] = 0xF1;
-    message[3] = mode;
-  } else if (connectedProtocol == "ISO14230_Honda") {
-    if (mode == read_LiveData) {
-      length = 5;
-      message[0] = 0x72;
-      message[1] = 0x05;
-      message[2] = 0x71;
-      message[3] = pid;
-    }
+bool OBD2_KLine::writeData(uint8_t mode, uint8_t pid) {
+  uint8_t message[7];
+  uint8_t length = protocolRequestData(protocol(), mode, pid, message);
+  if (length == 0) {
+    debugPrintln(F("⚠️ Request not available in this protocol."));
+    return false;
   }
 
-  if (length > 5) message[4] = pid;
-  if (length == 7) message[5] = 0x00;
-
-  message[length - 1] = calculateChecksum(message, length - 1);
+  message[length] = calculateChecksum(message, length);
+  length++;
 
   debugPrint(F("> : ["));
   for (size_t i = 0; i < length; i++) {
@@ -204,38 +178,63 @@ void OBD2_KLine::writeData(uint8_t mode, uint8_t pid) {
   debugPrintln(F("]"));
 
   clearEcho();
+  return true;
 }
 
 uint8_t OBD2_KLine::readData() {
   debugPrintln(F("Reading..."));
   unsigned long startMillis = millis();
-  int bytesRead = 0;
+  uint16_t bytesRead = 0;
+  _response.release();  // Back to the pool unless someone else still holds it
 
   // Wait for data for the specified timeout
   while (millis() - startMillis < _readTimeout) {
     if (_serial->available() > 0) {
       unsigned long lastByteTime = millis();
-      memset(resultBuffer, 0, sizeof(resultBuffer));
+      FrameBuffer *buffer = _framePool.acquire();
+      if (!buffer) {  // Every buffer still held by consumers: drop the answer, keep the bus in step
+        debugPrintln(F("⚠️ No free receive buffer. Answer dropped."));
+        while (millis() - lastByteTime < _interByteTimeout) {
+          if (_serial->available() > 0) {
+            _serial->read();
+            lastByteTime = millis();
+          }
+        }
+        return 0;
+      }
+      buffer->frames.begin(protocolFraming(protocol()), buffer->data);
       updateConnectionStatus(true);
 
       // Read all data
       debugPrint(F("✅ < [ "));
       while (millis() - lastByteTime < _interByteTimeout) {  // Wait for new data for 60ms
         if (_serial->available() > 0) {                      // If new data is available
-          if (bytesRead >= sizeof(resultBuffer)) {           // Stop if buffer is full
+          if (bytesRead >= sizeof(buffer->data)) {           // Stop if buffer is full
             debugPrintln(F("\n⚠️ Buffer is full. Stopping data reception."));
-            return bytesRead;
+            buffer->status = FRAME_OVERFLOW;
+            break;
           }
 
-          resultBuffer[bytesRead] = _serial->read();
-          debugPrintHex(resultBuffer[bytesRead]);
-          debugPrint(F(" "));
+          buffer->data[bytesRead] = _serial->read();
+          uint64_t rxTimeUs = klineTimeUs();
+          if (bytesRead == 0) buffer->timeUs = rxTimeUs;
           bytesRead++;
+          buffer->frames.feed(bytesRead, false, rxTimeUs);  // Cut frames while the next byte is on the wire
+          debugPrintHex(buffer->data[bytesRead - 1]);
+          debugPrint(F(" "));
           lastByteTime = millis();  // Reset last byte_time
         }
       }
 
-      debugPrintln(F("]\n✅ Data reception completed."));
+      buffer->frames.feed(bytesRead, true);
+      buffer->length = bytesRead;
+      if (buffer->status == FRAME_OK && buffer->frames.droppedBytes() > 0) buffer->status = FRAME_DROPPED;
+      _response = FrameView::adopt(buffer);
+
+      debugPrint(F("]\n✅ Data reception completed. Frames: "));
+#if KLINE_DEBUG
+      debugPrintln(String(frames().frameCount()).c_str());
+#endif
       return bytesRead;
     }
   }
@@ -273,11 +272,17 @@ float OBD2_KLine::getFreezeFrame(uint8_t pid) {
 }
 
 bool OBD2_KLine::getHondaLiveData(uint8_t pid, HondaLiveData& data) {
-  writeData(read_LiveData, pid);
+  if (!writeData(read_LiveData, pid)) return false;
   int len = readData();
 
-  if (len > 4 && resultBuffer[0] == 0x02 && resultBuffer[2] == 0x71 && resultBuffer[3] == pid) {
-    if (pid == 0x17) parseHondaTable17(&resultBuffer[4], data);
+  int8_t index = frames().find(0x71, pid, 0x02);
+  if (len > 4 && index >= 0) {
+    if (pid == 0x17) {
+      if (frames().frame(index).dataLength < 2 + 17) return false;  // Short table: no fresh stamp on the old values
+      parseHondaTable17(frames().data(index) + 2, data);
+    }
+    _responseTimeUs = frames().frame(index).timeUs;
+    data.timeUs = _responseTimeUs;
     return true;
   }
 
@@ -285,195 +290,76 @@ bool OBD2_KLine::getHondaLiveData(uint8_t pid, HondaLiveData& data) {
 }
 
 float OBD2_KLine::getPID(uint8_t mode, uint8_t pid) {
-  writeData(mode, pid);
+  if (!protocolHasObdDiagnostics(protocol())) return -3;  // Honda answers table reads, not OBD PIDs
+#if KLINE_SUPPORTED_PIDS
+  if (!supportedPids.mayRequest(mode, pid)) return -3;  // Not supported by the ECU, don't spend bus time
+#endif
+
+  if (!writeData(mode, pid)) return -3;
   int len = readData();
 
-  if (len <= 0) return -1;                // Data not received
-  if (resultBuffer[4] != pid) return -2;  // Unexpected PID
-
-  uint8_t A = 0, B = 0, C = 0, D = 0;
-
-  if (mode == read_LiveData) {
-    int dataBytesLen = len - 6;
-    A = (dataBytesLen >= 1) ? resultBuffer[5] : 0;
-    B = (dataBytesLen >= 2) ? resultBuffer[6] : 0;
-    C = (dataBytesLen >= 3) ? resultBuffer[7] : 0;
-    D = (dataBytesLen >= 4) ? resultBuffer[8] : 0;
-  } else if (mode == read_FreezeFrame) {
-    int dataBytesLen = len - 7;
-    A = (dataBytesLen >= 1) ? resultBuffer[6] : 0;
-    B = (dataBytesLen >= 2) ? resultBuffer[7] : 0;
-    C = (dataBytesLen >= 3) ? resultBuffer[8] : 0;
-    D = (dataBytesLen >= 4) ? resultBuffer[9] : 0;
-  }
+  if (len <= 0) return -1;  // Data not received
 
-  switch (pid) {
-    case 0x01:                                      // Monitor Status Since DTC Cleared (bit encoded)
-    case 0x02:                                      // Monitor Status Since DTC Cleared (bit encoded)
-    case 0x03:                                      // Fuel System Status (bit encoded)
-      return A;                                     //
-    case 0x04:                                      // Engine Load (%)
-      return A * 100.0f / 255.0f;                   //
-    case 0x05:                                      // Coolant Temperature (°C)
-      return A - 40.0f;                             //
-    case 0x06:                                      // Short Term Fuel Trim Bank 1 (%)
-    case 0x07:                                      // Long Term Fuel Trim Bank 1 (%)
-    case 0x08:                                      // Short Term Fuel Trim Bank 2 (%)
-    case 0x09:                                      // Long Term Fuel Trim Bank 2 (%)
-      return A * 100.0f / 128.0f - 100.0f;          //
-    case 0x0A:                                      // Fuel Pressure (kPa)
-      return A * 3.0f;                              //
-    case 0x0B:                                      // Intake Manifold Absolute Pressure (kPa)
-      return A;                                     //
-    case 0x0C:                                      // RPM
-      return ((A * 256.0f) + B) / 4.0f;             //
-    case 0x0D:                                      // Speed (km/h)
-      return A;                                     //
-    case 0x0E:                                      // Timing Advance (°)
-      return A / 2.0f - 64.0f;                      //
-    case 0x0F:                                      // Intake Air Temperature (°C)
-      return A - 40.0f;                             //
-    case 0x10:                                      // MAF Flow Rate (grams/sec)
-      return ((A * 256.0f) + B) / 100.0f;           //
-    case 0x11:                                      // Throttle Position (%)
-      return A * 100.0f / 255.0f;                   //
-    case 0x12:                                      // Commanded Secondary Air Status (bit encoded)
-    case 0x13:                                      // Oxygen Sensors Present 2 Banks (bit encoded)
-      return A;                                     //
-    case 0x14:                                      // Oxygen Sensor 1A Voltage (V, %)
-    case 0x15:                                      // Oxygen Sensor 2A Voltage (V, %)
-    case 0x16:                                      // Oxygen Sensor 3A Voltage (V, %)
-    case 0x17:                                      // Oxygen Sensor 4A Voltage (V, %)
-    case 0x18:                                      // Oxygen Sensor 5A Voltage (V, %)
-    case 0x19:                                      // Oxygen Sensor 6A Voltage (V, %)
-    case 0x1A:                                      // Oxygen Sensor 7A Voltage (V, %)
-    case 0x1B:                                      // Oxygen Sensor 8A Voltage (V, %)
-      return A / 200.0f;                            // Voltage
-    case 0x1C:                                      // OBD Standards This Vehicle Conforms To (bit encoded)
-    case 0x1D:                                      // Oxygen Sensors Present 4 Banks (bit encoded)
-    case 0x1E:                                      // Auxiliary Input Status (bit encoded)
-      return A;                                     //
-    case 0x1F:                                      // Run Time Since Engine Start (seconds)
-    case 0x21:                                      // Distance Traveled With MIL On (km)
-      return (A * 256.0f) + B;                      //
-    case 0x22:                                      // Fuel Rail Pressure (kPa)
-      return ((A * 256.0f) + B) * 0.079f;           //
-    case 0x23:                                      // Fuel Rail Gauge Pressure (kPa)
-      return ((A * 256.0f) + B) / 10.0f;            //
-    case 0x24:                                      // Oxygen Sensor 1B (ratio, voltage)
-    case 0x25:                                      // Oxygen Sensor 2B (ratio, voltage)
-    case 0x26:                                      // Oxygen Sensor 3B (ratio, voltage)
-    case 0x27:                                      // Oxygen Sensor 4B (ratio, voltage)
-    case 0x28:                                      // Oxygen Sensor 5B (ratio, voltage)
-    case 0x29:                                      // Oxygen Sensor 6B (ratio, voltage)
-    case 0x2A:                                      // Oxygen Sensor 7B (ratio, voltage)
-    case 0x2B:                                      // Oxygen Sensor 8B (ratio, voltage)
-      return ((A * 256.0f) + B) / 32768.0f;         // ratio
-    case 0x2C:                                      // Commanded EGR (%)
-      return A * 100.0f / 255.0f;                   //
-    case 0x2D:                                      // EGR Error (%)
-      return A * 100.0f / 128.0f - 100.0f;          //
-    case 0x2E:                                      // Commanded Evaporative Purge (%)
-    case 0x2F:                                      // Fuel Tank Level Input (%)
-      return A * 100.0f / 255.0f;                   //
-    case 0x30:                                      // Warm-ups Since Codes Cleared (count)
-      return A;                                     //
-    case 0x31:                                      // Distance Traveled Since Codes Cleared (km)
-      return (A * 256.0f) + B;                      //
-    case 0x32:                                      // Evap System Vapor Pressure (Pa)
-      return ((A * 256.0f) + B) / 4.0f;             //
-    case 0x33:                                      // Absolute Barometric Pressure (kPa)
-      return A;                                     //
-    case 0x34:                                      // Oxygen Sensor 1C (current)
-    case 0x35:                                      // Oxygen Sensor 2C
-    case 0x36:                                      // Oxygen Sensor 3C
-    case 0x37:                                      // Oxygen Sensor 4C
-    case 0x38:                                      // Oxygen Sensor 5C
-    case 0x39:                                      // Oxygen Sensor 6C
-    case 0x3A:                                      // Oxygen Sensor 7C
-    case 0x3B:                                      // Oxygen Sensor 8C
-      return ((A * 256.0f) + B) / 32768.0f;         // ratio
-    case 0x3C:                                      // Catalyst Temperature Bank 1 Sensor 1 (°C)
-    case 0x3D:                                      // Catalyst Temperature Bank 2 Sensor 1 (°C)
-    case 0x3E:                                      // Catalyst Temperature Bank 1 Sensor 2 (°C)
-    case 0x3F:                                      // Catalyst Temperature Bank 2 Sensor 2 (°C)
-      return ((A * 256.0f) + B) / 10.0f - 40.0f;    //
-    case 0x41:                                      // Monitor status this drive cycle (bit encoded)
-      return A;                                     //
-    case 0x42:                                      // Control module voltage (V)
-      return ((A * 256.0f) + B) / 1000.0f;          //
-    case 0x43:                                      // Absolute load value (%)
-      return ((A * 256.0f) + B) * 100.0f / 255.0f;  //
-    case 0x44:                                      // Fuel/Air commanded equivalence ratio (lambda)
-      return ((A * 256.0f) + B) / 32768.0f;         // ratio
-    case 0x45:                                      // Relative throttle position (%)
-      return A * 100.0f / 255.0f;                   //
-    case 0x46:                                      // Ambient air temp (°C)
-      return A - 40.0f;                             //
-    case 0x47:                                      // Absolute throttle position B (%)
-    case 0x48:                                      // Absolute throttle position C (%)
-    case 0x49:                                      // Accelerator pedal position D (%)
-    case 0x4A:                                      // Accelerator pedal position E (%)
-    case 0x4B:                                      // Accelerator pedal position F (%)
-    case 0x4C:                                      // Commanded throttle actuator (%)
-      return A * 100.0f / 255.0f;                   //
-    case 0x4D:                                      // Time run with MIL on (min)
-    case 0x4E:                                      // Time since trouble codes cleared (min)
-      return (A * 256.0f) + B;                      //
-    case 0x4F:                                      // Max values for sensors (ratio, V, mA, kPa)
-    case 0x50:                                      // Maximum value for air flow rate from mass air flow sensor (g/s)
-    case 0x51:                                      // Fuel Type (bit encoded)
-      return A;                                     //
-    case 0x52:                                      // Ethanol fuel (%)
-      return A * 100.0f / 255.0f;                   //
-    case 0x53:                                      // Absolute evap system pressure (kPa)
-      return ((A * 256.0f) + B) / 200.0f;           //
-    case 0x54:                                      // Evap system vapor pressure (Pa)
-      return (A * 256.0f) + B;                      //
-    case 0x55:                                      // Short term secondary oxygen sensor trim, A: bank 1, B: bank 3 (%)
-    case 0x56:                                      // Long term primary oxygen sensor trim, A: bank 1, B: bank 3 (%)
-    case 0x57:                                      // Short term secondary oxygen sensor trim, A: bank 2, B: bank 4 (%)
-    case 0x58:                                      // Long term secondary oxygen sensor trim, A: bank 2, B: bank 4 (%)
-      return A * 100.0f / 128.0f - 100.0f;          //
-    case 0x59:                                      // Fuel rail absolute pressure (kPa)
-      return ((A * 256.0f) + B) * 10.0f;            //
-    case 0x5A:                                      // Relative accelerator pedal position (%)
-    case 0x5B:                                      // Hybrid battery pack remaining life (%)
-      return A * 100.0f / 255.0f;                   //
-    case 0x5C:                                      // Engine oil temperature (°C)
-      return A - 40.0f;                             //
-    case 0x5D:                                      // Fuel injection timing (°)
-      return ((A * 256.0f) + B) / 128.0f - 210.0f;  //
-    case 0x5E:                                      // Engine fuel rate (L/h)
-      return ((A * 256.0f) + B) / 20.0f;            //
-    case 0x5F:                                      // Emission requirements to which vehicle is designed (bit encoded)
-      return A;                                     //
-    case 0x61:                                      // Driver's demand engine - percent torque (%)
-    case 0x62:                                      // Actual engine - percent torque (%)
-      return A - 125.0f;                            //
-    case 0x63:                                      // Engine reference torque (Nm)
-      return (A * 256.0f) + B;                      //
-    default:                                        //
-      return -4;                                    // Unknown PID
-  }
+  int8_t index = frames().find(0x40 + mode, pid);
+  if (index < 0) return -2;  // Unexpected PID
+
+  // Data: <0x40 + mode> <pid> [frame number for mode 02] A B C D
+  const uint8_t *frameData = frames().data(index);
+  int valueStart = (mode == read_FreezeFrame) ? 3 : 2;
+  int dataBytesLen = frames().frame(index).dataLength - valueStart;
+
+  uint8_t A = (dataBytesLen >= 1) ? frameData[valueStart] : 0;
+  uint8_t B = (dataBytesLen >= 2) ? frameData[valueStart + 1] : 0;
+  uint8_t C = (dataBytesLen >= 3) ? frameData[valueStart + 2] : 0;
+  uint8_t D = (dataBytesLen >= 4) ? frameData[valueStart + 3] : 0;
+
+  _responseTimeUs = frames().frame(index).timeUs;
+  return decodePID(pid, A, B, C, D);
+}
+
+// Sends 21 <localId>; the record after 61 <localId> and its length, or < 0
+int OBD2_KLine::requestLocalIdentifier(uint8_t localId, const uint8_t *&record) {
+  if (!protocolHasLocalIdentifiers(protocol())) return -3;  // KWP2000 service
+
+  if (!writeData(read_LocalIdentifier, localId)) return -3;
+  if (readData() <= 0) return -1;  // Data not received
+
+  int8_t index = frames().find(0x40 + read_LocalIdentifier, localId);
+  if (index < 0) return -2;  // Negative answer or not the block asked for
+
+  record = frames().data(index) + 2;
+  _responseTimeUs = frames().frame(index).timeUs;
+  return frames().frame(index).dataLength - 2;
+}
+
+int OBD2_KLine::readLocalIdentifier(uint8_t localId, float *values, uint8_t capacity) {
+  const LocalIdLayout *layout = findLocalIdLayout(localId);
+  if (!layout) return -3;
+
+  const uint8_t *record = nullptr;
+  int length = requestLocalIdentifier(localId, record);
+  if (length < 0) return length;
+  return decodeLocalIdBlock(*layout, record, length, values, capacity);
+}
+
+bool OBD2_KLine::readLocalIdentifier(uint8_t localId, LiveSample &sample) {
+  const LocalIdLayout *layout = findLocalIdLayout(localId);
+  if (!layout) return false;
+
+  const uint8_t *record = nullptr;
+  int length = requestLocalIdentifier(localId, record);
+  if (length < 0) return false;
+  sample.timeUs = _responseTimeUs;
+  return localIdToSample(*layout, record, length, sample) != 0;
 }
 
 void OBD2_KLine::parseHondaTable17(const uint8_t* payload, HondaLiveData& data) {
-  data.engineSpeed_rpm = (uint16_t)((payload[0] << 8) + payload[1]);
-  data.tps_percent = (float)(payload[3] * 5 / 256.0f);
-  data.iat_celsius = (int)payload[5] - 40;
-  data.ect_celsius = (int)payload[7] - 40;
-  data.map_mbar = payload[9] * 10;
-  data.battery_volt = (float)payload[10] /10.0f;
-  data.vehicleSpeed_kmh = (int)payload[16];
-  data.ignition_deg = (float)(payload[4] / 2.0f) - 64.0f;
-  data.injector_ms = 0.0f; // TODO: Implement this
-  data.iacv_pulse = 0; // TODO: Implement this
-  data.iacv_cmd = 0; // TODO: Implement this
+  ::parseHondaTable17(payload, data);
 }
 
 // ----------------------------------- DTCs -----------------------------------
 
+#if KLINE_DTC_STORAGE
 uint8_t OBD2_KLine::readStoredDTCs() {
   return readDTCs(0x03);
 }
@@ -483,10 +369,6 @@ uint8_t OBD2_KLine::readPendingDTCs() {
 }
 
 uint8_t OBD2_KLine::readDTCs(uint8_t mode) {
-  // Request: C2 33 F1 03 F3
-  // example Response: 87 F1 11 43 01 70 01 34 00 00 72
-  // example Response: 87 F1 11 43 00 00 CC
-  int dtcCount = 0;
   String *targetArray = nullptr;
 
   if (mode == read_storedDTCs) {
@@ -497,40 +379,73 @@ uint8_t OBD2_KLine::readDTCs(uint8_t mode) {
     return -1;  // Invalid mode
   }
 
-  writeData(mode, 0x00);
+  uint16_t codes[KLINE_MAX_DTCS];
+  int dtcCount = readDTCCodes(mode, codes, KLINE_MAX_DTCS);
+  if (dtcCount < 0) return 0;
 
-  int len = readData();
-  if (len >= 3) {
-    for (int i = 0; i < len - 5; i += 2) {
-      uint8_t b1 = resultBuffer[4 + i];
-      uint8_t b2 = resultBuffer[4 + i + 1];
+  for (int i = 0; i < dtcCount; i++) {
+    targetArray[i] = decodeDTC(codes[i] >> 8, codes[i] & 0xFF);
+  }
 
-      if (b1 == 0 && b2 == 0) break;
+  return dtcCount;
+}
+#endif
 
-      targetArray[dtcCount++] = decodeDTC(b1, b2);
+int OBD2_KLine::readDTCCodes(uint8_t mode, uint16_t *codes, uint8_t capacity) {
+  // Request: C2 33 F1 03 F3
+  // example Response: 87 F1 11 43 01 70 01 34 00 00 72
+  // example Response: 87 F1 11 43 00 00 CC
+  if (mode != read_storedDTCs && mode != read_pendingDTCs) return -1;  // Invalid mode
+  if (!protocolHasObdDiagnostics(protocol())) return -1;               // Honda tables have no OBD DTC service
+
+  if (!writeData(mode, 0x00)) return -1;
+  if (!readData()) return -1;
+
+  // Every ECU with codes sends one or more frames of up to three DTCs each
+  int dtcCount = 0;
+  bool answered = false;
+  for (uint8_t f = 0; f < frames().frameCount(); f++) {
+    const uint8_t *frameData = frames().data(f);
+    uint8_t frameLength = frames().frame(f).dataLength;
+    if (frameLength < 1 || frameData[0] != 0x40 + mode) continue;
+    answered = true;
+
+    for (uint8_t i = 1; i + 1 < frameLength && dtcCount < capacity; i += 2) {
+      uint8_t b1 = frameData[i];
+      uint8_t b2 = frameData[i + 1];
+
+      if (b1 == 0 && b2 == 0) continue;  // Padding of a partly filled frame
+
+      codes[dtcCount++] = ((uint16_t)b1 << 8) | b2;
     }
   }
 
-  return dtcCount;
+  // A 7F refusal, another service's answer or a dropped frame says nothing about the codes
+  return answered ? dtcCount : -1;
 }
 
+#if KLINE_DTC_STORAGE
 String OBD2_KLine::getStoredDTC(uint8_t index) {
-  if (index >= 0) return storedDTCBuffer[index];
+  if (index < KLINE_MAX_DTCS) return storedDTCBuffer[index];
   return "";
 }
 
 String OBD2_KLine::getPendingDTC(uint8_t index) {
-  if (index >= 0) return pendingDTCBuffer[index];
+  if (index < KLINE_MAX_DTCS) return pendingDTCBuffer[index];
   return "";
 }
+#endif
 
 bool OBD2_KLine::clearDTCs() {
-  writeData(clear_DTCs, 0x00);
-  int len = readData();
-  if (len >= 3) {
-    if (resultBuffer[3] == 0x44) {
-      memset(storedDTCBuffer, 0, sizeof(storedDTCBuffer));
-      memset(pendingDTCBuffer, 0, sizeof(pendingDTCBuffer));
+  if (!writeData(clear_DTCs, 0x00)) return false;
+  if (readData()) {
+    if (frames().find(0x44) >= 0) {
+#if KLINE_DTC_STORAGE
+      for (uint8_t i = 0; i < KLINE_MAX_DTCS; i++) {
+        storedDTCBuffer[i] = "";
+        pendingDTCBuffer[i] = "";
+      }
+#endif
       return true;
     }
   }
@@ -539,6 +454,7 @@ bool OBD2_KLine::clearDTCs() {
 
 // ----------------------------------- Vehicle Information -----------------------------------
 
+#if KLINE_VEHICLE_INFO
 String OBD2_KLine::getVehicleInfo(uint8_t pid) {
   // Request: C2 33 F1 09 02 F1
   // example Response: 87 F1 11 49 02 01 00 00 00 31 06
@@ -547,40 +463,17 @@ String OBD2_KLine::getVehicleInfo(uint8_t pid) {
   //                   87 F1 11 49 02 04 52 37 32 35 C8
   //                   87 F1 11 49 02 05 32 33 36 37 E6
 
+  if (pid != read_VIN && pid != read_ID && pid != read_ID_Num) return "";
+
   uint8_t dataArray[64];
-  int messageCount;
   int arrayNum = 0;
 
-  if (pid == 0x02) {
-    messageCount = 5;
-  } else if (pid == 0x04 || pid == 0x06) {
-    if (pid == 0x04) {
-      writeData(read_VehicleInfo, read_ID_Length);
-    } else if (pid == 0x06) {
-      writeData(read_VehicleInfo, read_ID_Num_Length);
-    } else {
-      return "";
-    }
-
-    if (readData()) {
-      messageCount = resultBuffer[5];
-    } else {
-      return "";
-    }
-  }
-
-  writeData(read_VehicleInfo, pid);
+  // Data of every frame: 49 <pid> <message number> <4 bytes>. The message
+  // count isn't needed, the frames of the answer are all in one read.
+  if (!writeData(read_VehicleInfo, pid)) return "";
 
   if (readData()) {
-    for (int j = 0; j < messageCount; j++) {
-      if (pid == 0x02 && j == 0) {
-        dataArray[arrayNum++] = resultBuffer[9];
-        continue;
-      }
-      for (int i = 1; i <= 4; i++) {
-        dataArray[arrayNum++] = resultBuffer[i + 5 + j * 11];
-      }
-    }
+    arrayNum = frames().reassemble(0x40 + read_VehicleInfo, pid, 2, true, dataArray, sizeof(dataArray));
   }
 
   if (pid == 0x02 || pid == 0x04) {
@@ -590,9 +483,11 @@ String OBD2_KLine::getVehicleInfo(uint8_t pid) {
   }
   return "";
 }
+#endif
 
 // ----------------------------------- Supported PIDs -----------------------------------
 
+#if KLINE_SUPPORTED_PIDS
 uint8_t OBD2_KLine::readSupportedLiveData() {
   return readSupportedData(read_LiveData);
 }
@@ -618,74 +513,73 @@ uint8_t OBD2_KLine::readSupportedVehicleInfo() {
 }
 
 uint8_t OBD2_KLine::readSupportedData(uint8_t mode) {
-  int supportedCount = 0;
-  int pidIndex = 0;
-  int startByte = 0;
-  int arraySize = 32;  // Size of supported data arrays
-  uint8_t *targetArray = nullptr;
-
-  if (mode == read_LiveData) {  // Mode 01
-    startByte = 5;
-    targetArray = supportedLiveData;
-  } else if (mode == read_FreezeFrame) {  // Mode 02
-    startByte = 6;
-    targetArray = supportedFreezeFrame;
-  } else if (mode == test_OxygenSensors) {  // Mode 05
-    startByte = 6;
-    targetArray = supportedOxygenSensor;
-  } else if (mode == test_OtherComponents) {  // Mode 06
-    startByte = 6;
-    targetArray = supportedOtherComponents;
-  } else if (mode == control_OnBoardComponents) {  // Mode 08
-    startByte = 5;
-    targetArray = supportedControlComponents;
-  } else if (mode == read_VehicleInfo) {  // Mode 09
-    startByte = 6;
-    targetArray = supportedVehicleInfo;
+  int valueStart = 0;  // First bitmap byte in the frame data, after <0x40 + mode> <pid>
+
+  if (mode == read_LiveData || mode == control_OnBoardComponents) {  // Mode 01, 08
+    valueStart = 2;
+  } else if (mode == read_FreezeFrame || mode == test_OxygenSensors ||  // Mode 02, 05
+             mode == test_OtherComponents || mode == read_VehicleInfo) {  // Mode 06, 09
+    valueStart = 3;
   } else {
     return -1;  // Invalid mode
   }
 
   uint8_t pidCmds[] = {SUPPORTED_PIDS_1_20, SUPPORTED_PIDS_21_40, SUPPORTED_PIDS_41_60, SUPPORTED_PIDS_61_80, SUPPORTED_PIDS_81_100};
 
+  supportedPids.clear(mode);
+
+  bool complete = false;  // Every range the ECU flagged was read
   for (int n = 0; n < 5; n++) {
-    // Group 0 is always processed, others must be checked
-    if (n != 0 && !isInArray(targetArray, 32, pidCmds[n])) break;
-
-    writeData(mode, pidCmds[n]);
-    if (readData() && resultBuffer[3] == 0x40 + mode) {
-      for (int i = 0; i < 4; i++) {
-        uint8_t value = resultBuffer[i + startByte];
-        for (int bit = 7; bit >= 0; bit--) {
-          if ((value >> bit) & 1) targetArray[supportedCount++] = pidIndex + 1;
-          pidIndex++;
-        }
-      }
+    // Group 0 is always processed, others must be flagged by the previous group
+    if (n != 0 && !supportedPids.isSupported(mode, pidCmds[n])) {
+      complete = true;
+      break;
     }
+
+    if (!writeData(mode, pidCmds[n])) break;
+    if (!readData()) break;
+
+    int8_t index = frames().find(0x40 + mode, pidCmds[n]);
+    if (index < 0 || frames().frame(index).dataLength < valueStart + 4) break;
+
+    supportedPids.setRange(mode, pidCmds[n], frames().data(index) + valueStart);
+    if (n == 4) complete = !supportedPids.isSupported(mode, 0xA0);  // Ranges past 0xA0 aren't read
   }
 
-  return supportedCount;
+  // A range missing (timeout, bad answer) leaves the mode unknown, so
+  // mayRequest() still lets its PIDs through instead of refusing them for good
+  if (complete) supportedPids.setKnown(mode);
+
+  return supportedPids.count(mode);
 }
 
 uint8_t OBD2_KLine::getSupportedData(uint8_t mode, uint8_t index) {
-  if (mode == 0x01) {
-    if (index >= 0) return supportedLiveData[index];
-  } else if (mode == 0x02) {
-    if (index >= 0) return supportedFreezeFrame[index];
-  } else if (mode == 0x05) {
-    if (index >= 0) return supportedOxygenSensor[index];
-  } else if (mode == 0x06) {
-    if (index >= 0) return supportedOtherComponents[index];
-  } else if (mode == 0x08) {
-    if (index >= 0) return supportedControlComponents[index];
-  } else if (mode == 0x09) {
-    if (index >= 0) return supportedVehicleInfo[index];
-  }
-  return 0;
+  return supportedPids.pidAt(mode, index);
+}
+
+bool OBD2_KLine::isSupported(uint8_t mode, uint8_t pid) {
+  return supportedPids.isSupported(mode, pid);
+}
+
+uint8_t OBD2_KLine::getSupportedCount(uint8_t mode) {
+  return supportedPids.count(mode);
 }
 
+uint16_t OBD2_KLine::saveSupportedData(uint8_t *out, uint16_t capacity) {
+  return supportedPids.save(out, capacity);
+}
+
+bool OBD2_KLine::loadSupportedData(const uint8_t *in, uint16_t length) {
+  return supportedPids.load(in, length);
+}
+#endif
+
 // ----------------------------------- Helper Functions -----------------------------------
 
+bool OBD2_KLine::isConnected() {
+  return connectionStatus;
+}
+
 void OBD2_KLine::updateConnectionStatus(bool messageReceived) {
   if (messageReceived) {
     unreceivedDataCount = 0;
@@ -698,7 +592,9 @@ void OBD2_KLine::updateConnectionStatus(bool messageReceived) {
 
     unreceivedDataCount++;
     debugPrint(F("⚠️ Not received data: "));
+#if KLINE_DEBUG
     debugPrintln(String(unreceivedDataCount).c_str());
+#endif
     if (unreceivedDataCount > 2 && connectionStatus) {
       connectionStatus = false;
       unreceivedDataCount = 0;
@@ -719,11 +615,22 @@ void OBD2_KLine::setReadTimeout(uint16_t timeoutMs) {
   _readTimeout = timeoutMs;
 }
 
-void OBD2_KLine::setProtocol(const String &protocolName) {
-  selectedProtocol = protocolName;
+void OBD2_KLine::setProtocol(KLineProtocol protocol) {
+  _selectedProtocol = protocol;
+  _protocol = protocol;      // Fixed protocols frame and checksum their own way from the start
   connectionStatus = false;  // Reset connection status
-  connectedProtocol = "";    // Reset connected protocol
-  debugPrintln(("Protocol set to: " + selectedProtocol).c_str());
+  debugPrint(F("Protocol set to: "));
+  debugPrintln(protocolName(selectedProtocol()));
+}
+
+void OBD2_KLine::setProtocol(const String &protocolName) {
+  KLineProtocol parsed;
+  if (parseProtocol(protocolName.c_str(), parsed)) setProtocol(parsed);
+}
+
+bool OBD2_KLine::mayTry(KLineInit init) const {
+  KLineProtocol selected = selectedProtocol();
+  return selected == PROTOCOL_AUTOMATIC || protocolInit(selected) == init;
 }
 
 void OBD2_KLine::send5baud(uint8_t data) {
@@ -757,42 +664,20 @@ void OBD2_KLine::send5baud(uint8_t data) {
   debugPrintln(F(""));
 }
 
+// The rule of the protocol in use, so a Honda ECU found by Automatic gets Honda checksums
 uint8_t OBD2_KLine::calculateChecksum(const uint8_t *dataArray, uint8_t length) {
-  uint8_t checksum = 0;
-  for (int i = 0; i < length; i++) {
-    checksum += dataArray[i];
-  }
-
-  if (selectedProtocol == "ISO14230_Honda") {
-    return  0x100 - (checksum % 256);
-  }
-
-  return checksum % 256;
+  return klineChecksum(protocolFraming(protocol()), dataArray, length);
 }
 
+#if KLINE_DTC_STORAGE
 String OBD2_KLine::decodeDTC(uint8_t input_byte1, uint8_t input_byte2) {
-  String ErrorCode = "";
-  const char type_lookup[4] = {'P', 'C', 'B', 'U'};
-  const char digit_lookup[16] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
-
-  ErrorCode += type_lookup[(input_byte1 >> 6) & 0x03];
-  ErrorCode += digit_lookup[(input_byte1 >> 4) & 0x03];
-  ErrorCode += digit_lookup[input_byte1 & 0x0F];
-  ErrorCode += digit_lookup[(input_byte2 >> 4) & 0x0F];
-  ErrorCode += digit_lookup[input_byte2 & 0x0F];
-
-  return ErrorCode;
-}
-
-bool OBD2_KLine::isInArray(const uint8_t *dataArray, uint8_t length, uint8_t value) {
-  for (int i = 0; i < length; i++) {
-    if (dataArray[i] == value) {
-      return true;
-    }
-  }
-  return false;
+  char errorCode[6];
+  formatDTC(input_byte1, input_byte2, errorCode);
+  return String(errorCode);
 }
+#endif
 
+#if KLINE_VEHICLE_INFO
 String OBD2_KLine::convertHexToAscii(const uint8_t *dataArray, uint8_t length) {
   String asciiString = "";
   for (int i = 0; i < length; i++) {
@@ -813,9 +698,11 @@ String OBD2_KLine::convertBytesToHexString(const uint8_t *dataArray, uint8_t len
   hexString.toUpperCase();
   return hexString;
 }
+#endif
 
 // ----------------------------------- Debug Functions -----------------------------------
 
+#if KLINE_DEBUG
 void OBD2_KLine::setDebug(Stream &serial) {
   _debugSerial = &serial;
 }
@@ -848,4 +735,5 @@ void OBD2_KLine::debugPrintHexln(uint8_t val) {
     debugPrintHex(val);
     _debugSerial->println();
   }
-}
\ No newline at end of file
+}
+#endif
@@ -2,6 +2,15 @@
 #define OBD2_KLINE_H
 
 #include <Arduino.h>
+#include "KLineConfig.h"
+#include "FramePool.h"
+#include "KLineFrame.h"
+#include "KLineProtocol.h"
+#include "LiveChannels.h"
+#include "OBD2_Decode.h"
+#if KLINE_SUPPORTED_PIDS
+#include "SupportedPids.h"
+#endif
 
 #if defined(__AVR_ATmega168__) || defined(__AVR_ATmega328P__)
 #include <AltSoftSerial.h>
@@ -10,6 +19,20 @@
 #define SerialType HardwareSerial
 #endif
 
+#if defined(ESP32)
+#include <esp_timer.h>
+#endif
+
+// Microseconds since boot: esp_timer on the ESP32, micros() elsewhere (wraps
+// after ~71 minutes where unsigned long is 32 bits)
+inline uint64_t klineTimeUs() {
+#if defined(ESP32)
+  return esp_timer_get_time();
+#else
+  return micros();
+#endif
+}
+
 // ==== OBD2 Mods ====
 const uint8_t read_LiveData = 0x01;              // Show current live data
 const uint8_t read_FreezeFrame = 0x02;           // Show freeze frame data
@@ -21,6 +44,7 @@ const uint8_t read_pendingDTCs = 0x07;           // Show pending Diagnostic Trou
 const uint8_t control_OnBoardComponents = 0x08;  // Control operation of on-board component/system
 const uint8_t read_VehicleInfo = 0x09;           // Request vehicle information
 const uint8_t read_PermanentDTCs = 0x0A;         // Show permanent Diagnostic Trouble Codes
+const uint8_t read_LocalIdentifier = 0x21;       // KWP2000 readDataByLocalIdentifier (not an OBD mode)
 
 const uint8_t SUPPORTED_PIDS_1_20 = 0x00;
 const uint8_t SUPPORTED_PIDS_21_40 = 0x20;
@@ -35,21 +59,6 @@ const uint8_t read_ID = 0x04;             // Read Calibration ID
 const uint8_t read_ID_Num_Length = 0x05;  // Read Calibration ID Number Length
 const uint8_t read_ID_Num = 0x06;         // Read Calibration ID Number
 
-// Honda data
-struct HondaLiveData {
-  float engineSpeed_rpm;
-  float tps_percent;
-  int   ect_celsius;
-  int   iat_celsius;
-  int   map_mbar;
-  float battery_volt;
-  int   vehicleSpeed_kmh;
-  float injector_ms;
-  float ignition_deg;
-  int   iacv_pulse;
-  int   iacv_cmd;
-};
-
 // ISO14230-Fast init message
 const uint8_t initMsg[4] = {0xC1, 0x33, 0xF1, 0x81};
 
@@ -60,36 +69,60 @@ const uint8_t ecmHondaMsg[4] = {0x72, 0x05, 0x71, 0x00}; // , 0x18
 const uint8_t table11HondaMsg[4] = {0x72, 0x05, 0x71, 0x11}; // , 0x07
 const uint8_t table17HondaMsg[4] = {0x72, 0x05, 0x71, 0x17}; // , 0x07
 
+// Which of the members below exist is set in KLineConfig.h
 class OBD2_KLine {
  public:
   OBD2_KLine(SerialType &serialStream, uint32_t baudRate, uint8_t rxPin, uint8_t txPin);
 
+#if KLINE_DEBUG
   void setDebug(Stream &serial);
+#else
+  void setDebug(Stream &) {}
+#endif
   void setSerial(bool enabled);
+  bool isConnected();
   bool initOBD2();
   bool trySlowInit();
   bool tryFastInit();
   bool tryHondaInit();
-  void writeData(uint8_t mode, uint8_t pid);
+  bool writeData(uint8_t mode, uint8_t pid);  // false, nothing sent, if the protocol has no such request
   void writeRawData(const uint8_t *dataArray, uint8_t length);
   uint8_t readData();
   void send5baud(uint8_t data);
 
+  // Decoded value, -1 if no answer, -2 if the answer is for another PID,
+  // -3 if the ECU (supported-PID bitmap) or the protocol (Honda) has no such PID
   float getPID(uint8_t mode, uint8_t pid);
   float getLiveData(uint8_t pid);
   float getFreezeFrame(uint8_t pid);
   bool getHondaLiveData(uint8_t pid, HondaLiveData& data);
-
+  // KWP2000 block read (fast / slow init only), decoded with the layout set
+  // for localId by setLocalIdLayout(). Returns the values in layout order, -1
+  // if no answer, -2 if refused (7F 21 ..), -3 if not KWP2000 or no layout.
+  int readLocalIdentifier(uint8_t localId, float *values, uint8_t capacity);
+  bool readLocalIdentifier(uint8_t localId, LiveSample &sample);  // The channels the layout feeds
+  uint64_t responseTimeUs() const { return _responseTimeUs; }  // First RX byte of the answer last decoded
+  // The bytes and frames of the last readData(), shared without copying; the
+  // next readData() fills another pool buffer, so a held view stays valid
+  FrameView lastResponse() const { return _response; }
+  uint32_t responseBuffersExhausted() const { return _framePool.exhausted(); }
+
+  int readDTCCodes(uint8_t mode, uint16_t *codes, uint8_t capacity);  // -1 if no 0x43 / 0x47 answer (none, 7F ..)
+#if KLINE_DTC_STORAGE
   uint8_t readDTCs(uint8_t mode);
   uint8_t readStoredDTCs();
   uint8_t readPendingDTCs();
   String getStoredDTC(uint8_t index);
   String getPendingDTC(uint8_t index);
+#endif
 
   bool clearDTCs();
 
+#if KLINE_VEHICLE_INFO
   String getVehicleInfo(uint8_t pid);
+#endif
 
+#if KLINE_SUPPORTED_PIDS
   uint8_t readSupportedLiveData();
   uint8_t readSupportedFreezeFrame();
   uint8_t readSupportedOxygenSensors();
@@ -98,11 +131,25 @@ class OBD2_KLine {
   uint8_t readSupportedVehicleInfo();
   uint8_t readSupportedData(uint8_t mode);
   uint8_t getSupportedData(uint8_t mode, uint8_t index);
+  bool isSupported(uint8_t mode, uint8_t pid);
+  uint8_t getSupportedCount(uint8_t mode);
+  uint16_t saveSupportedData(uint8_t *out, uint16_t capacity);
+  bool loadSupportedData(const uint8_t *in, uint16_t length);
+#endif
 
   void setByteWriteInterval(uint16_t interval);
   void setInterByteTimeout(uint16_t interval);
   void setReadTimeout(uint16_t timeoutMs);
-  void setProtocol(const String &protocolName);
+  void setProtocol(KLineProtocol protocol);
+  void setProtocol(const String &protocolName);  // protocolName() spelling; unknown names keep the current one
+  // The protocol being initialised or connected; the selected one (PROTOCOL_AUTOMATIC) before an init succeeds
+  KLineProtocol protocol() const {
+#ifdef KLINE_FIXED_PROTOCOL
+    return KLINE_FIXED_PROTOCOL;
+#else
+    return _protocol;
+#endif
+  }
   void updateConnectionStatus(bool messageReceived);
   void parseHondaTable17(const uint8_t* payload, HondaLiveData& data);
 
@@ -111,39 +158,65 @@ class OBD2_KLine {
   uint32_t _baudRate;
   uint8_t _rxPin;
   uint8_t _txPin;
+#if KLINE_DEBUG
   Stream *_debugSerial = nullptr;  // Debug serial port
+#endif
 
-  uint8_t resultBuffer[160] = {0};
+  FramePool _framePool;
+  FrameView _response;  // Last readData(), empty after a timeout
   uint8_t unreceivedDataCount = 0;
+  uint64_t _responseTimeUs = 0;
   bool connectionStatus = false;
 
-  String selectedProtocol = "Automatic";
-  String connectedProtocol = "";
+  KLineProtocol _selectedProtocol = PROTOCOL_AUTOMATIC;
+  KLineProtocol _protocol = PROTOCOL_AUTOMATIC;
   uint16_t _byteWriteInterval = 5;
   uint16_t _interByteTimeout = 60;
   uint16_t _readTimeout = 1000;
-  String storedDTCBuffer[32];
-  String pendingDTCBuffer[32];
+#if KLINE_DTC_STORAGE
+  String storedDTCBuffer[KLINE_MAX_DTCS];
+  String pendingDTCBuffer[KLINE_MAX_DTCS];
+#endif
 
-  uint8_t supportedLiveData[32];
-  uint8_t supportedFreezeFrame[32];
-  uint8_t supportedOxygenSensor[32];
-  uint8_t supportedOtherComponents[32];
-  uint8_t supportedControlComponents[32];
-  uint8_t supportedVehicleInfo[32];
+#if KLINE_SUPPORTED_PIDS
+  SupportedPids supportedPids;
+#endif
 
-  String decodeDTC(uint8_t input_byte1, uint8_t input_byte2);
+  KLineProtocol selectedProtocol() const {
+#ifdef KLINE_FIXED_PROTOCOL
+    return KLINE_FIXED_PROTOCOL;
+#else
+    return _selectedProtocol;
+#endif
+  }
+  bool mayTry(KLineInit init) const;
+  int requestLocalIdentifier(uint8_t localId, const uint8_t *&record);
+  const KLineFrameSplitter &frames() const { return _response.frames(); }
   uint8_t calculateChecksum(const uint8_t *dataArray, uint8_t length);
-  bool isInArray(const uint8_t *dataArray, uint8_t length, uint8_t value);
+#if KLINE_DTC_STORAGE
+  String decodeDTC(uint8_t input_byte1, uint8_t input_byte2);
+#endif
+#if KLINE_VEHICLE_INFO
   String convertBytesToHexString(const uint8_t *dataArray, uint8_t length);
   String convertHexToAscii(const uint8_t *dataArray, uint8_t length);
+#endif
   void clearEcho();
+#if KLINE_DEBUG
   void debugPrint(const char *msg);
   void debugPrint(const __FlashStringHelper *msg);
   void debugPrintln(const char *msg);
   void debugPrintln(const __FlashStringHelper *msg);
   void debugPrintHex(uint8_t val);    // Hexadecimal output
   void debugPrintHexln(uint8_t val);  // Hexadecimal + newline
+#else
+  // Empty inline calls, so the messages aren't even kept in flash
+  void debugPrint(const char *) {}
+  void debugPrint(const __FlashStringHelper *) {}
+  void debugPrintln(const char *) {}
+  void debugPrintln(const __FlashStringHelper *) {}
+  void debugPrintHex(uint8_t) {}
+  void debugPrintHexln(uint8_t) {}
+#endif
 };
 
 #endif  // OBD2_KLINE_H
\ No newline at end of file
@@ -0,0 +1,245 @@
+#include "SampleCodec.h"
+
+#include <string.h>
+
+// 32-bit counts whatever the width of int (16 on AVR)
+static uint8_t leadingZeros(uint32_t x) {
+  return __builtin_clzl((unsigned long)x) - (sizeof(unsigned long) * 8 - 32);
+}
+
+static uint8_t trailingZeros(uint32_t x) {
+  return __builtin_ctzl((unsigned long)x);
+}
+
+static bool fits(int64_t value, uint8_t bits) {
+  return value >= -(1LL << (bits - 1)) && value < (1LL << (bits - 1));
+}
+
+static void resetState(SampleCodecState &state) {
+  memset(&state, 0, sizeof(state));
+  memset(state.leading, 0xFF, sizeof(state.leading));
+}
+
+// ----------------------------------- BitWriter -----------------------------------
+
+void BitWriter::begin(uint8_t *out, uint16_t capacity) {
+  _out = out;
+  _capacity = capacity;
+  _bits = 0;
+  _overflow = false;
+}
+
+void BitWriter::write(uint64_t bits, uint8_t count) {
+  if (_overflow) return;
+  if (_bits + count > _capacity * 8UL) {
+    _overflow = true;
+    return;
+  }
+  while (count > 0) {
+    uint8_t used = _bits & 7;
+    uint8_t room = 8 - used;
+    uint8_t take = count < room ? count : room;
+    uint8_t chunk = (bits >> (count - take)) & ((1u << take) - 1);
+    uint8_t &byte = _out[_bits >> 3];
+    if (used == 0) byte = 0;
+    byte |= chunk << (room - take);
+    _bits += take;
+    count -= take;
+  }
+}
+
+void BitWriter::rewind(uint32_t bitCount) {
+  _bits = bitCount;
+  _overflow = false;
+  if (_bits & 7) _out[_bits >> 3] &= 0xFF << (8 - (_bits & 7));
+}
+
+// ----------------------------------- BitReader -----------------------------------
+
+void BitReader::begin(const uint8_t *data, size_t length) {
+  _data = data;
+  _length = length;
+  _pos = 0;
+  _cache = 0;
+  _cached = 0;
+  _overrun = false;
+}
+
+uint64_t BitReader::read(uint8_t count) {
+  uint64_t value = 0;
+  while (count > 0) {
+    if (_cached == 0) {
+      if (_pos >= _length) {
+        _overrun = true;
+        return 0;
+      }
+      while (_cached <= 56 && _pos < _length) {
+        _cache |= (uint64_t)_data[_pos++] << (56 - _cached);
+        _cached += 8;
+      }
+    }
+    uint8_t take = count < _cached ? count : _cached;
+    value = (take == 64 ? 0 : value << take) | (_cache >> (64 - take));
+    _cache = take == 64 ? 0 : _cache << take;
+    _cached -= take;
+    count -= take;
+  }
+  return value;
+}
+
+// ----------------------------------- SampleEncoder -----------------------------------
+
+void SampleEncoder::begin(uint8_t *out, uint16_t capacity) {
+  _out = out;
+  _out[0] = 0;
+  _bits.begin(out + 1, capacity - 1);
+  resetState(_state);
+}
+
+bool SampleEncoder::add(const LiveSample &sample) {
+  if (_state.count == 255) return false;
+  SampleCodecState saved = _state;
+  uint32_t mark = _bits.bitCount();
+
+  if (_state.count == 0) {
+    _bits.write(sample.timeUs, 64);
+  } else {
+    int64_t delta = (int64_t)(sample.timeUs - _state.timeUs);
+    int64_t dod = delta - _state.deltaUs;
+    if (dod == 0) {
+      _bits.write(0, 1);
+    } else if (fits(dod, 8)) {
+      _bits.write(0x2, 2);
+      _bits.write(dod, 8);
+    } else if (fits(dod, 14)) {
+      _bits.write(0x6, 3);
+      _bits.write(dod, 14);
+    } else if (fits(dod, 20)) {
+      _bits.write(0xE, 4);
+      _bits.write(dod, 20);
+    } else {
+      _bits.write(0xF, 4);
+      _bits.write(dod, 64);
+    }
+    _state.deltaUs = delta;
+  }
+  _state.timeUs = sample.timeUs;
+
+  uint16_t mask = sample.validMask & ((1 << CHANNEL_COUNT) - 1);
+  if (mask == _state.mask) {
+    _bits.write(0, 1);
+  } else {
+    _bits.write(1, 1);
+    _bits.write(mask, CHANNEL_COUNT);
+    _state.mask = mask;
+  }
+  for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+    if (!(mask & (1 << ch))) continue;
+    uint32_t bits;
+    memcpy(&bits, &sample.value[ch], 4);
+    writeValue(ch, bits);
+  }
+
+  if (_bits.overflow()) {
+    _state = saved;
+    _bits.rewind(mark);
+    return false;
+  }
+  _state.count++;
+  return true;
+}
+
+void SampleEncoder::writeValue(uint8_t ch, uint32_t bits) {
+  uint32_t x = bits ^ _state.bits[ch];
+  _state.bits[ch] = bits;
+  if (x == 0) {
+    _bits.write(0, 1);
+    return;
+  }
+
+  uint8_t leading = leadingZeros(x);
+  uint8_t trailing = trailingZeros(x);
+  if (_state.leading[ch] != 0xFF && leading >= _state.leading[ch] && trailing >= _state.trailing[ch]) {
+    _bits.write(0x2, 2);
+    _bits.write(x >> _state.trailing[ch], 32 - _state.leading[ch] - _state.trailing[ch]);
+    return;
+  }
+  uint8_t length = 32 - leading - trailing;
+  _bits.write(0x3, 2);
+  _bits.write(leading, 5);
+  _bits.write(length - 1, 5);
+  _bits.write(x >> trailing, length);
+  _state.leading[ch] = leading;
+  _state.trailing[ch] = trailing;
+}
+
+uint16_t SampleEncoder::finish() {
+  if (_state.count == 0) return 0;
+  _out[0] = _state.count;
+  return 1 + _bits.byteCount();
+}
+
+// ----------------------------------- SampleDecoder -----------------------------------
+
+static int64_t readSigned(BitReader &bits, uint8_t count) {
+  int64_t value = bits.read(count);
+  if (count < 64 && (value & (1LL << (count - 1)))) value -= 1LL << count;
+  return value;
+}
+
+bool SampleDecoder::begin(const uint8_t *block, size_t length) {
+  resetState(_state);
+  _total = length ? block[0] : 0;
+  _bits.begin(block + 1, length ? length - 1 : 0);
+  return _total > 0;
+}
+
+bool SampleDecoder::next(LiveSample &sample) {
+  if (_state.count >= _total) return false;
+
+  if (_state.count == 0) {
+    _state.timeUs = _bits.read(64);
+  } else {
+    int64_t dod;
+    if (!_bits.read(1)) dod = 0;
+    else if (!_bits.read(1)) dod = readSigned(_bits, 8);
+    else if (!_bits.read(1)) dod = readSigned(_bits, 14);
+    else if (!_bits.read(1)) dod = readSigned(_bits, 20);
+    else dod = readSigned(_bits, 64);
+    _state.deltaUs += dod;
+    _state.timeUs += _state.deltaUs;
+  }
+  if (_bits.read(1)) _state.mask = _bits.read(CHANNEL_COUNT);
+
+  sample.timeUs = _state.timeUs;
+  sample.validMask = _state.mask;
+  for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+    if (!(_state.mask & (1 << ch))) {
+      sample.value[ch] = 0;
+      continue;
+    }
+    uint32_t bits = readValue(ch);
+    memcpy(&sample.value[ch], &bits, 4);
+  }
+  if (_bits.overrun()) return false;
+  _state.count++;
+  return true;
+}
+
+uint32_t SampleDecoder::readValue(uint8_t ch) {
+  if (_bits.read(1)) {
+    if (!_bits.read(1)) {
+      uint8_t length = 32 - _state.leading[ch] - _state.trailing[ch];
+      if (_state.leading[ch] != 0xFF) _state.bits[ch] ^= (uint32_t)_bits.read(length) << _state.trailing[ch];
+    } else {
+      uint8_t leading = _bits.read(5);
+      uint8_t length = _bits.read(5) + 1;
+      if (leading + length <= 32) {
+        _state.trailing[ch] = 32 - leading - length;
+        _state.leading[ch] = leading;
+        _state.bits[ch] ^= (uint32_t)_bits.read(length) << _state.trailing[ch];
+      }
+    }
+  }
+  return _state.bits[ch];
+}
@@ -0,0 +1,100 @@
+#ifndef SAMPLE_CODEC_H
+#define SAMPLE_CODEC_H
+
+#include "LiveChannels.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef SAMPLE_BLOCK_MAX_SIZE
+#define SAMPLE_BLOCK_MAX_SIZE 240  // Encoded block; fits a .klog record payload and a datagram
+#endif
+
+// Blocks of LiveSamples compressed the Gorilla way: consecutive samples
+// barely change, so only the change is written, in as few bits as it takes.
+//
+//   block:   <sample count u8> <bit stream, MSB first, zero padded to a byte>
+//   sample:  time   first sample: 64 bits; then the delta-of-delta in µs
+//                   0 = same interval, 10 +8 bits, 110 +14, 1110 +20, 1111 +64
+//            mask   0 = same channels as before, 1 + CHANNEL_COUNT bits
+//            value  per valid channel, float bits XOR the channel's last value:
+//                   0 = unchanged, 10 + the bits inside the last window,
+//                   11 + 5 bits leading zeros + 5 bits length - 1 + the bits
+//
+// A block decodes on its own: lose one and the next starts from scratch.
+
+class BitWriter {
+ public:
+  void begin(uint8_t *out, uint16_t capacity);
+  void write(uint64_t bits, uint8_t count);  // Low count bits of bits; sets overflow() past capacity
+  bool overflow() const { return _overflow; }
+  uint32_t bitCount() const { return _bits; }
+  uint16_t byteCount() const { return (_bits + 7) / 8; }
+  void rewind(uint32_t bitCount);  // Back to an earlier bitCount(), dropping what came after
+
+ private:
+  uint8_t *_out = nullptr;
+  uint16_t _capacity = 0;
+  uint32_t _bits = 0;
+  bool _overflow = false;
+};
+
+class BitReader {
+ public:
+  void begin(const uint8_t *data, size_t length);
+  uint64_t read(uint8_t count);  // 0 bits past the end, and sets overrun()
+  bool overrun() const { return _overrun; }
+
+ private:
+  const uint8_t *_data = nullptr;
+  size_t _length = 0;
+  size_t _pos = 0;       // Next byte into the cache
+  uint64_t _cache = 0;   // Bits not read yet, at the top
+  uint8_t _cached = 0;
+  bool _overrun = false;
+};
+
+// What both ends remember between samples, per block
+struct SampleCodecState {
+  uint64_t timeUs;
+  int64_t deltaUs;
+  uint16_t mask;
+  uint8_t count;
+  uint32_t bits[CHANNEL_COUNT];     // Last value of each channel
+  uint8_t leading[CHANNEL_COUNT];   // Window of the last XOR written, leading = 0xFF before the first
+  uint8_t trailing[CHANNEL_COUNT];
+};
+
+// Fills a caller's buffer, nothing allocated: a sample that doesn't fit any
+// more is taken back out and add() returns false, the block is finished and
+// the sample goes into the next one.
+class SampleEncoder {
+ public:
+  void begin(uint8_t *out, uint16_t capacity = SAMPLE_BLOCK_MAX_SIZE);
+  bool add(const LiveSample &sample);
+  uint16_t finish();  // Block size in bytes, 0 if empty
+  uint8_t count() const { return _state.count; }
+
+ private:
+  uint8_t *_out = nullptr;
+  BitWriter _bits;
+  SampleCodecState _state = {};
+
+  void writeValue(uint8_t ch, uint32_t bits);
+};
+
+class SampleDecoder {
+ public:
+  bool begin(const uint8_t *block, size_t length);  // false if empty
+  bool next(LiveSample &sample);  // false at the end, or if the block is cut short
+  uint8_t count() const { return _total; }
+
+ private:
+  BitReader _bits;
+  SampleCodecState _state = {};
+  uint8_t _total = 0;
+
+  uint32_t readValue(uint8_t ch);
+};
+
+#endif  // SAMPLE_CODEC_H
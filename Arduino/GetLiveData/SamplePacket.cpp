@@ -0,0 +1,137 @@
+#include "SamplePacket.h"
+
+#include <string.h>
+
+// A jump back further than this is the sender starting over, not a late datagram
+static const uint32_t RESTART_GAP = 1024;
+
+static void putLE(uint8_t *out, uint64_t value, uint8_t bytes) {
+  for (uint8_t i = 0; i < bytes; i++) out[i] = (value >> (8 * i)) & 0xFF;
+}
+
+static uint64_t getLE(const uint8_t *data, uint8_t bytes) {
+  uint64_t value = 0;
+  for (uint8_t i = 0; i < bytes; i++) value |= (uint64_t)data[i] << (8 * i);
+  return value;
+}
+
+uint16_t encodeSamplePacket(uint32_t sequence, const LiveSample &sample, uint8_t *out, uint16_t capacity) {
+  uint16_t total = SAMPLE_PACKET_HEADER_SIZE;
+  for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+    if (sample.validMask & (1 << ch)) total += 4;
+  }
+  if (capacity < total) return 0;
+
+  out[0] = 'K';
+  out[1] = 'S';
+  out[2] = SAMPLE_PACKET_VERSION;
+  out[3] = 0;
+  putLE(out + 4, sequence, 4);
+  putLE(out + 8, sample.timeUs, 8);
+  putLE(out + 16, sample.validMask, 2);
+
+  uint8_t *p = out + SAMPLE_PACKET_HEADER_SIZE;
+  for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+    if (!(sample.validMask & (1 << ch))) continue;
+    uint32_t bits;
+    memcpy(&bits, &sample.value[ch], 4);
+    putLE(p, bits, 4);
+    p += 4;
+  }
+  return total;
+}
+
+bool decodeSamplePacket(const uint8_t *data, size_t length, uint32_t &sequence, LiveSample &sample) {
+  if (length < SAMPLE_PACKET_HEADER_SIZE || data[0] != 'K' || data[1] != 'S' || data[2] != SAMPLE_PACKET_VERSION) {
+    return false;
+  }
+
+  uint16_t mask = getLE(data + 16, 2);
+  if (mask >> CHANNEL_COUNT) return false;  // Channels this build doesn't know
+  size_t total = SAMPLE_PACKET_HEADER_SIZE;
+  for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+    if (mask & (1 << ch)) total += 4;
+  }
+  if (length < total) return false;
+
+  sequence = getLE(data + 4, 4);
+  sample.timeUs = getLE(data + 8, 8);
+  sample.validMask = mask;
+  const uint8_t *p = data + SAMPLE_PACKET_HEADER_SIZE;
+  for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+    if (!(mask & (1 << ch))) continue;
+    uint32_t bits = getLE(p, 4);
+    memcpy(&sample.value[ch], &bits, 4);
+    p += 4;
+  }
+  return true;
+}
+
+uint16_t encodeSampleBlockPacket(uint32_t firstSequence, const uint8_t *block, uint16_t length, uint8_t *out,
+                                 uint16_t capacity) {
+  uint16_t total = SAMPLE_BLOCK_PACKET_HEADER_SIZE + length;
+  if (capacity < total) return 0;
+
+  out[0] = 'K';
+  out[1] = 'Z';
+  out[2] = SAMPLE_PACKET_VERSION;
+  out[3] = 0;
+  putLE(out + 4, firstSequence, 4);
+  memcpy(out + SAMPLE_BLOCK_PACKET_HEADER_SIZE, block, length);
+  return total;
+}
+
+bool decodeSampleBlockPacket(const uint8_t *data, size_t length, uint32_t &firstSequence, SampleDecoder &decoder) {
+  if (length <= SAMPLE_BLOCK_PACKET_HEADER_SIZE || data[0] != 'K' || data[1] != 'Z' ||
+      data[2] != SAMPLE_PACKET_VERSION) {
+    return false;
+  }
+  firstSequence = getLE(data + 4, 4);
+  return decoder.begin(data + SAMPLE_BLOCK_PACKET_HEADER_SIZE, length - SAMPLE_BLOCK_PACKET_HEADER_SIZE);
+}
+
+// ----------------------------------- LossCounter -----------------------------------
+
+void LossCounter::reset() {
+  *this = LossCounter();
+}
+
+void LossCounter::add(uint32_t sequence) {
+  uint32_t behind = _next - 1 - sequence;  // 0 = the newest one seen so far
+  if (_started && sequence < _next && behind >= RESTART_GAP) {
+    _restarts++;
+    _started = false;
+  }
+
+  if (!_started) {
+    _started = true;
+    _next = sequence + 1;
+    _window = 1;
+    _received++;
+    return;
+  }
+
+  if (sequence >= _next) {
+    uint32_t skipped = sequence - _next;
+    _lost += skipped;
+    _window = skipped + 1 >= 32 ? 0 : _window << (skipped + 1);
+    _window |= 1;
+    _next = sequence + 1;
+    _received++;
+    return;
+  }
+
+  if (behind < 32 && (_window & (1UL << behind))) {
+    _duplicates++;
+    return;
+  }
+  if (behind < 32) _window |= 1UL << behind;
+  _received++;
+  _late++;
+  if (_lost > 0) _lost--;
+}
+
+float LossCounter::lossRatio() const {
+  uint32_t expected = _received + _lost;
+  return expected ? (float)_lost / expected : 0.0f;
+}
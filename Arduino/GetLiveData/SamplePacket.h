@@ -0,0 +1,66 @@
+#ifndef SAMPLE_PACKET_H
+#define SAMPLE_PACKET_H
+
+#include "LiveChannels.h"
+#include "SampleCodec.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// One LiveSample per UDP datagram, little-endian:
+//
+//   'K' 'S' <version> 0 <sequence u32> <time_us u64> <valid mask u16> <value f32 per valid channel>
+//
+// The sequence number goes up by one per sample, so a listener can tell
+// how many datagrams were lost on the way.
+
+const uint8_t SAMPLE_PACKET_VERSION = 1;
+const uint8_t SAMPLE_PACKET_HEADER_SIZE = 18;
+const uint8_t SAMPLE_PACKET_MAX_SIZE = SAMPLE_PACKET_HEADER_SIZE + 4 * CHANNEL_COUNT;
+
+// Returns the datagram size, or 0 if out is too small
+uint16_t encodeSamplePacket(uint32_t sequence, const LiveSample &sample, uint8_t *out, uint16_t capacity);
+
+// False if data isn't a complete sample datagram
+bool decodeSamplePacket(const uint8_t *data, size_t length, uint32_t &sequence, LiveSample &sample);
+
+// Several samples compressed into one datagram (SampleCodec.h):
+//
+//   'K' 'Z' <version> 0 <sequence of the first sample u32> <SampleCodec block>
+//
+// The samples after the first have the sequence numbers after it.
+const uint8_t SAMPLE_BLOCK_PACKET_HEADER_SIZE = 8;
+const uint16_t SAMPLE_BLOCK_PACKET_MAX_SIZE = SAMPLE_BLOCK_PACKET_HEADER_SIZE + SAMPLE_BLOCK_MAX_SIZE;
+
+uint16_t encodeSampleBlockPacket(uint32_t firstSequence, const uint8_t *block, uint16_t length, uint8_t *out,
+                                 uint16_t capacity);
+
+// Sets decoder to the samples of a block datagram, false if data isn't one
+bool decodeSampleBlockPacket(const uint8_t *data, size_t length, uint32_t &firstSequence, SampleDecoder &decoder);
+
+// Listener side: counts datagrams that never came from the sequence numbers.
+// One that turns up after a newer one is taken back out of lost and counted late.
+class LossCounter {
+ public:
+  void reset();
+  void add(uint32_t sequence);
+
+  uint32_t received() const { return _received; }
+  uint32_t lost() const { return _lost; }
+  uint32_t late() const { return _late; }
+  uint32_t duplicates() const { return _duplicates; }
+  uint32_t restarts() const { return _restarts; }  // Sender started over (sequence jumped far back)
+  float lossRatio() const;
+
+ private:
+  bool _started = false;
+  uint32_t _next = 0;    // Sequence expected next
+  uint32_t _window = 0;  // Bit i set = _next - 1 - i arrived
+  uint32_t _received = 0;
+  uint32_t _lost = 0;
+  uint32_t _late = 0;
+  uint32_t _duplicates = 0;
+  uint32_t _restarts = 0;
+};
+
+#endif  // SAMPLE_PACKET_H
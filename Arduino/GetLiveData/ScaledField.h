@@ -0,0 +1,23 @@
+#ifndef SCALED_FIELD_H
+#define SCALED_FIELD_H
+
+#include <stdint.h>
+
+// A field scaled to engineering units: ((raw * mul) / div) + add, where raw is
+// one byte or two big-endian bytes. Each step rounds to float like the scalar
+// decoders do, so keep mul / div / add as they are written there.
+struct ScaledField {
+  uint8_t offset;  // First byte of the field in the record
+  uint8_t size;    // 1 or 2
+  float mul;
+  float div;
+  float add;
+};
+
+inline float decodeField(const ScaledField &field, const uint8_t *record) {
+  const uint8_t *p = record + field.offset;
+  float x = field.size == 2 ? (float)((p[0] << 8) | p[1]) : (float)p[0];
+  return x * field.mul / field.div + field.add;
+}
+
+#endif  // SCALED_FIELD_H
@@ -0,0 +1,108 @@
+#include "SupportedPids.h"
+
+int8_t SupportedPids::slot(uint8_t mode) {
+  switch (mode) {
+    case 0x01: return 0;
+    case 0x02: return 1;
+    case 0x05: return 2;
+    case 0x06: return 3;
+    case 0x08: return 4;
+    case 0x09: return 5;
+    default: return -1;
+  }
+}
+
+void SupportedPids::clear() {
+  memset(_bits, 0, sizeof(_bits));
+  _knownMask = 0;
+}
+
+void SupportedPids::clear(uint8_t mode) {
+  int8_t s = slot(mode);
+  if (s < 0) return;
+  memset(_bits[s], 0, sizeof(_bits[s]));
+  _knownMask &= ~(1 << s);
+}
+
+bool SupportedPids::isKnown(uint8_t mode) const {
+  int8_t s = slot(mode);
+  return s >= 0 && (_knownMask >> s) & 1;
+}
+
+void SupportedPids::setKnown(uint8_t mode) {
+  int8_t s = slot(mode);
+  if (s >= 0) _knownMask |= 1 << s;
+}
+
+void SupportedPids::setRange(uint8_t mode, uint8_t base, const uint8_t *bitmap) {
+  int8_t s = slot(mode);
+  if (s < 0) return;
+
+  for (uint8_t i = 0; i < 32; i++) {
+    uint16_t pid = base + i + 1;
+    if (pid > 0xFF) break;
+    uint32_t mask = (uint32_t)1 << (pid & 0x1F);
+    if ((bitmap[i >> 3] >> (7 - (i & 7))) & 1) {
+      _bits[s][pid >> 5] |= mask;
+    } else {
+      _bits[s][pid >> 5] &= ~mask;
+    }
+  }
+}
+
+uint8_t SupportedPids::count(uint8_t mode) const {
+  int8_t s = slot(mode);
+  if (s < 0) return 0;
+
+  uint16_t total = 0;
+  for (uint8_t w = 0; w < WORDS_PER_MODE; w++) total += __builtin_popcountl(_bits[s][w]);
+  return total > 0xFF ? 0xFF : total;
+}
+
+uint8_t SupportedPids::pidAt(uint8_t mode, uint8_t index) const {
+  int8_t s = slot(mode);
+  if (s < 0) return 0;
+
+  for (uint8_t w = 0; w < WORDS_PER_MODE; w++) {
+    uint8_t inWord = __builtin_popcountl(_bits[s][w]);
+    if (index >= inWord) {
+      index -= inWord;
+      continue;
+    }
+    for (uint8_t bit = 0; bit < 32; bit++) {
+      if (((_bits[s][w] >> bit) & 1) && index-- == 0) return w * 32 + bit;
+    }
+  }
+  return 0;
+}
+
+uint16_t SupportedPids::save(uint8_t *out, uint16_t capacity) const {
+  if (capacity < STORAGE_SIZE) return 0;
+
+  // Little-endian words so a blob saved on one target loads on another
+  uint16_t n = 0;
+  out[n++] = STORAGE_VERSION;
+  out[n++] = _knownMask;
+  for (uint8_t s = 0; s < MODE_COUNT; s++) {
+    for (uint8_t w = 0; w < WORDS_PER_MODE; w++) {
+      for (uint8_t b = 0; b < 4; b++) out[n++] = (_bits[s][w] >> (8 * b)) & 0xFF;
+    }
+  }
+  return n;
+}
+
+bool SupportedPids::load(const uint8_t *in, uint16_t length) {
+  if (length != STORAGE_SIZE || in[0] != STORAGE_VERSION) return false;
+  if (in[1] >> MODE_COUNT) return false;  // Known bits of modes that don't exist: not our blob
+
+  uint16_t n = 1;
+  _knownMask = in[n++];
+  for (uint8_t s = 0; s < MODE_COUNT; s++) {
+    for (uint8_t w = 0; w < WORDS_PER_MODE; w++) {
+      uint32_t word = 0;
+      for (uint8_t b = 0; b < 4; b++) word |= (uint32_t)in[n++] << (8 * b);
+      _bits[s][w] = word;
+    }
+  }
+  return true;
+}
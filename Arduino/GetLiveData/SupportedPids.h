@@ -0,0 +1,51 @@
+#ifndef SUPPORTED_PIDS_H
+#define SUPPORTED_PIDS_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Supported PIDs of modes 01, 02, 05, 06, 08 and 09 as one 256-bit set per mode
+class SupportedPids {
+ public:
+  static const uint8_t MODE_COUNT = 6;
+  static const uint8_t WORDS_PER_MODE = 8;  // 256 PIDs / 32 bits
+  static const uint16_t STORAGE_SIZE = 2 + MODE_COUNT * WORDS_PER_MODE * 4;
+
+  void clear();
+  void clear(uint8_t mode);
+
+  // A mode is known once its bitmap was read from the ECU (or loaded)
+  bool isKnown(uint8_t mode) const;
+  void setKnown(uint8_t mode);
+
+  bool isSupported(uint8_t mode, uint8_t pid) const {
+    int8_t s = slot(mode);
+    return s >= 0 && (_bits[s][pid >> 5] >> (pid & 0x1F)) & 1;
+  }
+
+  // True unless the bitmap of the mode is known and says no; PID 00 is always asked
+  bool mayRequest(uint8_t mode, uint8_t pid) const {
+    return pid == 0x00 || !isKnown(mode) || isSupported(mode, pid);
+  }
+
+  // Stores the 4 bitmap bytes an ECU answers to PID `base` (0x00, 0x20, ...):
+  // bit 7 of the first byte is PID base + 1
+  void setRange(uint8_t mode, uint8_t base, const uint8_t *bitmap);
+
+  uint8_t count(uint8_t mode) const;
+  uint8_t pidAt(uint8_t mode, uint8_t index) const;  // index-th supported PID, 0 if none
+
+  // Persistence, e.g. to ESP32 Preferences, so the bitmaps aren't asked on every connect
+  uint16_t save(uint8_t *out, uint16_t capacity) const;
+  bool load(const uint8_t *in, uint16_t length);
+
+ private:
+  static const uint8_t STORAGE_VERSION = 1;
+
+  uint32_t _bits[MODE_COUNT][WORDS_PER_MODE] = {{0}};
+  uint8_t _knownMask = 0;
+
+  static int8_t slot(uint8_t mode);
+};
+
+#endif  // SUPPORTED_PIDS_H
@@ -0,0 +1,112 @@
+#include "UdpStream.h"
+
+void UdpStream::begin(uint16_t port) {
+  _started = _udp.begin(port);
+}
+
+void UdpStream::setBroadcast(const IPAddress &address, uint16_t port) {
+  _broadcastIp = address;
+  _broadcastPort = port;
+}
+
+void UdpStream::handle() {
+  if (!_started) return;
+
+  int size;
+  while ((size = _udp.parsePacket()) > 0) {
+    char message[8] = {0};
+    _udp.read((uint8_t *)message, sizeof(message) - 1);
+    if (strncmp(message, "SUB", 3) == 0) addClient(_udp.remoteIP(), _udp.remotePort());
+    else if (strncmp(message, "UNSUB", 5) == 0) removeClient(_udp.remoteIP(), _udp.remotePort());
+  }
+
+  unsigned long now = millis();
+  for (Client &client : _clients) {
+    if (client.port && now - client.lastSeenMs > UDP_SUBSCRIPTION_MS) client.port = 0;
+  }
+  if (_blockDelayMs && _encoder.count() && now - _blockStartMs >= _blockDelayMs) flushBlock();
+}
+
+void UdpStream::setCompression(uint16_t maxDelayMs) {
+  if (_blockDelayMs && _encoder.count()) flushBlock();
+  _blockDelayMs = maxDelayMs;
+  _encoder.begin(_block);
+}
+
+bool UdpStream::addClient(const IPAddress &ip, uint16_t port) {
+  Client *free = nullptr;
+  for (Client &client : _clients) {
+    if (client.port == port && client.ip == ip) {
+      client.lastSeenMs = millis();  // Renewal
+      return true;
+    }
+    if (!client.port && !free) free = &client;
+  }
+  if (!free) return false;
+
+  free->ip = ip;
+  free->port = port;
+  free->lastSeenMs = millis();
+  return true;
+}
+
+void UdpStream::removeClient(const IPAddress &ip, uint16_t port) {
+  for (Client &client : _clients) {
+    if (client.port == port && client.ip == ip) client.port = 0;
+  }
+}
+
+uint8_t UdpStream::clientCount() const {
+  uint8_t count = 0;
+  for (const Client &client : _clients) {
+    if (client.port) count++;
+  }
+  return count;
+}
+
+void UdpStream::send(const LiveSample &sample) {
+  uint32_t sequence = _sequence++;  // Counts even when nobody listens, so a late subscriber sees no loss
+  if (!_started || (!_broadcastPort && clientCount() == 0)) return;
+
+  if (_blockDelayMs) {
+    if (_encoder.count() && sequence != _blockSequence + _encoder.count()) flushBlock();  // Samples skipped
+    if (_encoder.count() == 0) startBlock(sequence);
+    if (!_encoder.add(sample)) {
+      flushBlock();
+      startBlock(sequence);
+      _encoder.add(sample);
+    }
+    if (millis() - _blockStartMs >= _blockDelayMs) flushBlock();
+    return;
+  }
+
+  uint8_t packet[SAMPLE_PACKET_MAX_SIZE];
+  sendPacket(packet, encodeSamplePacket(sequence, sample, packet, sizeof(packet)));
+}
+
+void UdpStream::startBlock(uint32_t sequence) {
+  _encoder.begin(_block);
+  _blockSequence = sequence;
+  _blockStartMs = millis();
+}
+
+void UdpStream::flushBlock() {
+  uint8_t packet[SAMPLE_BLOCK_PACKET_MAX_SIZE];
+  uint16_t length = encodeSampleBlockPacket(_blockSequence, _block, _encoder.finish(), packet, sizeof(packet));
+  _encoder.begin(_block);
+  sendPacket(packet, length);
+}
+
+void UdpStream::sendPacket(const uint8_t *packet, uint16_t length) {
+  for (const Client &client : _clients) {
+    if (!client.port) continue;
+    _udp.beginPacket(client.ip, client.port);
+    _udp.write(packet, length);
+    _udp.endPacket();
+  }
+  if (_broadcastPort) {
+    _udp.beginPacket(_broadcastIp, _broadcastPort);
+    _udp.write(packet, length);
+    _udp.endPacket();
+  }
+}
@@ -0,0 +1,63 @@
+#ifndef UDP_STREAM_H
+#define UDP_STREAM_H
+
+#include <WiFi.h>
+#include <WiFiUdp.h>
+
+#include "SamplePacket.h"
+
+#define MAX_UDP_CLIENTS 4
+
+const uint16_t UDP_STREAM_PORT = 3334;
+const uint32_t UDP_SUBSCRIPTION_MS = 10000;  // A client that doesn't renew within this is dropped
+
+// Live samples as UDP datagrams for dashboards, next to the TCP log on
+// Wifi_K. A late datagram is never resent: the next sample replaces it.
+//
+// A client subscribes by sending "SUB" to the stream port from the port it
+// listens on and repeats it every few seconds; "UNSUB" leaves. Samples can
+// also go to a broadcast address with no subscription at all.
+class UdpStream {
+ public:
+  void begin(uint16_t port = UDP_STREAM_PORT);
+  void setBroadcast(const IPAddress &address, uint16_t port);  // port 0 turns broadcasting off
+  void handle();  // Reads subscriptions, call from loop()
+
+  bool addClient(const IPAddress &ip, uint16_t port);  // false if every slot is taken
+  void removeClient(const IPAddress &ip, uint16_t port);
+  uint8_t clientCount() const;
+
+  void send(const LiveSample &sample);
+  uint32_t sequence() const { return _sequence; }
+
+  // Samples go out compressed ('KZ' block datagrams, SamplePacket.h), a block
+  // when it is full or maxDelayMs after its first sample: far less airtime
+  // for that much latency. 0 goes back to a datagram per sample.
+  void setCompression(uint16_t maxDelayMs);
+
+ private:
+  struct Client {
+    IPAddress ip;
+    uint16_t port = 0;  // 0 = free slot
+    unsigned long lastSeenMs = 0;
+  };
+
+  WiFiUDP _udp;
+  Client _clients[MAX_UDP_CLIENTS];
+  IPAddress _broadcastIp;
+  uint16_t _broadcastPort = 0;
+  uint32_t _sequence = 0;
+  bool _started = false;
+
+  uint16_t _blockDelayMs = 0;
+  SampleEncoder _encoder;
+  uint8_t _block[SAMPLE_BLOCK_MAX_SIZE];
+  uint32_t _blockSequence = 0;     // Of the block's first sample
+  unsigned long _blockStartMs = 0;
+
+  void startBlock(uint32_t sequence);
+  void flushBlock();
+  void sendPacket(const uint8_t *packet, uint16_t length);
+};
+
+#endif  // UDP_STREAM_H
@@ -31,9 +31,51 @@ QueueHandle_t Wifi_K::getQueueHandle() {
 
 void Wifi_K::handle() {
   handleClients();
+  readCommands();
   broadcastFromQueue();
 }
 
+void Wifi_K::onCommand(CommandHandler handler, void *context) {
+  _commandHandler = handler;
+  _commandContext = context;
+}
+
+void Wifi_K::readCommands() {
+  for (int i = 0; i < MAX_WIFI_CLIENTS; i++) {
+    while (clients[i] && clients[i].available() > 0) {
+      int c = clients[i].read();
+      if (c < 0) break;
+      if (c == '\r') continue;
+      if (c != '\n') {
+        if (_commandLength[i] < COMMAND_BUFFER_SIZE - 1) _command[i][_commandLength[i]++] = c;  // Too long lines are cut
+        continue;
+      }
+
+      _command[i][_commandLength[i]] = '\0';
+      _commandLength[i] = 0;
+      if (_commandHandler && _command[i][0]) _commandHandler(_command[i], clients[i], _clientId[i], _commandContext);
+    }
+  }
+}
+
+int Wifi_K::slotOf(uint16_t client) {
+  for (int i = 0; i < MAX_WIFI_CLIENTS; i++) {
+    if (client != 0 && _clientId[i] == client && clients[i] && clients[i].connected()) return i;
+  }
+  return -1;
+}
+
+bool Wifi_K::isConnected(uint16_t client) {
+  return slotOf(client) >= 0;
+}
+
+bool Wifi_K::sendTo(uint16_t client, const char *message) {
+  int i = slotOf(client);
+  if (i < 0) return false;
+  clients[i].print(message);
+  return true;
+}
+
 void Wifi_K::broadcastFromQueue() {
   if (_log_queue) {
     char local_buffer[LOG_BUFFER_SIZE];
@@ -52,6 +94,9 @@ void Wifi_K::handleClients() {
         if (!clients[i] || !clients[i].connected()) {
           clients[i].stop();
           clients[i] = newClient;
+          _commandLength[i] = 0;
+          _clientId[i] = _nextClientId++;
+          if (_nextClientId == 0) _nextClientId = 1;
           placed = true;
           break;
         }
@@ -65,6 +110,7 @@ void Wifi_K::handleClients() {
   for (int i = 0; i < MAX_WIFI_CLIENTS; i++) {
     if (clients[i] && !clients[i].connected()) {
       clients[i].stop();
+      _clientId[i] = 0;
     }
   }
 }
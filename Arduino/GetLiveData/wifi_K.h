@@ -8,6 +8,11 @@
 #define MAX_WIFI_CLIENTS 4
 #define LOG_QUEUE_LENGTH 10
 #define LOG_BUFFER_SIZE  256
+#define COMMAND_BUFFER_SIZE 64
+
+// Called with each line a client sends (line end stripped); an answer ready
+// now goes to reply, a later one to sendTo(client, ...)
+typedef void (*CommandHandler)(const char *line, Print &reply, uint16_t client, void *context);
 
 class Wifi_K {
 public:
@@ -18,18 +23,31 @@ public:
   void begin();
   void handle();
   QueueHandle_t getQueueHandle();
+  void broadcast(const char *message);
+  void broadcast(const String &message);
+  void onCommand(CommandHandler handler, void *context = nullptr);
+  // Clients are numbered as they connect, so a reply never reaches whoever
+  // took over the slot; false if that client is gone
+  bool sendTo(uint16_t client, const char *message);
+  bool isConnected(uint16_t client);
 
 private:
   // Private helper methods
   void handleClients();
   void broadcastFromQueue();
-  void broadcast(const char *message);
-  void broadcast(const String &message);
+  void readCommands();
+  int slotOf(uint16_t client);
 
   // Member variables
   WiFiServer server;
   WiFiClient clients[MAX_WIFI_CLIENTS];
   QueueHandle_t _log_queue = nullptr;
+  char _command[MAX_WIFI_CLIENTS][COMMAND_BUFFER_SIZE];
+  uint8_t _commandLength[MAX_WIFI_CLIENTS] = {0};
+  uint16_t _clientId[MAX_WIFI_CLIENTS] = {0};
+  uint16_t _nextClientId = 1;  // 0 is never a client
+  CommandHandler _commandHandler = nullptr;
+  void *_commandContext = nullptr;
 };
 
 #endif // WIFI_K_H
\ No newline at end of file
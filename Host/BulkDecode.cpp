@@ -0,0 +1,311 @@
+#include "BulkDecode.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BULK_DECODE_X86 1
+#include <immintrin.h>
+#endif
+
+// ----------------------------------- Scales -----------------------------------
+
+// Same cases and arithmetic as the switch in decodePID()
+struct PidScaleRange {
+  uint8_t first;
+  uint8_t last;
+  uint8_t size;
+  float mul;
+  float div;
+  float add;
+};
+
+static const PidScaleRange PID_SCALE_RANGES[] = {
+    {0x01, 0x03, 1, 1.0f, 1.0f, 0.0f},        // Bit encoded
+    {0x04, 0x04, 1, 100.0f, 255.0f, 0.0f},    // Engine Load (%)
+    {0x05, 0x05, 1, 1.0f, 1.0f, -40.0f},      // Coolant Temperature (°C)
+    {0x06, 0x09, 1, 100.0f, 128.0f, -100.0f}, // Fuel Trims (%)
+    {0x0A, 0x0A, 1, 3.0f, 1.0f, 0.0f},        // Fuel Pressure (kPa)
+    {0x0B, 0x0B, 1, 1.0f, 1.0f, 0.0f},        // MAP (kPa)
+    {0x0C, 0x0C, 2, 1.0f, 4.0f, 0.0f},        // RPM
+    {0x0D, 0x0D, 1, 1.0f, 1.0f, 0.0f},        // Speed (km/h)
+    {0x0E, 0x0E, 1, 1.0f, 2.0f, -64.0f},      // Timing Advance (°)
+    {0x0F, 0x0F, 1, 1.0f, 1.0f, -40.0f},      // Intake Air Temperature (°C)
+    {0x10, 0x10, 2, 1.0f, 100.0f, 0.0f},      // MAF Flow Rate (g/s)
+    {0x11, 0x11, 1, 100.0f, 255.0f, 0.0f},    // Throttle Position (%)
+    {0x12, 0x13, 1, 1.0f, 1.0f, 0.0f},        // Bit encoded
+    {0x14, 0x1B, 1, 1.0f, 200.0f, 0.0f},      // Oxygen Sensor Voltage (V)
+    {0x1C, 0x1E, 1, 1.0f, 1.0f, 0.0f},        // Bit encoded
+    {0x1F, 0x1F, 2, 1.0f, 1.0f, 0.0f},        // Run Time (s)
+    {0x21, 0x21, 2, 1.0f, 1.0f, 0.0f},        // Distance With MIL On (km)
+    {0x22, 0x22, 2, 0.079f, 1.0f, 0.0f},      // Fuel Rail Pressure (kPa)
+    {0x23, 0x23, 2, 1.0f, 10.0f, 0.0f},       // Fuel Rail Gauge Pressure (kPa)
+    {0x24, 0x2B, 2, 1.0f, 32768.0f, 0.0f},    // Oxygen Sensor ratio
+    {0x2C, 0x2C, 1, 100.0f, 255.0f, 0.0f},    // Commanded EGR (%)
+    {0x2D, 0x2D, 1, 100.0f, 128.0f, -100.0f}, // EGR Error (%)
+    {0x2E, 0x2F, 1, 100.0f, 255.0f, 0.0f},    // Evap Purge, Fuel Level (%)
+    {0x30, 0x30, 1, 1.0f, 1.0f, 0.0f},        // Warm-ups
+    {0x31, 0x31, 2, 1.0f, 1.0f, 0.0f},        // Distance Since Codes Cleared (km)
+    {0x32, 0x32, 2, 1.0f, 4.0f, 0.0f},        // Evap Vapor Pressure (Pa)
+    {0x33, 0x33, 1, 1.0f, 1.0f, 0.0f},        // Barometric Pressure (kPa)
+    {0x34, 0x3B, 2, 1.0f, 32768.0f, 0.0f},    // Oxygen Sensor ratio
+    {0x3C, 0x3F, 2, 1.0f, 10.0f, -40.0f},     // Catalyst Temperature (°C)
+    {0x41, 0x41, 1, 1.0f, 1.0f, 0.0f},        // Bit encoded
+    {0x42, 0x42, 2, 1.0f, 1000.0f, 0.0f},     // Control Module Voltage (V)
+    {0x43, 0x43, 2, 100.0f, 255.0f, 0.0f},    // Absolute Load (%)
+    {0x44, 0x44, 2, 1.0f, 32768.0f, 0.0f},    // Lambda
+    {0x45, 0x45, 1, 100.0f, 255.0f, 0.0f},    // Relative Throttle (%)
+    {0x46, 0x46, 1, 1.0f, 1.0f, -40.0f},      // Ambient Air Temperature (°C)
+    {0x47, 0x4C, 1, 100.0f, 255.0f, 0.0f},    // Throttle / Pedal Positions (%)
+    {0x4D, 0x4E, 2, 1.0f, 1.0f, 0.0f},        // Minutes
+    {0x4F, 0x51, 1, 1.0f, 1.0f, 0.0f},        // Max values, Fuel Type
+    {0x52, 0x52, 1, 100.0f, 255.0f, 0.0f},    // Ethanol (%)
+    {0x53, 0x53, 2, 1.0f, 200.0f, 0.0f},      // Absolute Evap Pressure (kPa)
+    {0x54, 0x54, 2, 1.0f, 1.0f, 0.0f},        // Evap Vapor Pressure (Pa)
+    {0x55, 0x58, 1, 100.0f, 128.0f, -100.0f}, // Secondary O2 Trims (%)
+    {0x59, 0x59, 2, 10.0f, 1.0f, 0.0f},       // Fuel Rail Absolute Pressure (kPa)
+    {0x5A, 0x5B, 1, 100.0f, 255.0f, 0.0f},    // Pedal, Hybrid Battery (%)
+    {0x5C, 0x5C, 1, 1.0f, 1.0f, -40.0f},      // Engine Oil Temperature (°C)
+    {0x5D, 0x5D, 2, 1.0f, 128.0f, -210.0f},   // Fuel Injection Timing (°)
+    {0x5E, 0x5E, 2, 1.0f, 20.0f, 0.0f},       // Engine Fuel Rate (L/h)
+    {0x5F, 0x5F, 1, 1.0f, 1.0f, 0.0f},        // Bit encoded
+    {0x61, 0x62, 1, 1.0f, 1.0f, -125.0f},     // Percent Torque (%)
+    {0x63, 0x63, 2, 1.0f, 1.0f, 0.0f},        // Reference Torque (Nm)
+};
+
+// Struct of arrays so the AVX2 kernel can gather the scale of each lane
+struct PidScaleTable {
+  ScaledField fields[256];
+  float mul[256];
+  float div[256];
+  float add[256];
+  int32_t twoByte[256];  // -1 for 2-byte PIDs, a blend mask
+
+  PidScaleTable() {
+    for (int pid = 0; pid < 256; pid++) set(pid, {1, 1, 0.0f, 1.0f, -4.0f});  // 0 * x - 4 = -4, unknown
+    for (const PidScaleRange &range : PID_SCALE_RANGES) {
+      for (int pid = range.first; pid <= range.last; pid++) {
+        set(pid, {1, range.size, range.mul, range.div, range.add});
+      }
+    }
+  }
+
+  void set(int pid, const ScaledField &field) {
+    fields[pid] = field;
+    mul[pid] = field.mul;
+    div[pid] = field.div;
+    add[pid] = field.add;
+    twoByte[pid] = field.size == 2 ? -1 : 0;
+  }
+};
+
+static const PidScaleTable PID_SCALES;
+
+const ScaledField &pidScale(uint8_t pid) {
+  return PID_SCALES.fields[pid];
+}
+
+// Same arithmetic as parseHondaTable17()
+const ScaledField HONDA_TABLE17_FIELDS[8] = {
+    {0, 2, 1.0f, 1.0f, 0.0f},     // engineSpeed_rpm
+    {3, 1, 5.0f, 256.0f, 0.0f},   // tps_percent
+    {5, 1, 1.0f, 1.0f, -40.0f},   // iat_celsius
+    {7, 1, 1.0f, 1.0f, -40.0f},   // ect_celsius
+    {9, 1, 10.0f, 1.0f, 0.0f},    // map_mbar
+    {10, 1, 1.0f, 10.0f, 0.0f},   // battery_volt
+    {16, 1, 1.0f, 1.0f, 0.0f},    // vehicleSpeed_kmh
+    {4, 1, 1.0f, 2.0f, -64.0f},   // ignition_deg
+};
+
+// ----------------------------------- Kernel choice -----------------------------------
+
+static bool cpuSupports(BulkKernel kernel) {
+#if BULK_DECODE_X86
+  __builtin_cpu_init();  // May run from a static constructor, before the runtime did it
+#endif
+  switch (kernel) {
+    case BULK_SCALAR:
+      return true;
+#if BULK_DECODE_X86
+    case BULK_SSE2:
+      return __builtin_cpu_supports("sse2");
+    case BULK_AVX2:
+      return __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return false;
+  }
+}
+
+static BulkKernel bestKernel() {
+  if (cpuSupports(BULK_AVX2)) return BULK_AVX2;
+  if (cpuSupports(BULK_SSE2)) return BULK_SSE2;
+  return BULK_SCALAR;
+}
+
+static BulkKernel activeKernel = bestKernel();
+
+bool setBulkKernel(BulkKernel kernel) {
+  if (!cpuSupports(kernel)) return false;
+  activeKernel = kernel;
+  return true;
+}
+
+BulkKernel bulkKernel() {
+  return activeKernel;
+}
+
+const char *bulkKernelName(BulkKernel kernel) {
+  switch (kernel) {
+    case BULK_SSE2: return "sse2";
+    case BULK_AVX2: return "avx2";
+    default: return "scalar";
+  }
+}
+
+// ----------------------------------- Scalar -----------------------------------
+
+static void fieldScalar(const ScaledField &field, const uint8_t *records, size_t stride, size_t from, size_t count,
+                        float *out) {
+  for (size_t i = from; i < count; i++) out[i] = decodeField(field, records + i * stride);
+}
+
+static void pidScalar(const uint8_t *records, size_t stride, size_t from, size_t count, float *out) {
+  for (size_t i = from; i < count; i++) {
+    const uint8_t *record = records + i * stride;
+    out[i] = decodeField(PID_SCALES.fields[record[0]], record);
+  }
+}
+
+#if BULK_DECODE_X86
+
+// Records whose first `bytes` bytes (from `offset`) lie inside count * stride,
+// so a wide load never reads past the buffer
+static size_t safeCount(size_t stride, size_t count, size_t offset, size_t bytes) {
+  if (offset + bytes <= stride) return count;
+  size_t over = offset + bytes - stride;  // Bytes the last records reach into the next slot
+  size_t unsafe = (over + stride - 1) / stride;
+  return count > unsafe ? count - unsafe : 0;
+}
+
+// ----------------------------------- SSE2 -----------------------------------
+
+// No gather before AVX2: raw values are picked up one by one, the arithmetic
+// runs 4 lanes wide
+static inline uint32_t rawValue(const uint8_t *p, uint8_t size) {
+  return size == 2 ? (p[0] << 8) | p[1] : p[0];
+}
+
+__attribute__((target("sse2")))
+static void fieldSse2(const ScaledField &field, const uint8_t *records, size_t stride, size_t count, float *out) {
+  const __m128 mul = _mm_set1_ps(field.mul);
+  const __m128 div = _mm_set1_ps(field.div);
+  const __m128 add = _mm_set1_ps(field.add);
+  const uint8_t *p = records + field.offset;
+  size_t i = 0;
+
+  for (; i + 4 <= count; i += 4, p += 4 * stride) {
+    __m128i raw = _mm_set_epi32(rawValue(p + 3 * stride, field.size), rawValue(p + 2 * stride, field.size),
+                                rawValue(p + stride, field.size), rawValue(p, field.size));
+    __m128 x = _mm_cvtepi32_ps(raw);
+    x = _mm_add_ps(_mm_div_ps(_mm_mul_ps(x, mul), div), add);
+    _mm_storeu_ps(out + i, x);
+  }
+  fieldScalar(field, records, stride, i, count, out);
+}
+
+// ----------------------------------- AVX2 -----------------------------------
+
+// Byte offsets of 8 consecutive records, relative to the first one
+__attribute__((target("avx2")))
+static inline __m256i laneOffsets(size_t stride, size_t offset) {
+  return _mm256_add_epi32(_mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)stride)),
+                          _mm256_set1_epi32((int)offset));
+}
+
+// 4 gathered bytes b0 b1 b2 b3 (little-endian lanes) -> b0 or b0 << 8 | b1
+__attribute__((target("avx2")))
+static inline __m256i rawFromWord(__m256i word, __m256i twoByte) {
+  const __m256i low = _mm256_set1_epi32(0xFF);
+  __m256i first = _mm256_and_si256(word, low);
+  __m256i second = _mm256_and_si256(_mm256_srli_epi32(word, 8), low);
+  __m256i pair = _mm256_or_si256(_mm256_slli_epi32(first, 8), second);
+  return _mm256_blendv_epi8(first, pair, twoByte);
+}
+
+__attribute__((target("avx2")))
+static void fieldAvx2(const ScaledField &field, const uint8_t *records, size_t stride, size_t count, float *out) {
+  const __m256 mul = _mm256_set1_ps(field.mul);
+  const __m256 div = _mm256_set1_ps(field.div);
+  const __m256 add = _mm256_set1_ps(field.add);
+  const __m256i twoByte = _mm256_set1_epi32(field.size == 2 ? -1 : 0);
+  const __m256i offsets = laneOffsets(stride, field.offset);
+  size_t safe = safeCount(stride, count, field.offset, 4);
+  size_t i = 0;
+
+  if (stride <= 0x7FFFFFF) {  // Offsets of 8 records must fit in an int32
+    for (const uint8_t *p = records; i + 8 <= safe; i += 8, p += 8 * stride) {
+      __m256i word = _mm256_i32gather_epi32((const int *)p, offsets, 1);
+      __m256 x = _mm256_cvtepi32_ps(rawFromWord(word, twoByte));
+      x = _mm256_add_ps(_mm256_div_ps(_mm256_mul_ps(x, mul), div), add);
+      _mm256_storeu_ps(out + i, x);
+    }
+  }
+  fieldScalar(field, records, stride, i, count, out);
+}
+
+__attribute__((target("avx2")))
+static void pidAvx2(const uint8_t *records, size_t stride, size_t count, float *out) {
+  const __m256i low = _mm256_set1_epi32(0xFF);
+  const __m256i offsets = laneOffsets(stride, 0);
+  size_t safe = safeCount(stride, count, 0, 4);
+  size_t i = 0;
+
+  if (stride <= 0x7FFFFFF) {
+    for (const uint8_t *p = records; i + 8 <= safe; i += 8, p += 8 * stride) {
+      // One gather brings <pid> <A> <B> <C> of each record
+      __m256i word = _mm256_i32gather_epi32((const int *)p, offsets, 1);
+      __m256i pid = _mm256_and_si256(word, low);
+
+      __m256i twoByte = _mm256_i32gather_epi32(PID_SCALES.twoByte, pid, 4);
+      __m256 mul = _mm256_i32gather_ps(PID_SCALES.mul, pid, 4);
+      __m256 div = _mm256_i32gather_ps(PID_SCALES.div, pid, 4);
+      __m256 add = _mm256_i32gather_ps(PID_SCALES.add, pid, 4);
+
+      __m256 x = _mm256_cvtepi32_ps(rawFromWord(_mm256_srli_epi32(word, 8), twoByte));
+      x = _mm256_add_ps(_mm256_div_ps(_mm256_mul_ps(x, mul), div), add);
+      _mm256_storeu_ps(out + i, x);
+    }
+  }
+  pidScalar(records, stride, i, count, out);
+}
+
+#endif  // BULK_DECODE_X86
+
+// ----------------------------------- Entry points -----------------------------------
+
+void decodeFieldBulk(const ScaledField &field, const uint8_t *records, size_t stride, size_t count, float *out) {
+  switch (activeKernel) {
+#if BULK_DECODE_X86
+    case BULK_AVX2: fieldAvx2(field, records, stride, count, out); return;
+    case BULK_SSE2: fieldSse2(field, records, stride, count, out); return;
+#endif
+    default: fieldScalar(field, records, stride, 0, count, out); return;
+  }
+}
+
+void decodePIDBulk(const uint8_t *records, size_t stride, size_t count, float *out) {
+  switch (activeKernel) {
+#if BULK_DECODE_X86
+    case BULK_AVX2: pidAvx2(records, stride, count, out); return;
+#endif
+    // Mixed PIDs need a gather for their scales; picking them up lane by lane
+    // for SSE2 is slower than the scalar loop
+    default: pidScalar(records, stride, 0, count, out); return;
+  }
+}
+
+void decodeHondaTable17Bulk(const uint8_t *payloads, size_t stride, size_t count, const HondaTable17Columns &out) {
+  float *columns[8] = {out.engineSpeed_rpm, out.tps_percent, out.iat_celsius, out.ect_celsius,
+                       out.map_mbar, out.battery_volt, out.vehicleSpeed_kmh, out.ignition_deg};
+  for (int f = 0; f < 8; f++) {
+    if (columns[f]) decodeFieldBulk(HONDA_TABLE17_FIELDS[f], payloads, stride, count, columns[f]);
+  }
+}
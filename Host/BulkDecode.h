@@ -0,0 +1,51 @@
+#ifndef BULK_DECODE_H
+#define BULK_DECODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ScaledField.h"
+
+// Decoding of many same-layout records at once into column buffers, for host
+// tools crunching logs. x86 builds use SSE2 / AVX2 kernels, everything else
+// the scalar loop. Results are bit-identical to decodePID() and
+// parseHondaTable17(). Host only: the sketch needs just ScaledField.h.
+
+// Scale decodePID() applies to a mode 01 / 02 PID, offset 0 being byte A.
+// Unknown PIDs decode to -4 like decodePID().
+const ScaledField &pidScale(uint8_t pid);
+
+enum BulkKernel : uint8_t { BULK_SCALAR, BULK_SSE2, BULK_AVX2 };
+
+// The best kernel this CPU runs is picked by default; forcing one the CPU
+// lacks returns false
+bool setBulkKernel(BulkKernel kernel);
+BulkKernel bulkKernel();
+const char *bulkKernelName(BulkKernel kernel);
+
+// Records start `stride` bytes apart and the buffer holds count * stride bytes.
+// out receives count values.
+void decodeFieldBulk(const ScaledField &field, const uint8_t *records, size_t stride, size_t count, float *out);
+
+// Mode 01 answers of mixed PIDs: each record is <pid> <A> <B> ..., the data
+// of a 41 frame after the service id
+void decodePIDBulk(const uint8_t *records, size_t stride, size_t count, float *out);
+
+// Column per HondaLiveData field of a table 0x17 payload (the bytes after
+// 71 17). Columns left null are skipped; integer fields come out as floats.
+struct HondaTable17Columns {
+  float *engineSpeed_rpm = nullptr;
+  float *tps_percent = nullptr;
+  float *iat_celsius = nullptr;
+  float *ect_celsius = nullptr;
+  float *map_mbar = nullptr;
+  float *battery_volt = nullptr;
+  float *vehicleSpeed_kmh = nullptr;
+  float *ignition_deg = nullptr;
+};
+
+extern const ScaledField HONDA_TABLE17_FIELDS[8];  // In HondaTable17Columns order
+
+void decodeHondaTable17Bulk(const uint8_t *payloads, size_t stride, size_t count, const HondaTable17Columns &out);
+
+#endif  // BULK_DECODE_H
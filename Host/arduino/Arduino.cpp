@@ -0,0 +1,198 @@
+#include "Arduino.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+
+// ----------------------------------- Time -----------------------------------
+
+static uint64_t monotonicMicros() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+static const uint64_t startMicros = monotonicMicros();
+
+unsigned long millis() {
+  return (unsigned long)((monotonicMicros() - startMicros) / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)(monotonicMicros() - startMicros);
+}
+
+void delay(unsigned long ms) {
+  delayMicroseconds(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  timespec wait = {(time_t)(us / 1000000), (long)(us % 1000000) * 1000};
+  while (nanosleep(&wait, &wait) != 0 && errno == EINTR) {
+  }
+}
+
+// ----------------------------------- Pins -----------------------------------
+
+static uint8_t pinLevels[256];
+static void (*pinIsrs[256])();
+static int pinIsrModes[256];
+
+static void setLevel(uint8_t pin, uint8_t level) {
+  if (pinLevels[pin] == level) return;
+  pinLevels[pin] = level;
+  int mode = pinIsrModes[pin];
+  if (pinIsrs[pin] && (mode == CHANGE || mode == (level ? RISING : FALLING))) pinIsrs[pin]();
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (mode == INPUT_PULLUP) setLevel(pin, HIGH);
+  if (mode == INPUT_PULLDOWN) setLevel(pin, LOW);
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  setLevel(pin, value ? HIGH : LOW);
+}
+
+void attachInterrupt(int interrupt, void (*isr)(), int mode) {
+  if (interrupt < 0 || interrupt > 255) return;
+  pinIsrModes[interrupt] = mode;
+  pinIsrs[interrupt] = isr;
+}
+
+void detachInterrupt(int interrupt) {
+  if (interrupt >= 0 && interrupt <= 255) pinIsrs[interrupt] = nullptr;
+}
+
+int digitalRead(uint8_t pin) {
+  return pinLevels[pin];
+}
+
+int analogRead(uint8_t pin) {
+  (void)pin;
+  return 0;
+}
+
+// ----------------------------------- String -----------------------------------
+
+void String::fromLong(long value, unsigned char base) {
+  if (base == DEC) {
+    char text[24];
+    snprintf(text, sizeof(text), "%ld", value);
+    _s = text;
+  } else {
+    fromUnsigned((unsigned long)value, base);
+  }
+}
+
+void String::fromUnsigned(unsigned long value, unsigned char base) {
+  char text[72];
+  char *p = text + sizeof(text) - 1;
+  *p = '\0';
+  do {
+    uint8_t digit = value % base;
+    *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    value /= base;
+  } while (value);
+  _s = p;
+}
+
+void String::fromDouble(double value, unsigned char decimals) {
+  char text[48];
+  snprintf(text, sizeof(text), "%.*f", decimals, value);
+  _s = text;
+}
+
+void String::toUpperCase() {
+  for (char &c : _s) c = toupper((unsigned char)c);
+}
+
+void String::trim() {
+  size_t first = _s.find_first_not_of(" \t\r\n");
+  if (first == std::string::npos) {
+    _s.clear();
+    return;
+  }
+  _s = _s.substr(first, _s.find_last_not_of(" \t\r\n") - first + 1);
+}
+
+int String::indexOf(char c, unsigned int from) const {
+  size_t at = _s.find(c, from);
+  return at == std::string::npos ? -1 : (int)at;
+}
+
+String String::substring(unsigned int from) const {
+  return from < _s.size() ? String(_s.substr(from)) : String();
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+  if (to < from) std::swap(from, to);
+  if (from >= _s.size()) return String();
+  return String(_s.substr(from, to - from));
+}
+
+// ----------------------------------- Print -----------------------------------
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t written = 0;
+  while (written < size && write(buffer[written])) written++;
+  return written;
+}
+
+size_t Print::printf(const char *format, ...) {
+  char text[256];
+  va_list ap;
+  va_start(ap, format);
+  int length = vsnprintf(text, sizeof(text), format, ap);
+  va_end(ap);
+  if (length < 0) return 0;
+  return write((const uint8_t *)text, (size_t)length < sizeof(text) ? length : sizeof(text) - 1);
+}
+
+// ----------------------------------- HardwareSerial -----------------------------------
+
+void HardwareSerial::begin(unsigned long baud, uint32_t config, int8_t rxPin, int8_t txPin) {
+  (void)baud;
+  (void)config;
+  (void)rxPin;
+  if (txPin >= 0) digitalWrite(txPin, HIGH);  // The UART idles the line high
+}
+
+int HardwareSerial::available() {
+  if (_fd < 0) return 0;
+  int count = 0;
+  if (ioctl(_fd, FIONREAD, &count) < 0) return 0;
+  return count;
+}
+
+int HardwareSerial::read() {
+  if (available() <= 0) return -1;
+  uint8_t b;
+  return ::read(_fd, &b, 1) == 1 ? b : -1;
+}
+
+void HardwareSerial::flush() {
+  if (_fd < 0) fflush(stdout);
+}
+
+size_t HardwareSerial::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  if (_fd < 0) return fwrite(buffer, 1, size, stdout);
+
+  size_t written = 0;
+  while (written < size) {
+    ssize_t n = ::write(_fd, buffer + written, size - written);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    written += n;
+  }
+  return written;
+}
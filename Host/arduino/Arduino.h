@@ -0,0 +1,163 @@
+// Minimal Arduino core for building the sketches' sources on Linux.
+// Only what OBD2_KLine, Wifi_K and the simulator use is here.
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+#define INPUT_PULLDOWN 0x3
+#define CHANGE 0x4
+#define FALLING 0x2
+#define RISING 0x3
+#define NOT_AN_INTERRUPT -1
+#define DEC 10
+#define HEX 16
+#define SERIAL_8N1 0x800001c
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+#define PROGMEM
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// Pins are simulated: writes are remembered, reads return the last write.
+// Every pin has an interrupt, called from the thread that changed the level.
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+inline int digitalPinToInterrupt(uint8_t pin) { return pin; }
+void attachInterrupt(int interrupt, void (*isr)(), int mode);
+void detachInterrupt(int interrupt);
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+template <class T, class L, class H>
+inline T constrain(T value, L low, H high) {
+  return value < low ? low : (value > high ? high : value);
+}
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+using std::max;
+using std::min;
+
+class String {
+ public:
+  String(const char *text = "") : _s(text ? text : "") {}
+  String(const std::string &text) : _s(text) {}
+  explicit String(char c) : _s(1, c) {}
+  String(int value, unsigned char base = DEC) { fromLong(value, base); }
+  String(unsigned int value, unsigned char base = DEC) { fromUnsigned(value, base); }
+  String(long value, unsigned char base = DEC) { fromLong(value, base); }
+  String(unsigned long value, unsigned char base = DEC) { fromUnsigned(value, base); }
+  String(unsigned char value, unsigned char base = DEC) { fromUnsigned(value, base); }
+  String(float value, unsigned char decimals = 2) { fromDouble(value, decimals); }
+  String(double value, unsigned char decimals = 2) { fromDouble(value, decimals); }
+
+  const char *c_str() const { return _s.c_str(); }
+  unsigned int length() const { return _s.size(); }
+  char operator[](unsigned int index) const { return index < _s.size() ? _s[index] : 0; }
+
+  String &operator+=(const String &other) { _s += other._s; return *this; }
+  String &operator+=(const char *other) { _s += other; return *this; }
+  String &operator+=(char c) { _s += c; return *this; }
+  bool operator==(const String &other) const { return _s == other._s; }
+  bool operator==(const char *other) const { return _s == other; }
+  bool operator!=(const String &other) const { return _s != other._s; }
+  bool operator!=(const char *other) const { return _s != other; }
+
+  void toUpperCase();
+  void trim();
+  int toInt() const { return atoi(_s.c_str()); }
+  float toFloat() const { return atof(_s.c_str()); }
+  bool startsWith(const String &prefix) const { return _s.compare(0, prefix._s.size(), prefix._s) == 0; }
+  int indexOf(char c, unsigned int from = 0) const;
+  String substring(unsigned int from) const;
+  String substring(unsigned int from, unsigned int to) const;
+
+  friend String operator+(const String &a, const String &b) { return String(a._s + b._s); }
+
+ private:
+  std::string _s;
+  void fromLong(long value, unsigned char base);
+  void fromUnsigned(unsigned long value, unsigned char base);
+  void fromDouble(double value, unsigned char decimals);
+};
+
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t b) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *text) { return text ? write((const uint8_t *)text, strlen(text)) : 0; }
+
+  size_t print(const char *text) { return write(text); }
+  size_t print(const String &text) { return write(text.c_str()); }
+  size_t print(const __FlashStringHelper *text) { return write(reinterpret_cast<const char *>(text)); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned char value, int base = DEC) { return print(String(value, base)); }
+  size_t print(int value, int base = DEC) { return print(String(value, base)); }
+  size_t print(unsigned int value, int base = DEC) { return print(String(value, base)); }
+  size_t print(long value, int base = DEC) { return print(String(value, base)); }
+  size_t print(unsigned long value, int base = DEC) { return print(String(value, base)); }
+  size_t print(double value, int decimals = 2) { return print(String(value, decimals)); }
+
+  size_t println() { return write("\r\n"); }
+  template <class T>
+  size_t println(T value) { return print(value) + println(); }
+  template <class T>
+  size_t println(T value, int format) { return print(value, format) + println(); }
+
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() { return -1; }
+  virtual void flush() {}
+};
+
+// Serial port on top of a file descriptor (a pty in the benchmarks).
+// Without a descriptor, writes go to stdout and nothing is ever received.
+class HardwareSerial : public Stream {
+ public:
+  void attach(int fd) { _fd = fd; }
+  int fd() const { return _fd; }
+
+  void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1);
+  void end() {}
+  int available() override;
+  int read() override;
+  void flush() override;
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  operator bool() const { return true; }
+
+ private:
+  int _fd = -1;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+#endif  // HOST_ARDUINO_H
@@ -0,0 +1,125 @@
+#include "WiFi.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+WiFiClass WiFi;
+
+// ----------------------------------- WiFiClient -----------------------------------
+
+WiFiClient::Socket::~Socket() {
+  if (fd >= 0) close(fd);
+}
+
+WiFiClient::WiFiClient(int fd) : _socket(std::make_shared<Socket>(fd)) {}
+
+int WiFiClient::available() {
+  if (!*this) return 0;
+  int count = 0;
+  if (ioctl(_socket->fd, FIONREAD, &count) < 0) return 0;
+  return count;
+}
+
+int WiFiClient::read() {
+  if (!*this) return -1;
+  uint8_t b;
+  return recv(_socket->fd, &b, 1, MSG_DONTWAIT) == 1 ? b : -1;
+}
+
+size_t WiFiClient::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t WiFiClient::write(const uint8_t *buffer, size_t size) {
+  if (!*this) return 0;
+
+  size_t written = 0;
+  while (written < size) {
+    ssize_t n = send(_socket->fd, buffer + written, size - written, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    written += n;
+  }
+  return written;
+}
+
+bool WiFiClient::connected() {
+  if (!*this) return false;
+  uint8_t b;
+  ssize_t n = recv(_socket->fd, &b, 1, MSG_PEEK | MSG_DONTWAIT);
+  if (n > 0) return true;
+  return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+}
+
+void WiFiClient::stop() {
+  _socket.reset();
+}
+
+void WiFiClient::setNoDelay(bool enabled) {
+  if (!*this) return;
+  int flag = enabled;
+  setsockopt(_socket->fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+}
+
+IPAddress WiFiClient::remoteIP() const {
+  sockaddr_in peer = {};
+  socklen_t length = sizeof(peer);
+  if (!*this || getpeername(_socket->fd, (sockaddr *)&peer, &length) < 0) return IPAddress();
+  uint32_t address = ntohl(peer.sin_addr.s_addr);
+  return IPAddress(address >> 24, address >> 16, address >> 8, address);
+}
+
+uint16_t WiFiClient::remotePort() const {
+  sockaddr_in peer = {};
+  socklen_t length = sizeof(peer);
+  if (!*this || getpeername(_socket->fd, (sockaddr *)&peer, &length) < 0) return 0;
+  return ntohs(peer.sin_port);
+}
+
+// ----------------------------------- WiFiServer -----------------------------------
+
+WiFiServer::~WiFiServer() {
+  if (_pending >= 0) close(_pending);
+  if (_fd >= 0) close(_fd);
+}
+
+void WiFiServer::begin() {
+  _fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (_fd < 0) return;
+
+  int reuse = 1;
+  setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(_port);
+
+  if (bind(_fd, (sockaddr *)&address, sizeof(address)) < 0 || listen(_fd, 8) < 0) {
+    perror("WiFiServer");
+    close(_fd);
+    _fd = -1;
+  }
+}
+
+bool WiFiServer::hasClient() {
+  if (_pending < 0 && _fd >= 0) {
+    _pending = accept4(_fd, nullptr, nullptr, SOCK_NONBLOCK);
+  }
+  return _pending >= 0;
+}
+
+WiFiClient WiFiServer::available() {
+  if (!hasClient()) return WiFiClient();
+
+  WiFiClient client(_pending);
+  _pending = -1;
+  client.setNoDelay(_noDelay);
+  return client;
+}
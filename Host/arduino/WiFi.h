@@ -0,0 +1,89 @@
+// WiFi for the host build: the access point calls do nothing and
+// WiFiServer / WiFiClient are plain TCP sockets on this machine.
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include <Arduino.h>
+
+#include <memory>
+
+#define WIFI_AP 2
+
+class IPAddress {
+ public:
+  IPAddress() : _address(0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+      : _address((uint32_t)a << 24 | (uint32_t)b << 16 | (uint32_t)c << 8 | d) {}
+  uint8_t operator[](int index) const { return _address >> (24 - 8 * index); }
+  bool operator==(const IPAddress &other) const { return _address == other._address; }
+  uint32_t value() const { return _address; }  // Host byte order
+
+ private:
+  uint32_t _address;
+};
+
+class WiFiClient : public Stream {
+ public:
+  WiFiClient() {}
+  explicit WiFiClient(int fd);
+
+  int available() override;
+  int read() override;
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+
+  bool connected();
+  void stop();
+  void setNoDelay(bool enabled);
+  explicit operator bool() const { return _socket && _socket->fd >= 0; }
+  IPAddress remoteIP() const;
+  uint16_t remotePort() const;
+
+ private:
+  // Copies share the socket like on the ESP32, it is closed with the last one
+  struct Socket {
+    int fd;
+    explicit Socket(int descriptor) : fd(descriptor) {}
+    ~Socket();
+  };
+  std::shared_ptr<Socket> _socket;
+};
+
+class WiFiServer {
+ public:
+  explicit WiFiServer(uint16_t port) : _port(port) {}
+  ~WiFiServer();
+
+  void begin();
+  void setNoDelay(bool enabled) { _noDelay = enabled; }
+  bool hasClient();
+  WiFiClient available();
+  WiFiClient accept() { return available(); }
+  uint16_t port() const { return _port; }
+
+ private:
+  uint16_t _port;
+  int _fd = -1;
+  int _pending = -1;  // Accepted by hasClient(), handed out by available()
+  bool _noDelay = false;
+};
+
+class WiFiClass {
+ public:
+  void persistent(bool enabled) { (void)enabled; }
+  bool mode(int mode) { (void)mode; return true; }
+  bool softAPConfig(IPAddress ip, IPAddress gateway, IPAddress mask) { _ip = ip; (void)gateway; (void)mask; return true; }
+  bool softAP(const char *ssid, const char *pass = nullptr, int channel = 1, int hidden = 0, int maxClients = 4) {
+    (void)ssid; (void)pass; (void)channel; (void)hidden; (void)maxClients;
+    return true;
+  }
+  IPAddress softAPIP() const { return _ip; }
+
+ private:
+  IPAddress _ip;
+};
+
+extern WiFiClass WiFi;
+
+#endif  // HOST_WIFI_H
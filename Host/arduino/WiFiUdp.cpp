@@ -0,0 +1,86 @@
+#include "WiFiUdp.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+uint8_t WiFiUDP::begin(uint16_t port) {
+  stop();
+  _fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+  if (_fd < 0) return 0;
+
+  int enable = 1;
+  setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+  setsockopt(_fd, SOL_SOCKET, SO_BROADCAST, &enable, sizeof(enable));
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+
+  if (bind(_fd, (sockaddr *)&address, sizeof(address)) < 0) {
+    perror("WiFiUDP");
+    stop();
+    return 0;
+  }
+  return 1;
+}
+
+void WiFiUDP::stop() {
+  if (_fd >= 0) close(_fd);
+  _fd = -1;
+  _rxLen = _rxPos = 0;
+}
+
+int WiFiUDP::beginPacket(const IPAddress &ip, uint16_t port) {
+  _txIp = ip;
+  _txPort = port;
+  _txLen = 0;
+  return _fd >= 0;
+}
+
+size_t WiFiUDP::write(const uint8_t *buffer, size_t size) {
+  if (size > sizeof(_tx) - _txLen) size = sizeof(_tx) - _txLen;
+  memcpy(_tx + _txLen, buffer, size);
+  _txLen += size;
+  return size;
+}
+
+int WiFiUDP::endPacket() {
+  if (_fd < 0) return 0;
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(_txIp.value());
+  address.sin_port = htons(_txPort);
+
+  ssize_t n = sendto(_fd, _tx, _txLen, MSG_DONTWAIT, (sockaddr *)&address, sizeof(address));
+  _txLen = 0;
+  return n >= 0;
+}
+
+int WiFiUDP::parsePacket() {
+  _rxLen = _rxPos = 0;
+  if (_fd < 0) return 0;
+
+  sockaddr_in peer = {};
+  socklen_t length = sizeof(peer);
+  ssize_t n = recvfrom(_fd, _rx, sizeof(_rx), MSG_DONTWAIT, (sockaddr *)&peer, &length);
+  if (n <= 0) return 0;
+
+  uint32_t address = ntohl(peer.sin_addr.s_addr);
+  _remoteIp = IPAddress(address >> 24, address >> 16, address >> 8, address);
+  _remotePort = ntohs(peer.sin_port);
+  _rxLen = n;
+  return n;
+}
+
+int WiFiUDP::read(uint8_t *buffer, size_t length) {
+  int n = available();
+  if ((size_t)n > length) n = length;
+  memcpy(buffer, _rx + _rxPos, n);
+  _rxPos += n;
+  return n;
+}
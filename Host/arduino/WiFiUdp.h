@@ -0,0 +1,39 @@
+// WiFiUDP for the host build: a non-blocking UDP socket on this machine.
+// parsePacket() takes one whole datagram, read() hands it out like on the ESP32.
+#ifndef HOST_WIFI_UDP_H
+#define HOST_WIFI_UDP_H
+
+#include <WiFi.h>
+
+class WiFiUDP {
+ public:
+  ~WiFiUDP() { stop(); }
+
+  uint8_t begin(uint16_t port);
+  void stop();
+
+  int beginPacket(const IPAddress &ip, uint16_t port);
+  size_t write(uint8_t b) { return write(&b, 1); }
+  size_t write(const uint8_t *buffer, size_t size);
+  int endPacket();  // Sends what was written since beginPacket()
+
+  int parsePacket();  // Size of the next datagram, 0 if none
+  int read(uint8_t *buffer, size_t length);
+  int available() const { return _rxLen - _rxPos; }
+  IPAddress remoteIP() const { return _remoteIp; }
+  uint16_t remotePort() const { return _remotePort; }
+
+ private:
+  int _fd = -1;
+  uint8_t _tx[1472];  // Biggest datagram that fits one Ethernet frame
+  size_t _txLen = 0;
+  IPAddress _txIp;
+  uint16_t _txPort = 0;
+  uint8_t _rx[1472];
+  int _rxLen = 0;
+  int _rxPos = 0;
+  IPAddress _remoteIp;
+  uint16_t _remotePort = 0;
+};
+
+#endif  // HOST_WIFI_UDP_H
@@ -0,0 +1,68 @@
+#include "freertos/queue.h"
+
+#include <string.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+struct HostQueue {
+  UBaseType_t length;
+  UBaseType_t itemSize;
+  std::deque<std::vector<uint8_t>> items;
+  std::mutex lock;
+  std::condition_variable changed;
+};
+
+// Waits until ready() holds or the ticks run out, with the queue locked
+template <class Ready>
+static bool waitFor(HostQueue *queue, std::unique_lock<std::mutex> &guard, TickType_t wait, Ready ready) {
+  if (wait == portMAX_DELAY) {
+    queue->changed.wait(guard, ready);
+    return true;
+  }
+  return queue->changed.wait_for(guard, std::chrono::milliseconds(wait), ready);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  HostQueue *queue = new HostQueue;
+  queue->length = length;
+  queue->itemSize = itemSize;
+  return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+  delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait) {
+  if (!queue) return errQUEUE_FULL;
+
+  std::unique_lock<std::mutex> guard(queue->lock);
+  if (!waitFor(queue, guard, wait, [queue] { return queue->items.size() < queue->length; })) return errQUEUE_FULL;
+
+  const uint8_t *bytes = static_cast<const uint8_t *>(item);
+  queue->items.emplace_back(bytes, bytes + queue->itemSize);
+  queue->changed.notify_all();
+  return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait) {
+  if (!queue) return pdFAIL;
+
+  std::unique_lock<std::mutex> guard(queue->lock);
+  if (!waitFor(queue, guard, wait, [queue] { return !queue->items.empty(); })) return pdFAIL;
+
+  memcpy(item, queue->items.front().data(), queue->itemSize);
+  queue->items.pop_front();
+  queue->changed.notify_all();
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  if (!queue) return 0;
+  std::lock_guard<std::mutex> guard(queue->lock);
+  return queue->items.size();
+}
@@ -0,0 +1,2328 @@
+// klbench - microbenchmarks of the reader's hot paths and an end-to-end
+// K-Line loopback against the ECU simulator
+//
+// The microbenchmarks time checksums, frame splitting, PID / Honda table
+// decoding (scalar and the bulk kernels), channel statistics, DTC and log
+// formatting, the TCP broadcast of a log line and the UDP sample stream.
+// Before timing them, the bulk kernels are checked bit for bit against the
+// scalar decoders over every input byte value, and the sample codec is run
+// over a simulated WLTP drive: round trip and bytes per sample.
+// The checks then test modules against known answers: the frame splitter
+// over all three framings, a generated .klog through klconvert, and
+// command parsing and deadline order, channel statistics against the
+// readings they summarise, FrameView reference counts with readData(),
+// capture triggers and windows, supported-PID bitmaps (also read from the
+// simulator), and DTCMonitor against the simulator's DTC answers.
+// The loopback runs the real OBD2_KLine on one side of a pty and the
+// simulator's EcuResponder on the other, with the bus echo and baud rate
+// emulated, and reports samples/s and request latency percentiles.
+// The init benchmark times trySlowInit / tryFastInit / tryHondaInit against
+// the simulator's WakeDecoder, fed from the reader's TX pin interrupt.
+// The block benchmark compares values/s of KWP2000 0x21 block reads with
+// mode 01 PID-by-PID polling after a fast init.
+// With -s the loopback ECU replays a drive cycle (DriveScenario) instead of
+// fixed values, -x running it faster than real time.
+// The adaptive benchmark polls mode 01 PIDs of a drive cycle with
+// AdaptivePoller, once at fixed rates and once adaptive, in the same bus
+// share, and compares how far the readings are from the simulated values.
+// Results go to stdout (or -o) as JSON, a readable table goes to stderr.
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <pty.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AdaptivePoller.h"
+#include "BulkDecode.h"
+#include "CaptureBuffer.h"
+#include "ChannelAligner.h"
+#include "ChannelStats.h"
+#include "CommandQueue.h"
+#include "DTCMonitor.h"
+#include "DriveScenario.h"
+#include "ECU_Responder.h"
+#include "FramePool.h"
+#include "KLineFrame.h"
+#include "KLineLog.h"
+#include "LiveChannels.h"
+#include "LocalIdBlocks.h"
+#include "OBD2_Decode.h"
+#include "OBD2_KLine.h"
+#include "SampleCodec.h"
+#include "SamplePacket.h"
+#include "UdpStream.h"
+#include "WakeDecoder.h"
+#include "wifi_K.h"
+
+struct Options {
+  unsigned minTimeMs = 200;
+  const char *filter = nullptr;
+  unsigned requests = 50;
+  unsigned byteWriteInterval = 5;
+  unsigned interByteTimeout = 60;
+  unsigned responseDelay = 20;
+  unsigned baud = 10400;
+  const char *initPaths = "honda,fast,slow";  // Empty skips the init benchmark
+  unsigned initRuns = 3;
+  unsigned blockReads = 10;  // Per method, 0 skips the block benchmark
+  const char *outPath = nullptr;
+  const char *scenario = nullptr;  // Trace name or keyframe script for the loopback ECU
+  double speedup = 1;              // Scenario seconds per real second
+  unsigned adaptiveSeconds = 0;    // Per schedule, 0 skips the adaptive benchmark
+};
+
+struct BenchResult {
+  std::string name;
+  uint64_t ops;
+  double nsPerOp;     // Best of the runs
+  double nsPerOpMed;  // Median of the runs
+};
+
+struct VerifyResult {
+  std::vector<std::string> kernels;
+  uint64_t values = 0;
+  uint64_t mismatches = 0;
+};
+
+struct CodecResult {
+  uint64_t samples = 0;
+  uint64_t textBytes = 0;    // formatSample() lines
+  uint64_t packetBytes = 0;  // A datagram per sample
+  uint64_t blockBytes = 0;   // SampleCodec blocks
+  uint64_t blocks = 0;
+  uint64_t mismatches = 0;
+};
+
+// Expectations of one module, each failure with what went wrong
+struct CheckResult {
+  std::string name;
+  unsigned checks = 0;
+  std::vector<std::string> failures;
+};
+
+struct LoopbackResult {
+  bool ran = false;
+  bool connected = false;
+  unsigned requests = 0;
+  unsigned ok = 0;
+  unsigned mismatches = 0;
+  double seconds = 0;
+  std::vector<double> latencyMs;
+  int rpmMin = 0, rpmMax = 0;  // Readings seen while a scenario runs
+  int speedMax = 0;
+  uint32_t scenarioMs = 0;     // Scenario time the requests covered
+};
+
+struct InitResult {
+  std::string path;
+  KLineProtocol protocol;
+  unsigned runs = 0;
+  unsigned ok = 0;
+  unsigned mismatches = 0;  // First reading after the init was wrong
+  std::vector<double> ms;
+};
+
+struct AdaptiveResult {
+  bool connected = false;
+  unsigned requests[2] = {0, 0};  // Static, adaptive
+  double seconds[2] = {0, 0};
+  double error[2] = {0, 0};       // RMS error over tolerance, mean of the channels
+};
+
+struct BlockResult {
+  bool connected = false;
+  unsigned blockReads = 0, blockOk = 0, blockValues = 0;
+  unsigned pidReads = 0, pidOk = 0;
+  unsigned mismatches = 0;
+  double blockSeconds = 0, pidSeconds = 0;
+};
+
+// Keeps the compiler from dropping a result nobody reads
+template <class T>
+static inline void keep(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+static double nowNs() {
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ----------------------------------- Microbenchmarks -----------------------------------
+
+static const int RUNS = 5;
+
+// Calls op(i) with a growing batch size until a batch takes minTime / RUNS,
+// then times RUNS batches of that size. An op that handles `items` records
+// is reported per record.
+template <class Op>
+static BenchResult measure(const char *name, const Options &options, Op op, unsigned items = 1) {
+  double target = options.minTimeMs * 1e6 / RUNS;
+  uint64_t batch = 1;
+  for (;;) {
+    double start = nowNs();
+    for (uint64_t i = 0; i < batch; i++) op(i);
+    if (nowNs() - start >= target || batch >= (1ull << 40)) break;
+    batch *= 2;
+  }
+
+  std::vector<double> runs;
+  for (int r = 0; r < RUNS; r++) {
+    double start = nowNs();
+    for (uint64_t i = 0; i < batch; i++) op(i);
+    runs.push_back((nowNs() - start) / batch / items);
+  }
+  std::sort(runs.begin(), runs.end());
+
+  BenchResult result = {name, batch * RUNS * items, runs.front(), runs[RUNS / 2]};
+  fprintf(stderr, "  %-28s %10.2f ns/op  (median %.1f, %llu ops)\n", name, result.nsPerOp, result.nsPerOpMed,
+          (unsigned long long)result.ops);
+  return result;
+}
+
+static bool wanted(const Options &options, const char *name) {
+  return !options.filter || strstr(name, options.filter);
+}
+
+// A Honda table 0x17 answer like the simulator sends, checksum included
+static void makeTable17Frame(std::mt19937 &rng, uint8_t frame[24]) {
+  frame[0] = 0x02;
+  frame[1] = 0x18;
+  frame[2] = 0x71;
+  frame[3] = 0x17;
+  for (int i = 4; i < 23; i++) frame[i] = rng();
+  frame[23] = klineChecksum(FRAMING_HONDA, frame, 23);
+}
+
+// Local TCP clients that read and drop whatever the reader broadcasts
+struct BroadcastSink {
+  std::vector<int> sockets;
+  std::vector<std::thread> readers;
+
+  bool connect(uint16_t port, int count) {
+    for (int i = 0; i < count; i++) {
+      int fd = socket(AF_INET, SOCK_STREAM, 0);
+      sockaddr_in address = {};
+      address.sin_family = AF_INET;
+      address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      address.sin_port = htons(port);
+      if (fd < 0 || ::connect(fd, (sockaddr *)&address, sizeof(address)) < 0) {
+        if (fd >= 0) close(fd);
+        return false;
+      }
+      sockets.push_back(fd);
+      readers.emplace_back([fd] {
+        char drop[4096];
+        while (recv(fd, drop, sizeof(drop), 0) > 0) {
+        }
+      });
+    }
+    return true;
+  }
+
+  ~BroadcastSink() {
+    for (int fd : sockets) shutdown(fd, SHUT_RDWR);
+    for (std::thread &reader : readers) reader.join();
+    for (int fd : sockets) close(fd);
+  }
+};
+
+// A local UDP client subscribed to the reader's sample stream, counting what
+// arrives with LossCounter
+struct UdpSink {
+  int fd = -1;
+  std::thread reader;
+  std::atomic<bool> stopping{false};
+  LossCounter loss;
+
+  bool subscribe(uint16_t port) {
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return false;
+    int size = 4 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    timeval timeout = {0, 100000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (sendto(fd, "SUB", 3, 0, (sockaddr *)&address, sizeof(address)) < 0) return false;
+
+    reader = std::thread([this] {
+      uint8_t packet[SAMPLE_BLOCK_PACKET_MAX_SIZE];
+      while (!stopping) {
+        ssize_t n = recv(fd, packet, sizeof(packet), 0);
+        uint32_t sequence;
+        LiveSample sample;
+        SampleDecoder block;
+        if (n <= 0) continue;
+        if (decodeSamplePacket(packet, n, sequence, sample)) {
+          loss.add(sequence);
+        } else if (decodeSampleBlockPacket(packet, n, sequence, block)) {
+          while (block.next(sample)) loss.add(sequence++);
+        }
+      }
+    });
+    return true;
+  }
+
+  ~UdpSink() {
+    stopping = true;
+    if (reader.joinable()) reader.join();
+    if (fd >= 0) close(fd);
+  }
+};
+
+// ----------------------------------- Bulk decode -----------------------------------
+
+static const BulkKernel KERNELS[] = {BULK_SCALAR, BULK_SSE2, BULK_AVX2};
+
+static bool sameBits(float a, float b) {
+  return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+// Every PID with every A / B pair, and every value of every table 0x17 byte,
+// through each kernel this CPU runs. Odd strides put the last records on the
+// scalar tail too.
+static VerifyResult verifyBulkDecode() {
+  VerifyResult result;
+  const size_t COUNT = 65536;
+  BulkKernel original = bulkKernel();
+
+  const size_t PID_STRIDE = 3;  // <pid> <A> <B>
+  std::vector<uint8_t> records(COUNT * PID_STRIDE);
+  std::vector<float> expected(COUNT), actual(COUNT);
+
+  const size_t HONDA_STRIDE = 19;  // Table 0x17 payload
+  std::vector<uint8_t> payloads(COUNT * HONDA_STRIDE);
+  for (size_t i = 0; i < COUNT; i++) {
+    uint8_t *p = &payloads[i * HONDA_STRIDE];
+    memset(p, (uint8_t)(i * 7), HONDA_STRIDE);  // Every single-byte field sees all 256 values
+    p[0] = i >> 8;
+    p[1] = i & 0xFF;
+  }
+  std::vector<HondaLiveData> honda(COUNT);
+  for (size_t i = 0; i < COUNT; i++) parseHondaTable17(&payloads[i * HONDA_STRIDE], honda[i]);
+
+  for (BulkKernel kernel : KERNELS) {
+    if (!setBulkKernel(kernel)) continue;
+    result.kernels.push_back(bulkKernelName(kernel));
+
+    for (int pid = 0; pid < 256; pid++) {
+      for (size_t i = 0; i < COUNT; i++) {
+        uint8_t *record = &records[i * PID_STRIDE];
+        record[0] = pid;
+        record[1] = i >> 8;
+        record[2] = i & 0xFF;
+        expected[i] = decodePID(pid, record[1], record[2], 0, 0);
+      }
+      decodePIDBulk(records.data(), PID_STRIDE, COUNT, actual.data());
+      for (size_t i = 0; i < COUNT; i++) result.mismatches += !sameBits(expected[i], actual[i]);
+      result.values += COUNT;
+    }
+
+    std::vector<float> columns[8];
+    for (std::vector<float> &column : columns) column.assign(COUNT, NAN);
+    HondaTable17Columns out;
+    out.engineSpeed_rpm = columns[0].data();
+    out.tps_percent = columns[1].data();
+    out.iat_celsius = columns[2].data();
+    out.ect_celsius = columns[3].data();
+    out.map_mbar = columns[4].data();
+    out.battery_volt = columns[5].data();
+    out.vehicleSpeed_kmh = columns[6].data();
+    out.ignition_deg = columns[7].data();
+    decodeHondaTable17Bulk(payloads.data(), HONDA_STRIDE, COUNT, out);
+
+    for (size_t i = 0; i < COUNT; i++) {
+      const HondaLiveData &d = honda[i];
+      const float scalar[8] = {d.engineSpeed_rpm, d.tps_percent, (float)d.iat_celsius, (float)d.ect_celsius,
+                               (float)d.map_mbar, d.battery_volt, (float)d.vehicleSpeed_kmh, d.ignition_deg};
+      for (int f = 0; f < 8; f++) result.mismatches += !sameBits(scalar[f], columns[f][i]);
+      result.values += 8;
+    }
+  }
+
+  setBulkKernel(original);
+  fprintf(stderr, "bulk decode check: %llu values, %llu mismatches\n", (unsigned long long)result.values,
+          (unsigned long long)result.mismatches);
+  return result;
+}
+
+// ----------------------------------- Sample codec -----------------------------------
+
+// Table 0x17 payload the simulator answers with for this state (EcuResponder::handleHonda)
+static void stateToTable17(const EcuState &state, uint8_t payload[19]) {
+  auto u8 = [](long v) -> uint8_t { return v < 0 ? 0 : v > 255 ? 255 : v; };
+  memset(payload, 0xFF, 19);
+  payload[0] = (state.rpm >> 8) & 0xFF;
+  payload[1] = state.rpm & 0xFF;
+  payload[3] = u8(state.tps);
+  payload[4] = u8(lroundf(state.ignitionDeg * 2 + 64.0f));
+  payload[5] = u8(lroundf(state.iat + 40));
+  payload[7] = u8(lroundf(state.ect + 40));
+  payload[9] = u8(lroundf(state.mbar / 10.0f));
+  payload[10] = u8(lroundf(state.batt * 10.0f));
+  payload[16] = u8(state.speed);
+}
+
+// Honda samples of a whole WLTP-like drive, polled every 125 ms with a few ms of jitter
+static std::vector<LiveSample> driveSamples() {
+  std::mt19937 rng(43);
+  DriveScenario scenario;
+  scenario.begin(TRACE_WLTP, false);
+  std::vector<LiveSample> samples;
+  uint64_t timeUs = 1000000;
+  while (!scenario.finished()) {
+    timeUs += 125000 + rng() % 6000;
+    scenario.advanceTo(timeUs / 1000);
+    uint8_t payload[19];
+    stateToTable17(scenario.state(), payload);
+    HondaLiveData data;
+    parseHondaTable17(payload, data);
+    LiveSample sample = {};
+    sample.timeUs = timeUs;
+    hondaToSample(data, sample);
+    samples.push_back(sample);
+  }
+  return samples;
+}
+
+static CodecResult checkSampleCodec(const std::vector<LiveSample> &samples) {
+  CodecResult result;
+  uint8_t block[SAMPLE_BLOCK_MAX_SIZE];
+  SampleEncoder encoder;
+  size_t next = 0;
+  while (next < samples.size()) {
+    size_t first = next;
+    encoder.begin(block);
+    while (next < samples.size() && encoder.add(samples[next])) next++;
+    uint16_t length = encoder.finish();
+    result.blockBytes += length;
+    result.blocks++;
+
+    SampleDecoder decoder;
+    decoder.begin(block, length);
+    LiveSample sample;
+    size_t i = first;
+    for (; decoder.next(sample); i++) {
+      const LiveSample &expected = samples[i];
+      bool same = sample.timeUs == expected.timeUs && sample.validMask == expected.validMask;
+      for (uint8_t ch = 0; ch < CHANNEL_COUNT && same; ch++) {
+        if (expected.validMask & (1 << ch)) same = sameBits(sample.value[ch], expected.value[ch]);
+      }
+      result.mismatches += !same;
+    }
+    result.mismatches += next - i;  // Samples that didn't come back out
+  }
+
+  for (const LiveSample &sample : samples) {
+    char line[LOG_BUFFER_SIZE];
+    uint8_t packet[SAMPLE_PACKET_MAX_SIZE];
+    result.textBytes += formatSample(sample, line, sizeof(line)) + 1;
+    result.packetBytes += encodeSamplePacket(0, sample, packet, sizeof(packet));
+  }
+  result.samples = samples.size();
+
+  double n = result.samples ? (double)result.samples : 1;
+  fprintf(stderr,
+          "sample codec: %llu WLTP samples, text %.1f, datagram %.1f, block %.1f bytes/sample (x%.1f, x%.1f), "
+          "%llu mismatches\n",
+          (unsigned long long)result.samples, result.textBytes / n, result.packetBytes / n, result.blockBytes / n,
+          result.blockBytes ? (double)result.textBytes / result.blockBytes : 0.0,
+          result.blockBytes ? (double)result.packetBytes / result.blockBytes : 0.0,
+          (unsigned long long)result.mismatches);
+  return result;
+}
+
+// ----------------------------------- Checks -----------------------------------
+
+static bool expect(CheckResult &result, bool ok, const char *format, ...) {
+  result.checks++;
+  if (!ok) {
+    char text[160];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    result.failures.push_back(text);
+  }
+  return ok;
+}
+
+static void reportCheck(const CheckResult &result) {
+  fprintf(stderr, "%s check: %u checks, %zu failed\n", result.name.c_str(), result.checks, result.failures.size());
+  for (const std::string &failure : result.failures) fprintf(stderr, "  %s\n", failure.c_str());
+}
+
+struct SplitFrame {
+  uint8_t source;
+  std::vector<uint8_t> data;
+  bool operator==(const SplitFrame &other) const { return source == other.source && data == other.data; }
+};
+
+// Header, data and checksum the way an ECU sends them
+static std::vector<uint8_t> makeFrame(KLineFraming framing, uint8_t source, const std::vector<uint8_t> &data) {
+  std::vector<uint8_t> frame;
+  if (framing == FRAMING_ISO9141) frame = {0x48, 0x6B, source};
+  if (framing == FRAMING_KWP2000) frame = {(uint8_t)(0x80 | data.size()), 0xF1, source};
+  if (framing == FRAMING_HONDA) frame = {source, (uint8_t)(data.size() + 3)};
+  frame.insert(frame.end(), data.begin(), data.end());
+  frame.push_back(klineChecksum(framing, frame.data(), frame.size()));
+  return frame;
+}
+
+// Fed all at once, or after every byte and once complete as readData() does
+static std::vector<SplitFrame> split(KLineFraming framing, const std::vector<uint8_t> &stream, bool bytewise,
+                                     uint16_t &dropped) {
+  KLineFrameSplitter splitter;
+  splitter.begin(framing, stream.data());
+  if (bytewise) {
+    for (uint16_t n = 1; n <= stream.size(); n++) splitter.feed(n);
+  }
+  splitter.feed(stream.size(), true);
+  std::vector<SplitFrame> frames;
+  for (uint8_t i = 0; i < splitter.frameCount(); i++) {
+    const uint8_t *d = splitter.data(i);
+    frames.push_back({splitter.frame(i).source, std::vector<uint8_t>(d, d + splitter.frame(i).dataLength)});
+  }
+  dropped = splitter.droppedBytes();
+  return frames;
+}
+
+static bool expectSplit(CheckResult &result, KLineFraming framing, const char *what,
+                        const std::vector<uint8_t> &stream, const std::vector<SplitFrame> &expected,
+                        uint16_t expectedDropped = 0) {
+  static const char *const NAMES[] = {"iso9141", "kwp2000", "honda"};
+  bool ok = true;
+  for (bool bytewise : {false, true}) {
+    uint16_t dropped;
+    std::vector<SplitFrame> frames = split(framing, stream, bytewise, dropped);
+    ok &= expect(result, frames == expected && dropped == expectedDropped,
+                 "%s %s%s: %zu frames, %u dropped; expected %zu, %u", NAMES[framing], what,
+                 bytewise ? " bytewise" : "", frames.size(), dropped, expected.size(), expectedDropped);
+  }
+  return ok;
+}
+
+// Data bytes that equal the running sum are the trap for ISO 9141, which
+// has no length: the first match isn't the checksum. Fixed cases from real
+// answers, then random frames where one data byte is forced onto the sum.
+static CheckResult checkSplitter() {
+  CheckResult result;
+  result.name = "splitter";
+
+  std::vector<uint8_t> load = makeFrame(FRAMING_ISO9141, 0x10, {0x41, 0x04, 0x80});  // 04 = sum of 48 6B 10 41
+  expectSplit(result, FRAMING_ISO9141, "PID 04", load, {{0x10, {0x41, 0x04, 0x80}}});
+  std::vector<uint8_t> rpm = makeFrame(FRAMING_ISO9141, 0x10, {0x41, 0x0C, 0x10, 0x20});  // A = running sum
+  expectSplit(result, FRAMING_ISO9141, "RPM", rpm, {{0x10, {0x41, 0x0C, 0x10, 0x20}}});
+
+  std::vector<uint8_t> both = rpm;
+  both.insert(both.end(), load.begin(), load.end());
+  expectSplit(result, FRAMING_ISO9141, "RPM + PID 04", both,
+              {{0x10, {0x41, 0x0C, 0x10, 0x20}}, {0x10, {0x41, 0x04, 0x80}}});
+
+  std::vector<uint8_t> noisy = {0x00, 0x6B};
+  noisy.insert(noisy.end(), load.begin(), load.end());
+  expectSplit(result, FRAMING_ISO9141, "after garbage", noisy, {{0x10, {0x41, 0x04, 0x80}}}, 2);
+
+  std::vector<uint8_t> cut = {0x48, 0x6B, 0x10, 0x41, 0x0C};
+  expectSplit(result, FRAMING_ISO9141, "cut off", cut, {}, cut.size());
+
+  std::mt19937 rng(26);
+  for (KLineFraming framing : {FRAMING_ISO9141, FRAMING_KWP2000, FRAMING_HONDA}) {
+    for (int run = 0; run < 200; run++) {
+      std::vector<uint8_t> stream;
+      std::vector<SplitFrame> expected;
+      unsigned frames = 1 + rng() % 4;
+      for (unsigned f = 0; f < frames; f++) {
+        uint8_t source = framing == FRAMING_HONDA ? 0x02 : 0x10 + rng() % 2;
+        std::vector<uint8_t> data(2 + rng() % 6);  // ISO 9141 carries up to 7
+        data[0] = 0x41;
+        for (size_t i = 1; i < data.size(); i++) {
+          do data[i] = rng(); while (data[i] == 0x48);  // 48 6B inside the data would read as a header
+        }
+        std::vector<uint8_t> frame = makeFrame(framing, source, data);
+        size_t collide = 1 + rng() % (data.size() - 1);
+        size_t at = frame.size() - 1 - data.size() + collide;
+        uint8_t sum = 0;
+        for (size_t i = 0; i < at; i++) sum += frame[i];
+        if (sum != 0x48) data[collide] = sum;
+        frame = makeFrame(framing, source, data);
+        stream.insert(stream.end(), frame.begin(), frame.end());
+        expected.push_back({source, data});
+      }
+      if (!expectSplit(result, framing, "random", stream, expected)) break;
+    }
+  }
+
+  reportCheck(result);
+  return result;
+}
+
+struct LogRow {
+  uint64_t offset;
+  uint8_t source;
+  LiveSample sample;  // sample.timeUs is the record time
+};
+
+static void appendRecord(std::vector<uint8_t> &log, uint8_t type, uint64_t timeUs,
+                         const std::vector<uint8_t> &payload) {
+  uint8_t record[KLOG_MAX_RECORD_SIZE];
+  uint16_t n = encodeLogRecord(type, timeUs, payload.data(), payload.size(), record, sizeof(record));
+  log.insert(log.end(), record, record + n);
+}
+
+// Frame records of every kind the reader logs, frame-less records, sample
+// blocks and junk between records, enough of them for klconvert to cut the
+// file into several chunks. The rows klconvert should print come back in
+// expected.
+static std::vector<uint8_t> makeLog(std::vector<LogRow> &expected) {
+  std::mt19937 rng(30);
+  std::vector<uint8_t> log(KLOG_FILE_HEADER_SIZE);
+  writeLogFileHeader(log.data());
+  uint64_t timeUs = 1000000;
+
+  while (log.size() < (5u << 19)) {  // 2.5 MiB
+    timeUs += 20000 + rng() % 100000;
+    uint64_t offset = log.size();
+    unsigned kind = rng() % 8;
+
+    if (kind < 3) {  // Honda table 0x17
+      std::vector<uint8_t> data = {0x71, 0x17};
+      for (int i = 0; i < 17; i++) data.push_back(rng());
+      std::vector<uint8_t> payload = {FRAMING_HONDA};
+      std::vector<uint8_t> frame = makeFrame(FRAMING_HONDA, 0x02, data);
+      payload.insert(payload.end(), frame.begin(), frame.end());
+      appendRecord(log, KLOG_FRAME, timeUs, payload);
+
+      LogRow row = {offset, 0x02, {timeUs, 0, {0}}};
+      decodeFrameData(data.data(), data.size(), row.sample);
+      expected.push_back(row);
+    } else if (kind < 5) {  // Two mode 01 answers in one record, and one frame without a channel
+      std::vector<std::vector<uint8_t>> answers = {
+          {0x41, 0x0C, (uint8_t)rng(), (uint8_t)rng()},
+          {0x41, 0x05, (uint8_t)rng()},
+          {0x41, 0x00, 0xBE, 0x1F, 0xA8, 0x13}};
+      std::vector<uint8_t> payload = {FRAMING_KWP2000};
+      for (const auto &data : answers) {
+        uint8_t source = 0x10 + rng() % 2;
+        std::vector<uint8_t> frame = makeFrame(FRAMING_KWP2000, source, data);
+        payload.insert(payload.end(), frame.begin(), frame.end());
+
+        LogRow row = {offset, source, {timeUs, 0, {0}}};
+        if (decodeFrameData(data.data(), data.size(), row.sample)) expected.push_back(row);
+      }
+      appendRecord(log, KLOG_FRAME, timeUs, payload);
+    } else if (kind == 5) {  // Framing byte only, no answer
+      appendRecord(log, KLOG_FRAME, timeUs, {FRAMING_ISO9141});
+    } else if (kind == 6) {  // A block of samples, the record time is the first one's
+      uint8_t block[SAMPLE_BLOCK_MAX_SIZE];
+      SampleEncoder encoder;
+      encoder.begin(block);
+      uint64_t sampleUs = timeUs;
+      for (unsigned i = 1 + rng() % 24; i > 0; i--) {
+        uint8_t table[17];
+        for (uint8_t &b : table) b = rng();
+        HondaLiveData data;
+        parseHondaTable17(table, data);
+        LogRow row = {offset, 0, {sampleUs, 0, {0}}};
+        hondaToSample(data, row.sample);
+        if (!encoder.add(row.sample)) break;
+        expected.push_back(row);
+        sampleUs += 125000;
+      }
+      uint16_t length = encoder.finish();
+      appendRecord(log, KLOG_SAMPLES, timeUs, std::vector<uint8_t>(block, block + length));
+      timeUs = sampleUs;
+    } else {  // Junk the decoder has to resync over
+      log.insert(log.end(), 1 + rng() % 3, 0x00);
+    }
+  }
+  return log;
+}
+
+// One CSV line of klconvert without its newline: offset,time_us,source,<channels>
+static bool parseCsvRow(const char *line, LogRow &row) {
+  char *end;
+  row.offset = strtoull(line, &end, 10);
+  if (*end != ',') return false;
+  row.sample.timeUs = strtoull(end + 1, &end, 10);
+  if (*end != ',') return false;
+  row.source = strtoul(end + 1, &end, 10);
+  row.sample.validMask = 0;
+  for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+    if (*end != ',') return false;
+    const char *field = end + 1;
+    row.sample.value[ch] = strtof(field, &end);
+    if (end != field) row.sample.validMask |= 1 << ch;
+  }
+  return *end == '\0';
+}
+
+static bool sameRow(const LogRow &a, const LogRow &b) {
+  if (a.offset != b.offset || a.source != b.source || a.sample.timeUs != b.sample.timeUs ||
+      a.sample.validMask != b.sample.validMask) {
+    return false;
+  }
+  for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+    if ((a.sample.validMask & (1 << ch)) && !sameBits(a.sample.value[ch], b.sample.value[ch])) return false;
+  }
+  return true;
+}
+
+// A .klog written with encodeLogRecord, through klconvert whole and cut into
+// 1 MiB chunks on 4 threads: every row once, in order, with its record's
+// offset and time
+static CheckResult checkLogConvert(const std::string &klconvert) {
+  CheckResult result;
+  result.name = "klog";
+
+  std::vector<LogRow> expected;
+  std::vector<uint8_t> log = makeLog(expected);
+  char logPath[] = "/tmp/klbench-XXXXXX";
+  char csvPath[] = "/tmp/klbench-XXXXXX";
+  int logFd = mkstemp(logPath);
+  int csvFd = mkstemp(csvPath);
+  bool written = logFd >= 0 && csvFd >= 0 && write(logFd, log.data(), log.size()) == (ssize_t)log.size();
+  if (logFd >= 0) close(logFd);
+  if (csvFd >= 0) close(csvFd);
+
+  if (expect(result, written, "cannot write a temporary .klog")) {
+    for (const char *args : {"-j 1", "-j 4 -c 1"}) {
+      std::string command = "'" + klconvert + "' -i klog " + args + " -o " + csvPath + " " + logPath + " 2>/dev/null";
+      int status = system(command.c_str());
+      if (!expect(result, status == 0, "%s: exit status %d", command.c_str(), status)) continue;
+
+      FILE *csv = fopen(csvPath, "r");
+      char line[512];
+      size_t rows = 0;
+      if (csv && fgets(line, sizeof(line), csv)) {  // Header
+        while (fgets(line, sizeof(line), csv)) {
+          line[strcspn(line, "\n")] = '\0';
+          LogRow row;
+          bool same = parseCsvRow(line, row) && rows < expected.size() && sameRow(row, expected[rows]);
+          if (!expect(result, same, "klconvert %s row %zu: %.80s", args, rows + 1, line)) break;
+          rows++;
+        }
+      }
+      if (csv) fclose(csv);
+      expect(result, rows == expected.size(), "klconvert %s: %zu rows, expected %zu", args, rows, expected.size());
+    }
+  }
+  unlink(logPath);
+  unlink(csvPath);
+
+  reportCheck(result);
+  return result;
+}
+
+static bool expectParseError(CheckResult &result, const char *line, const char *reason) {
+  KLineCommand command;
+  const char *error = nullptr;
+  bool parsed = parseCommand(line, 0, command, &error);
+  return expect(result, !parsed && error && strcmp(error, reason) == 0, "\"%s\": %s, expected \"%s\"", line,
+                parsed ? "parsed" : error ? error : "no reason", reason);
+}
+
+// Parsing and syntax errors, then the queue against a sorted list: earliest
+// deadline first, arrival order among equal deadlines, across the millis()
+// wrap, and what a full queue does
+static CheckResult checkCommandQueue() {
+  CheckResult result;
+  result.name = "command queue";
+
+  static const struct {
+    const char *line;
+    CommandKind kind;
+    uint8_t mode, pid;
+    uint32_t deadlineMs;
+  } COMMANDS[] = {
+      {"DTC", COMMAND_READ_DTCS, 0x03, 0x00, 1000},
+      {"DTC PENDING", COMMAND_READ_DTCS, 0x07, 0x00, 1000},
+      {"CLEAR", COMMAND_CLEAR_DTCS, 0x04, 0x00, 250},
+      {"VIN @20", COMMAND_READ_VIN, 0x09, 0x02, 20},
+      {"TABLE 17", COMMAND_READ_TABLE, 0x01, 0x17, 250},
+      {"PID 01 0C @0", COMMAND_READ_PID, 0x01, 0x0C, 0},
+  };
+  for (const auto &c : COMMANDS) {
+    KLineCommand command;
+    bool parsed = parseCommand(c.line, 5000, command);
+    expect(result, parsed && command.kind == c.kind && command.mode == c.mode && command.pid == c.pid &&
+                       command.queuedMs == 5000 && command.deadlineMs == 5000 + c.deadlineMs,
+           "\"%s\": kind %u mode %02X pid %02X deadline +%u", c.line, command.kind, command.mode, command.pid,
+           command.deadlineMs - 5000);
+  }
+  expectParseError(result, "", "empty command");
+  expectParseError(result, "PID 1", "PID needs a hex mode and PID");
+  expectParseError(result, "PID 01 100", "PID needs a hex mode and PID");
+  expectParseError(result, "PID 03 00", "PID mode must be 01 or 02");
+  expectParseError(result, "PID 21 01", "PID mode must be 01 or 02");
+  expectParseError(result, "CLEAR @x", "bad deadline");
+  expectParseError(result, "CLEAR @-5", "bad deadline");
+  expectParseError(result, "DTC FOO", "DTC takes STORED or PENDING");
+  expectParseError(result, "TABLE", "TABLE needs a hex table number");
+  expectParseError(result, "VIN 02", "too many arguments");
+  expectParseError(result, "RESET", "unknown command");
+
+  // Deadlines straddle the millis() wrap: 40 ms after now wraps round to 24
+  const uint32_t nowMs = 0xFFFFFFF0;
+  KLineCommand vin, clear;
+  parseCommand("VIN @10", nowMs, vin);
+  parseCommand("CLEAR @40", nowMs, clear);
+  expect(result, !CommandQueue::expired(clear, nowMs + 40) && CommandQueue::expired(clear, nowMs + 41),
+         "CLEAR due at %u expired at the wrong time", clear.deadlineMs);
+  expect(result, CommandQueue::expired(vin, clear.deadlineMs) && !CommandQueue::expired(clear, vin.deadlineMs),
+         "expired() across the wrap: VIN due at %u, CLEAR at %u", vin.deadlineMs, clear.deadlineMs);
+  {
+    CommandQueue queue;
+    KLineCommand first;
+    queue.push(clear);
+    queue.push(vin);
+    expect(result, queue.pop(first) && first.kind == COMMAND_READ_VIN,
+           "VIN due at %u should go before CLEAR due at %u", vin.deadlineMs, clear.deadlineMs);
+  }
+
+  // Random pushes and pops, ties on purpose; client holds the arrival order
+  std::mt19937 rng(41);
+  for (int run = 0; run < 500; run++) {
+    CommandQueue queue;
+    std::vector<KLineCommand> pending;
+    uint16_t arrivals = 0;
+    bool ok = true;
+    for (int step = 0; step < 64 && ok; step++) {
+      if (rng() % 3 != 0) {
+        KLineCommand command = clear;
+        command.deadlineMs = nowMs + rng() % 40;
+        command.client = arrivals++;
+        bool pushed = queue.push(command);
+        ok &= expect(result, pushed == (pending.size() < COMMAND_QUEUE_SIZE), "push with %zu queued returned %d",
+                     pending.size(), pushed);
+        if (pushed) pending.push_back(command);
+      } else {
+        auto sooner = [&](const KLineCommand &a, const KLineCommand &b) {
+          uint32_t da = a.deadlineMs - nowMs, db = b.deadlineMs - nowMs;
+          return da != db ? da < db : a.client < b.client;
+        };
+        auto earliest = std::min_element(pending.begin(), pending.end(), sooner);
+        KLineCommand out;
+        bool popped = queue.pop(out);
+        if (earliest == pending.end()) {
+          ok &= expect(result, !popped, "pop from an empty queue returned a command");
+          continue;
+        }
+        ok &= expect(result, popped && out.client == earliest->client,
+                     "pop: arrival %u due at +%u, expected arrival %u due at +%u", out.client, out.deadlineMs - nowMs,
+                     earliest->client, earliest->deadlineMs - nowMs);
+        pending.erase(earliest);
+      }
+      ok &= expect(result, queue.size() == pending.size(), "size %u, expected %zu", queue.size(), pending.size());
+    }
+  }
+
+  // A full queue turns the next command away and counts it, and takes one again after a pop
+  CommandQueue queue;
+  for (uint8_t i = 0; i < COMMAND_QUEUE_SIZE; i++) queue.push(vin);
+  KLineCommand out;
+  expect(result, !queue.push(clear) && queue.size() == COMMAND_QUEUE_SIZE && queue.rejected() == 1,
+         "full queue: size %u, %u rejected", queue.size(), queue.rejected());
+  expect(result, queue.pop(out) && queue.push(clear) && queue.rejected() == 1, "no room after a pop from a full queue");
+
+  reportCheck(result);
+  return result;
+}
+
+// One reading as ChannelStats sees it: the time since the previous reading
+// (0 after a gap over 2 s) and how much of it was above the threshold
+struct StatsReading {
+  uint64_t timeUs;
+  float value;
+  uint64_t elapsedUs;
+  uint64_t aboveUs;
+};
+
+// ChannelStats of one channel and window against the readings it should
+// cover, summed in double: count, min / max and time exact, mean and
+// deviation to float rounding, quantiles within a bin of the sorted value
+static void expectStats(CheckResult &result, const ChannelStats &stats, uint8_t channel, int8_t window,
+                        const std::vector<StatsReading> &readings, float binWidth) {
+  const char *name = CHANNEL_NAMES[channel];
+  StatsSummary s;
+  bool any = stats.summary(channel, window, s);
+  if (readings.empty()) {
+    expect(result, !any && isnan(stats.quantile(channel, window, 0.5f)), "%s window %d: %u readings, expected none",
+           name, window, s.count);
+    return;
+  }
+
+  double sum = 0, squares = 0;
+  uint64_t aboveUs = 0, coveredUs = 0;
+  std::vector<float> sorted;
+  for (const StatsReading &r : readings) {
+    sum += r.value;
+    aboveUs += r.aboveUs;
+    coveredUs += r.elapsedUs;
+    sorted.push_back(r.value);
+  }
+  std::sort(sorted.begin(), sorted.end());
+  double mean = sum / readings.size();
+  for (const StatsReading &r : readings) squares += (r.value - mean) * (r.value - mean);
+  double stddev = readings.size() > 1 ? sqrt(squares / (readings.size() - 1)) : 0;
+
+  if (!expect(result, any && s.count == readings.size(), "%s window %d: %u readings, expected %zu", name, window,
+              s.count, readings.size())) {
+    return;
+  }
+  expect(result, s.min == sorted.front() && s.max == sorted.back(), "%s window %d: min %g max %g, expected %g %g",
+         name, window, s.min, s.max, sorted.front(), sorted.back());
+  expect(result, fabs(s.mean - mean) <= 1e-5 * fabs(mean) + 1e-4, "%s window %d: mean %.6f, expected %.6f", name,
+         window, s.mean, mean);
+  expect(result, fabs(s.stddev - stddev) <= 1e-3 * stddev + 1e-3, "%s window %d: stddev %.6f, expected %.6f", name,
+         window, s.stddev, stddev);
+  expect(result, s.aboveUs == aboveUs && s.coveredUs == coveredUs,
+         "%s window %d: above %llu / %llu us, expected %llu / %llu", name, window, (unsigned long long)s.aboveUs,
+         (unsigned long long)s.coveredUs, (unsigned long long)aboveUs, (unsigned long long)coveredUs);
+  for (float q : {0.01f, 0.25f, 0.5f, 0.9f, 0.99f}) {
+    size_t rank = (size_t)ceil(q * sorted.size());
+    float exact = sorted[rank > 0 ? rank - 1 : 0];
+    float estimate = stats.quantile(channel, window, q);
+    expect(result, fabs(estimate - exact) <= binWidth * 1.001f, "%s window %d: p%g %g, sorted %g", name, window,
+           q * 100, estimate, exact);
+  }
+}
+
+// A drive of RPM and ECT readings, ECT on every third sample, with gaps of
+// 2 s (still counted) and 2.5 s (left out). Compared with the readings
+// themselves every 500 samples, the trip and a 60 s window whose slices
+// age out as it goes, then once no slice of the window is left.
+static CheckResult checkChannelStats() {
+  CheckResult result;
+  result.name = "channel stats";
+
+  const uint8_t CHANNELS[] = {CH_ENGINE_SPEED, CH_COOLANT_TEMP};
+  const float THRESHOLD[] = {4000, 95};
+  const float BIN_WIDTH[] = {8000.0f / STATS_HISTOGRAM_BINS, 80.0f / STATS_HISTOGRAM_BINS};
+  const uint64_t SLICE_US = 60000000 / STATS_WINDOW_SLICES;
+
+  ChannelStats stats;
+  int8_t window = stats.addWindow(60);
+  stats.setRange(CH_COOLANT_TEMP, 40, 120);
+  for (uint8_t c = 0; c < 2; c++) stats.setThreshold(CHANNELS[c], THRESHOLD[c]);
+
+  std::mt19937 rng(36);
+  std::vector<StatsReading> readings[2];
+  float value[2] = {800, 85};
+  uint64_t timeUs = 1000000;
+  for (int i = 1; i <= 4000; i++) {
+    unsigned step = rng() % 100;
+    timeUs += step == 0 ? 2500000 : step == 1 ? 2000000 : 50000 + rng() % 150000;
+    LiveSample sample = {timeUs, 0, {0}};
+    for (uint8_t c = 0; c < 2; c++) {
+      if (c == 1 && i % 3 != 0) continue;
+      value[c] += c == 0 ? (int)(rng() % 401) - 200 : ((int)(rng() % 201) - 100) / 40.0f;
+      value[c] = c == 0 ? fminf(fmaxf(value[c], 700), 7500) : fminf(fmaxf(value[c], 60), 115);
+      sample.value[CHANNELS[c]] = value[c];
+      sample.validMask |= 1 << CHANNELS[c];
+
+      StatsReading reading = {timeUs, value[c], 0, 0};
+      if (!readings[c].empty()) {
+        const StatsReading &last = readings[c].back();
+        reading.elapsedUs = timeUs - last.timeUs <= 2000000 ? timeUs - last.timeUs : 0;
+        reading.aboveUs = last.value > THRESHOLD[c] ? reading.elapsedUs : 0;
+      }
+      readings[c].push_back(reading);
+    }
+    stats.push(sample);
+
+    if (i % 500 != 0) continue;
+    uint64_t current = timeUs / SLICE_US;
+    for (uint8_t c = 0; c < 2; c++) {
+      std::vector<StatsReading> recent;
+      for (const StatsReading &r : readings[c]) {
+        if (current - r.timeUs / SLICE_US < STATS_WINDOW_SLICES) recent.push_back(r);
+      }
+      expectStats(result, stats, CHANNELS[c], STATS_TRIP, readings[c], BIN_WIDTH[c]);
+      expectStats(result, stats, CHANNELS[c], window, recent, BIN_WIDTH[c]);
+    }
+  }
+
+  // A reading of another channel a window later: the trip keeps everything, the window nothing
+  LiveSample later = {timeUs + 60000000, 1 << CH_BATTERY, {0}};
+  later.value[CH_BATTERY] = 13.8f;
+  stats.push(later);
+  for (uint8_t c = 0; c < 2; c++) {
+    expectStats(result, stats, CHANNELS[c], STATS_TRIP, readings[c], BIN_WIDTH[c]);
+    expectStats(result, stats, CHANNELS[c], window, {}, BIN_WIDTH[c]);
+  }
+
+  reportCheck(result);
+  return result;
+}
+
+// A Honda answer with a marker byte, written where readData() will find it
+static std::vector<uint8_t> sendAnswer(int fd, uint8_t marker) {
+  std::vector<uint8_t> frame = makeFrame(FRAMING_HONDA, 0x02, {0x71, 0x17, marker});
+  if (write(fd, frame.data(), frame.size()) != (ssize_t)frame.size()) frame.clear();
+  return frame;
+}
+
+static bool viewHolds(const FrameView &view, const std::vector<uint8_t> &frame) {
+  return view && view.length() == frame.size() && memcmp(view.data(), frame.data(), frame.size()) == 0 &&
+         view.frames().frameCount() == 1 && view.frames().data(0)[2] == frame[4];
+}
+
+// Reference counts of FrameView on a pool of its own, then OBD2_KLine's
+// readData() fed from a pipe: a held view outlives the next answer, and
+// with every buffer held an answer is drained and dropped
+static CheckResult checkFramePool() {
+  CheckResult result;
+  result.name = "frame pool";
+
+  static FramePool pool;
+  FrameBuffer *buffer = pool.acquire();
+  expect(result, buffer && buffer->refs == 1 && pool.freeCount() == FRAME_POOL_SIZE - 1, "acquire: %u refs, %u free",
+         buffer ? buffer->refs : 0, pool.freeCount());
+  {
+    FrameView reader = FrameView::adopt(buffer);
+    FrameView logger(reader);
+    FrameView network;
+    network = logger;
+    FrameView &same = network;
+    network = same;
+    expect(result, buffer->refs == 3, "three views and a self-assignment: %u refs", buffer->refs);
+
+    FrameView queued = FrameView::adopt(network.retain());  // Through a queue as a plain pointer
+    expect(result, buffer->refs == 4 && queued.data() == buffer->data, "retain() and adopt(): %u refs", buffer->refs);
+    queued.release();
+    queued.release();  // A second release of an empty view does nothing
+    reader.release();
+    logger = FrameView();
+    expect(result, buffer->refs == 1 && pool.freeCount() == FRAME_POOL_SIZE - 1,
+           "one view left: %u refs, %u free", buffer->refs, pool.freeCount());
+  }
+  expect(result, buffer->refs == 0 && pool.freeCount() == FRAME_POOL_SIZE, "last view gone: %u refs, %u free",
+         buffer->refs, pool.freeCount());
+
+  std::vector<FrameBuffer *> held;
+  while (FrameBuffer *b = pool.acquire()) held.push_back(b);
+  expect(result, held.size() == FRAME_POOL_SIZE && pool.exhausted() == 1, "%zu buffers before exhausted, %u misses",
+         held.size(), pool.exhausted());
+  for (FrameBuffer *b : held) FrameView::adopt(b);  // Each temporary view hands its buffer back
+
+  int fds[2];
+  if (!expect(result, pipe(fds) == 0, "pipe() failed")) {
+    reportCheck(result);
+    return result;
+  }
+  HardwareSerial port;
+  port.attach(fds[0]);
+  OBD2_KLine kline(port, 10400, 16, 17);
+  kline.setProtocol(PROTOCOL_ISO14230_HONDA);
+  kline.setInterByteTimeout(5);
+  kline.setReadTimeout(50);
+
+  // Held views keep their answers while readData() moves on to other buffers
+  std::vector<FrameView> views;
+  std::vector<std::vector<uint8_t>> answers;
+  for (uint8_t i = 0; i < FRAME_POOL_SIZE; i++) {
+    answers.push_back(sendAnswer(fds[1], 0xA0 + i));
+    uint8_t n = kline.readData();
+    views.push_back(kline.lastResponse());
+    expect(result, n == answers[i].size() && viewHolds(views[i], answers[i]), "readData %u: %u bytes", i, n);
+  }
+  for (uint8_t i = 0; i < FRAME_POOL_SIZE; i++) {
+    expect(result, viewHolds(views[i], answers[i]), "view %u changed after later reads", i);
+  }
+
+  // Every buffer held: the answer is read off the bus and dropped
+  sendAnswer(fds[1], 0xB0);
+  uint8_t n = kline.readData();
+  expect(result, n == 0 && !kline.lastResponse() && port.available() == 0 && kline.responseBuffersExhausted() == 1,
+         "readData with no free buffer: %u bytes, %d left on the bus, %u misses", n, port.available(),
+         kline.responseBuffersExhausted());
+
+  // One view let go is enough for the next answer
+  views.erase(views.begin());
+  std::vector<uint8_t> answer = sendAnswer(fds[1], 0xC0);
+  n = kline.readData();
+  expect(result, n == answer.size() && viewHolds(kline.lastResponse(), answer), "readData after a release: %u bytes",
+         n);
+  expect(result, viewHolds(views[0], answers[1]), "held view changed after a release and a read");
+
+  close(fds[0]);
+  close(fds[1]);
+  reportCheck(result);
+  return result;
+}
+
+static LiveSample captureSample(uint64_t timeUs, uint8_t channel, float value) {
+  LiveSample sample = {timeUs, (uint16_t)(1 << channel), {0}};
+  sample.value[channel] = value;
+  return sample;
+}
+
+static void onCheckSnapshot(const Snapshot &snapshot, void *context) {
+  static_cast<std::vector<Snapshot> *>(context)->push_back(snapshot);
+}
+
+// Trigger expressions, parsed and malformed; edge-only firing and re-arming;
+// the pre / post window before and after the ring fills; no second capture
+// while one runs; and the last snapshot keeping its label meanwhile
+static CheckResult checkCaptureBuffer() {
+  CheckResult result;
+  result.name = "capture";
+  std::vector<Snapshot> snapshots;
+
+  // Each fires on the third value only: the first two sit on the threshold
+  static const struct {
+    const char *expression;
+    uint8_t channel;
+    float values[3];
+  } FIRING[] = {
+      {"ECT>105", CH_COOLANT_TEMP, {100, 105, 106}}, {"IAT<0", CH_INTAKE_TEMP, {5, 0, -1}},
+      {"RPM+2000", CH_ENGINE_SPEED, {1000, 3000, 5001}}, {"TPS-10", CH_THROTTLE, {50, 40, 29}},
+      {"TPS~25", CH_THROTTLE, {10, 35, 9}}, {"IGN>-10", CH_IGNITION, {-12, -10, -9}},
+  };
+  for (const auto &f : FIRING) {
+    CaptureBuffer capture;
+    capture.setWindow(2, 0);
+    capture.onSnapshot(onCheckSnapshot, &snapshots);
+    snapshots.clear();
+    if (!expect(result, capture.addTrigger(f.expression), "\"%s\" rejected", f.expression)) continue;
+    for (uint8_t i = 0; i < 3; i++) capture.push(captureSample(1000 * (i + 1), f.channel, f.values[i]));
+    expect(result, snapshots.size() == 1 && strcmp(snapshots[0].reason, f.expression) == 0 &&
+                       snapshots[0].triggerTimeUs == 3000 && snapshots[0].count == 3 && snapshots[0].triggerIndex == 2,
+           "\"%s\": %zu snapshots, reason \"%s\" at %llu", f.expression, snapshots.size(),
+           snapshots.empty() ? "" : snapshots[0].reason,
+           snapshots.empty() ? 0ULL : (unsigned long long)snapshots[0].triggerTimeUs);
+  }
+  for (const char *bad : {"", ">5", "ECT", "ECT>", "FOO>5", "ECT>x", "ECT>5x", "ECT=5", "ECT 105"}) {
+    CaptureBuffer capture;
+    expect(result, !capture.addTrigger(bad), "\"%s\" accepted", bad);
+  }
+  {
+    CaptureBuffer capture;
+    for (uint8_t i = 0; i < CaptureBuffer::MAX_TRIGGERS; i++) capture.addTrigger("ECT>100");
+    expect(result, !capture.addTrigger("ECT>100"), "trigger %u accepted", CaptureBuffer::MAX_TRIGGERS + 1);
+  }
+
+  // Fires on the way over the threshold only, again after dropping below
+  {
+    CaptureBuffer capture;
+    capture.setWindow(1, 0);
+    capture.onSnapshot(onCheckSnapshot, &snapshots);
+    capture.addTrigger("ECT>100");
+    snapshots.clear();
+    const float values[] = {101, 102, 103, 99, 104, 105};
+    for (uint8_t i = 0; i < 6; i++) capture.push(captureSample(1000 * (i + 1), CH_COOLANT_TEMP, values[i]));
+    expect(result, snapshots.size() == 2 && snapshots[0].triggerTimeUs == 1000 && snapshots[1].triggerTimeUs == 5000,
+           "edge-only: %zu snapshots", snapshots.size());
+  }
+
+  // Window of 5 before and 3 after, first with only 3 samples before the trigger
+  CaptureBuffer capture;
+  capture.setWindow(5, 3);
+  capture.onSnapshot(onCheckSnapshot, &snapshots);
+  capture.addTrigger("RPM>5000");
+  capture.addTrigger("TPS>50");
+  snapshots.clear();
+  expect(result, !capture.hasSnapshot(), "snapshot before any trigger");
+  uint64_t timeUs = 0;
+  auto pushRpm = [&](float rpm) { capture.push(captureSample(timeUs += 1000, CH_ENGINE_SPEED, rpm)); };
+  for (float rpm : {1000, 2000, 3000, 6000, 4000, 4000}) pushRpm(rpm);
+  expect(result, capture.isCapturing() && snapshots.empty(), "frozen before the post samples were in");
+  pushRpm(4000);
+  bool shortOk = snapshots.size() == 1 && snapshots[0].count == 7 && snapshots[0].triggerIndex == 3 &&
+                 snapshots[0].triggerTimeUs == 4000 && !capture.isCapturing();
+  for (uint8_t i = 0; shortOk && i < 7; i++) shortOk = snapshots[0].samples[i].timeUs == 1000u * (i + 1);
+  expect(result, shortOk, "ring not full: %zu snapshots, %u samples, trigger at %u", snapshots.size(),
+         snapshots.empty() ? 0 : snapshots[0].count, snapshots.empty() ? 0 : snapshots[0].triggerIndex);
+
+  // A full ring; meanwhile a second trigger, trigger() and the old label
+  for (int i = 0; i < 20; i++) pushRpm(4000);
+  pushRpm(6000);
+  uint64_t triggerUs = timeUs;
+  expect(result, !capture.trigger("DTC P0171"), "trigger() started a capture while one was running");
+  capture.push(captureSample(timeUs += 1000, CH_THROTTLE, 80));
+  expect(result, strcmp(capture.lastSnapshot().reason, "RPM>5000") == 0 && capture.lastSnapshot().triggerTimeUs == 4000,
+         "during a capture the last snapshot reads \"%s\" at %llu", capture.lastSnapshot().reason,
+         (unsigned long long)capture.lastSnapshot().triggerTimeUs);
+  pushRpm(4000);
+  pushRpm(4000);
+  bool fullOk = snapshots.size() == 2 && snapshots[1].count == 9 && snapshots[1].triggerIndex == 5 &&
+                snapshots[1].triggerTimeUs == triggerUs && strcmp(snapshots[1].reason, "RPM>5000") == 0;
+  for (uint8_t i = 0; fullOk && i < 9; i++) fullOk = snapshots[1].samples[i].timeUs == triggerUs + 1000 * i - 5000;
+  expect(result, fullOk, "full ring: %zu snapshots, %u samples, trigger at %u", snapshots.size(),
+         snapshots.size() < 2 ? 0 : snapshots[1].count, snapshots.size() < 2 ? 0 : snapshots[1].triggerIndex);
+
+  // TPS went over while capturing: that edge is used up, no capture now
+  capture.push(captureSample(timeUs += 1000, CH_THROTTLE, 90));
+  expect(result, !capture.isCapturing() && snapshots.size() == 2, "TPS edge from the capture fired afterwards");
+  expect(result, capture.trigger("DTC P0171") && capture.isCapturing(), "trigger() refused with no capture running");
+
+  reportCheck(result);
+  return result;
+}
+
+static void runMicrobenchmarks(const Options &options, std::vector<BenchResult> &results) {
+  std::mt19937 rng(17);
+  const int FRAMES = 64;  // Varied inputs so branches don't settle on one path
+
+  uint8_t frames[FRAMES][24];
+  for (int i = 0; i < FRAMES; i++) makeTable17Frame(rng, frames[i]);
+
+  uint8_t pidBytes[256][4];
+  for (auto &bytes : pidBytes) {
+    for (uint8_t &b : bytes) b = rng();
+  }
+
+  auto add = [&](const char *name, auto op) {
+    if (wanted(options, name)) results.push_back(measure(name, options, op));
+  };
+
+  add("klineChecksum_kwp6", [&](uint64_t i) {
+    keep(klineChecksum(FRAMING_KWP2000, frames[i % FRAMES] + 4, 6));
+  });
+  add("klineChecksum_honda23", [&](uint64_t i) {
+    keep(klineChecksum(FRAMING_HONDA, frames[i % FRAMES], 23));
+  });
+  add("kwp_checksum_sim23", [&](uint64_t i) {
+    keep(kwp_checksum(frames[i % FRAMES], 23));
+  });
+  add("checksum_complete_frame24", [&](uint64_t i) {
+    keep(checksum_complete_frame(frames[i % FRAMES], 24));
+  });
+
+  // Same pattern as readData(): feed after every byte, then once complete
+  add("splitter_honda_bytewise", [&](uint64_t i) {
+    KLineFrameSplitter splitter;
+    splitter.begin(FRAMING_HONDA, frames[i % FRAMES]);
+    for (uint16_t n = 1; n <= 24; n++) splitter.feed(n);
+    keep(splitter.feed(24, true));
+  });
+
+  add("decodePID", [&](uint64_t i) {
+    const uint8_t *b = pidBytes[i & 0xFF];
+    keep(decodePID((uint8_t)i, b[0], b[1], b[2], b[3]));
+  });
+  add("parseHondaTable17", [&](uint64_t i) {
+    HondaLiveData data;
+    parseHondaTable17(frames[i % FRAMES] + 4, data);
+    keep(data);
+  });
+  add("hondaToSample", [&](uint64_t i) {
+    HondaLiveData data;
+    parseHondaTable17(frames[i % FRAMES] + 4, data);
+    LiveSample sample = {};
+    sample.timeUs = i;
+    hondaToSample(data, sample);
+    keep(sample);
+  });
+
+  // The same work in bulk: a block of table 0x17 payloads and mode 01 answers
+  const unsigned BLOCK = 4096;
+  std::vector<uint8_t> payloads(BLOCK * 19), pidRecords(BLOCK * 3);
+  for (unsigned i = 0; i < BLOCK; i++) {
+    memcpy(&payloads[i * 19], frames[i % FRAMES] + 4, 19);
+    static const uint8_t LIVE_PIDS[] = {0x04, 0x05, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x11, 0x42};
+    pidRecords[i * 3] = LIVE_PIDS[i % sizeof(LIVE_PIDS)];
+    pidRecords[i * 3 + 1] = rng();
+    pidRecords[i * 3 + 2] = rng();
+  }
+  std::vector<float> columns(8 * BLOCK);
+  HondaTable17Columns out;
+  out.engineSpeed_rpm = &columns[0 * BLOCK];
+  out.tps_percent = &columns[1 * BLOCK];
+  out.iat_celsius = &columns[2 * BLOCK];
+  out.ect_celsius = &columns[3 * BLOCK];
+  out.map_mbar = &columns[4 * BLOCK];
+  out.battery_volt = &columns[5 * BLOCK];
+  out.vehicleSpeed_kmh = &columns[6 * BLOCK];
+  out.ignition_deg = &columns[7 * BLOCK];
+
+  BulkKernel original = bulkKernel();
+  for (BulkKernel kernel : KERNELS) {
+    if (!setBulkKernel(kernel)) continue;
+    char name[48];
+    snprintf(name, sizeof(name), "hondaTable17Bulk_%s", bulkKernelName(kernel));
+    if (wanted(options, name)) {
+      results.push_back(measure(name, options, [&](uint64_t) {
+        decodeHondaTable17Bulk(payloads.data(), 19, BLOCK, out);
+        keep(columns[0]);
+      }, BLOCK));
+    }
+    snprintf(name, sizeof(name), "decodePIDBulk_%s", bulkKernelName(kernel));
+    if (wanted(options, name)) {
+      results.push_back(measure(name, options, [&](uint64_t) {
+        decodePIDBulk(pidRecords.data(), 3, BLOCK, columns.data());
+        keep(columns[0]);
+      }, BLOCK));
+    }
+  }
+  setBulkKernel(original);
+
+  add("formatDTC", [&](uint64_t i) {
+    char code[6];
+    formatDTC((uint16_t)(i * 2654435761u), code);
+    keep(code);
+  });
+  // decodeDTC(): formatDTC() plus the String it returns
+  add("decodeDTC_String", [&](uint64_t i) {
+    char code[6];
+    formatDTC((uint16_t)(i * 2654435761u), code);
+    String text(code);
+    keep(text);
+  });
+
+  // logf(): the live data line of GetLiveData.ino, then through the log queue
+  add("logf_format", [&](uint64_t i) {
+    HondaLiveData data;
+    parseHondaTable17(frames[i % FRAMES] + 4, data);
+    char buf[LOG_BUFFER_SIZE];
+    int n = snprintf(buf, sizeof(buf), "RPM:%.0f, TPS:%.1f, ECT:%d, IAT:%d, VSS:%d, MAP:%d, BATT:%.2f\n",
+                     data.engineSpeed_rpm, data.tps_percent, data.ect_celsius, data.iat_celsius,
+                     data.vehicleSpeed_kmh, data.map_mbar, data.battery_volt);
+    keep(n);
+  });
+  if (wanted(options, "logQueue_roundtrip")) {
+    QueueHandle_t queue = xQueueCreate(LOG_QUEUE_LENGTH, LOG_BUFFER_SIZE);
+    char line[LOG_BUFFER_SIZE] = "RPM:3000, TPS:21.0, ECT:90, IAT:35, VSS:60, MAP:1000, BATT:13.80\n";
+    results.push_back(measure("logQueue_roundtrip", options, [&](uint64_t) {
+      char out[LOG_BUFFER_SIZE];
+      xQueueSend(queue, line, 0);
+      xQueueReceive(queue, out, 0);
+      keep(out);
+    }));
+    vQueueDelete(queue);
+  }
+  {
+    // One Honda frame every 100 ms resampled onto a 50 ms grid
+    ChannelAligner aligner;
+    aligner.setGrid(50000, 200000);
+    uint64_t timeUs = 0;  // Keeps rising across runs, i starts over
+    add("channelAligner_linear", [&](uint64_t i) {
+      HondaLiveData data;
+      parseHondaTable17(frames[i % FRAMES] + 4, data);
+      LiveSample sample = {};
+      sample.timeUs = timeUs += 100000;
+      hondaToSample(data, sample);
+      aligner.push(sample);
+      LiveSample out;
+      while (aligner.next(out)) keep(out);
+    });
+  }
+  {
+    // Trip plus two rolling windows, every Honda channel, a threshold on two of them
+    static ChannelStats stats;
+    stats.addWindow(60);
+    stats.addWindow(600);
+    stats.setThreshold(CH_COOLANT_TEMP, 100);
+    stats.setThreshold(CH_ENGINE_SPEED, 4000);
+    uint64_t timeUs = 0;
+    add("channelStats_push", [&](uint64_t i) {
+      HondaLiveData data;
+      parseHondaTable17(frames[i % FRAMES] + 4, data);
+      LiveSample sample = {};
+      sample.timeUs = timeUs += 100000;
+      hondaToSample(data, sample);
+      stats.push(sample);
+    });
+    add("channelStats_summary", [&](uint64_t i) {
+      char line[LOG_BUFFER_SIZE];
+      keep(stats.formatSummary(i % CHANNEL_COUNT, 0, line, sizeof(line)));
+    });
+  }
+  {
+    // readData()'s part: claim a buffer, publish it, hand a view to two more holders
+    static FramePool pool;
+    add("framePool_publish_3views", [&](uint64_t) {
+      FrameBuffer *buffer = pool.acquire();
+      buffer->length = 24;
+      FrameView reader = FrameView::adopt(buffer);
+      FrameView logger = reader;
+      FrameView network = reader;
+      keep(logger.length() + network.length());
+    });
+  }
+  {
+    // Four clients' worth of queued commands, then the loop takes the most urgent one
+    static const char *const LINES[] = {"VIN", "DTC PENDING", "PID 01 0C", "CLEAR"};
+    static CommandQueue queue;
+    add("commandQueue_parse_push_pop4", [&](uint64_t i) {
+      KLineCommand command;
+      for (uint8_t c = 0; c < 4; c++) {
+        parseCommand(LINES[(i + c) % 4], (uint32_t)i, command);
+        command.client = c + 1;
+        queue.push(command);
+      }
+      while (queue.pop(command)) keep(command.kind);
+    });
+  }
+  {
+    // One physics step of the WLTP-like cycle, what the simulator pays every 10 ms
+    static DriveScenario scenario;
+    scenario.begin(TRACE_WLTP);
+    add("driveScenario_step", [&](uint64_t) {
+      scenario.step();
+      keep(scenario.state().rpm);
+    });
+  }
+  if (wanted(options, "sampleCodec")) {
+    // A sample of the drive into a block, a new block when it's full; and back out
+    static const std::vector<LiveSample> samples = driveSamples();
+    static uint8_t block[SAMPLE_BLOCK_MAX_SIZE];
+    static SampleEncoder encoder;
+    encoder.begin(block);
+    add("sampleCodec_encode", [&](uint64_t i) {
+      const LiveSample &sample = samples[i % samples.size()];
+      if (!encoder.add(sample)) {
+        encoder.begin(block);
+        encoder.add(sample);
+      }
+    });
+
+    static uint8_t full[SAMPLE_BLOCK_MAX_SIZE];
+    encoder.begin(full);
+    for (size_t i = 0; i < samples.size() && encoder.add(samples[i]); i++) {
+    }
+    static uint16_t length = encoder.finish();
+    static SampleDecoder decoder;
+    decoder.begin(full, length);
+    add("sampleCodec_decode", [&](uint64_t) {
+      LiveSample sample;
+      if (!decoder.next(sample)) {
+        decoder.begin(full, length);
+        decoder.next(sample);
+      }
+      keep(sample.value[CH_ENGINE_SPEED]);
+    });
+  }
+  add("formatSample", [&](uint64_t i) {
+    HondaLiveData data;
+    parseHondaTable17(frames[i % FRAMES] + 4, data);
+    LiveSample sample = {};
+    sample.timeUs = i;
+    hondaToSample(data, sample);
+    char line[LOG_BUFFER_SIZE];
+    keep(formatSample(sample, line, sizeof(line)));
+  });
+
+  // Wifi_K::broadcast() of one log line to every client slot over local TCP
+  if (wanted(options, "broadcast")) {
+    Wifi_K wifi;
+    wifi.begin();
+    BroadcastSink sink;
+    if (!sink.connect(3333, MAX_WIFI_CLIENTS)) {
+      fprintf(stderr, "  broadcast: can't connect to port 3333, skipped\n");
+      return;
+    }
+    for (int i = 0; i < 100; i++) {  // One accept per handle(), like in the sketch loop
+      wifi.handle();
+      delay(1);
+    }
+
+    const char *line = "RPM:3000, TPS:21.0, ECT:90, IAT:35, VSS:60, MAP:1000, BATT:13.80\n";
+    char name[32];
+    snprintf(name, sizeof(name), "broadcast_%dclients", MAX_WIFI_CLIENTS);
+    results.push_back(measure(name, options, [&](uint64_t) { wifi.broadcast(line); }));
+  }
+
+  // UdpStream::send() of one Honda sample to a subscribed local client
+  if (wanted(options, "udpStream")) {
+    UdpStream stream;
+    stream.begin();
+    UdpSink sink;
+    if (!sink.subscribe(UDP_STREAM_PORT)) {
+      fprintf(stderr, "  udpStream: can't reach port %u, skipped\n", UDP_STREAM_PORT);
+      return;
+    }
+    for (int i = 0; i < 100 && stream.clientCount() == 0; i++) {
+      stream.handle();
+      delay(1);
+    }
+
+    HondaLiveData data;
+    parseHondaTable17(frames[0] + 4, data);
+    LiveSample sample = {};
+    hondaToSample(data, sample);
+    results.push_back(measure("udpStream_send_1client", options, [&](uint64_t i) {
+      sample.timeUs = i;
+      stream.send(sample);
+    }));
+    stream.setCompression(1000);
+    results.push_back(measure("udpStream_send_compressed", options, [&](uint64_t i) {
+      sample.timeUs = i * 125000;
+      stream.send(sample);
+    }));
+    stream.setCompression(0);
+    delay(200);  // Let the sink drain its socket
+    fprintf(stderr, "  %-28s sent %u, received %u, lost %u\n", "", stream.sequence(), sink.loss.received(),
+            sink.loss.lost());
+  }
+}
+
+// ----------------------------------- Loopback -----------------------------------
+
+// ECU end of the pty. The K-Line is one wire, so everything the reader sends
+// comes straight back to it (echo); ECU answers leave at the bus baud rate.
+class KLineBus : public Stream {
+ public:
+  KLineBus(int fd, unsigned baud) : _fd(fd), _byteUs(baud ? 10000000u / baud : 0) {}
+
+  int available() override {
+    pump();
+    return _rx.size();
+  }
+  int read() override {
+    pump();
+    if (_rx.empty()) return -1;
+    uint8_t b = _rx.front();
+    _rx.pop_front();
+    return b;
+  }
+  size_t write(uint8_t b) override { return write(&b, 1); }
+  size_t write(const uint8_t *buffer, size_t size) override {
+    for (size_t i = 0; i < size; i++) {
+      if (::write(_fd, buffer + i, 1) != 1) return i;
+      if (_byteUs) delayMicroseconds(_byteUs);  // 10 bits per byte on the wire
+    }
+    return size;
+  }
+  using Print::write;
+
+ private:
+  int _fd;
+  unsigned _byteUs;
+  std::deque<uint8_t> _rx;
+
+  void pump() {
+    uint8_t buffer[64];
+    ssize_t n;
+    while ((n = ::read(_fd, buffer, sizeof(buffer))) > 0) {
+      if (::write(_fd, buffer, n) != n) break;  // Echo
+      _rx.insert(_rx.end(), buffer, buffer + n);
+    }
+  }
+};
+
+static bool setRaw(int fd) {
+  termios settings;
+  if (tcgetattr(fd, &settings) < 0) return false;
+  cfmakeraw(&settings);
+  return tcsetattr(fd, TCSANOW, &settings) == 0;
+}
+
+static const EcuState ECU_STATE = {3000, 21, 20, 35.0f, 90.0f, 1000, 13.8f, 60};
+
+// The K-Line is one wire: the simulator's sense pin is the reader's TX pin
+static const uint8_t READER_TX_PIN = 17;
+static EdgeRing kEdges;
+
+static void onKLineEdge() {
+  kEdges.push(micros(), digitalRead(READER_TX_PIN));
+}
+
+// The simulator sketch's ECU_COMM() in a thread on the ECU end of a pty
+class SimulatedEcu {
+ public:
+  // With a scenario the ECU answers with its values, stepped to the real
+  // time since start times options.speedup
+  SimulatedEcu(int fd, const Options &options, DriveScenario *scenario = nullptr) {
+    Edge edge;
+    while (kEdges.pop(edge)) {
+    }
+    attachInterrupt(digitalPinToInterrupt(READER_TX_PIN), onKLineEdge, CHANGE);
+    _thread = std::thread([this, fd, &options, scenario] { run(fd, options, scenario); });
+  }
+  ~SimulatedEcu() {
+    _running = false;
+    _thread.join();
+    detachInterrupt(digitalPinToInterrupt(READER_TX_PIN));
+  }
+
+  uint64_t startUs() const { return _startUs; }  // Scenario time 0
+
+  // Runs change on the ECU thread before its next poll
+  void configure(std::function<void(EcuResponder &)> change) {
+    std::lock_guard<std::mutex> guard(_lock);
+    _changes.push_back(std::move(change));
+  }
+
+ private:
+  std::atomic<bool> _running{true};
+  std::atomic<uint64_t> _startUs{0};
+  std::thread _thread;
+  std::mutex _lock;
+  std::vector<std::function<void(EcuResponder &)>> _changes;
+
+  void run(int fd, const Options &options, DriveScenario *scenario) {
+    KLineBus bus(fd, options.baud);
+    uint64_t startUs = micros();
+    _startUs = startUs;
+    EcuResponder ecu(bus);
+    WakeDecoder decoder;
+    ecu.setInterByteTimeout(options.interByteTimeout);
+    ecu.setResponseDelay(options.responseDelay);
+    while (_running) {
+      WakeEvent event;
+      Edge edge;
+      bool woke = false;
+      while (kEdges.pop(edge)) woke |= decoder.edge(edge.timeUs, edge.level, event);
+      woke = woke || decoder.poll(micros(), event);
+      if (woke) ecu.onWake(event, millis() - (long)(micros() - event.endUs) / 1000);
+      {
+        std::lock_guard<std::mutex> guard(_lock);
+        for (auto &change : _changes) change(ecu);
+        _changes.clear();
+      }
+      if (scenario) {
+        scenario->advanceTo((uint32_t)((micros() - startUs) / 1000.0 * options.speedup));
+        ecu.poll(scenario->state(), millis());
+      } else {
+        ecu.poll(ECU_STATE, millis());
+      }
+      delayMicroseconds(100);
+    }
+  }
+};
+
+static bool openBus(int &master, int &slave) {
+  if (openpty(&master, &slave, nullptr, nullptr, nullptr) < 0 || !setRaw(slave)) {
+    perror("openpty");
+    return false;
+  }
+  fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+  Serial1.attach(slave);
+  return true;
+}
+
+// Closes the pty when the bench is done (declared before the ECU so it outlives its thread)
+struct Bus {
+  int master, slave;
+  Bus(int m, int s) : master(m), slave(s) {}
+  ~Bus() {
+    Serial1.attach(-1);
+    close(slave);
+    close(master);
+  }
+};
+
+static void setupReader(OBD2_KLine &kline, const Options &options, KLineProtocol protocol) {
+  kline.setProtocol(protocol);
+  kline.setByteWriteInterval(options.byteWriteInterval);
+  kline.setInterByteTimeout(options.interByteTimeout);
+  kline.setReadTimeout(1000);
+}
+
+// A built-in trace by name or a keyframe script
+static void beginScenario(const char *cycle, DriveScenario &scenario) {
+  static DriveKeyframe keyframes[SCENARIO_MAX_KEYFRAMES];
+  const DriveTrace *trace = traceByName(cycle);
+  if (trace) scenario.begin(*trace);
+  else scenario.begin(keyframes, parseKeyframes(cycle, keyframes, SCENARIO_MAX_KEYFRAMES));
+}
+
+static LoopbackResult runLoopback(const Options &options) {
+  LoopbackResult result;
+  int master, slave;
+  if (!openBus(master, slave)) return result;
+  result.ran = true;
+  Bus bus(master, slave);
+
+  const EcuState &state = ECU_STATE;
+  DriveScenario scenario;
+  if (options.scenario) beginScenario(options.scenario, scenario);
+  SimulatedEcu ecu(master, options, options.scenario ? &scenario : nullptr);
+  OBD2_KLine kline(Serial1, 10400, 16, READER_TX_PIN);
+  setupReader(kline, options, PROTOCOL_ISO14230_HONDA);
+
+  result.connected = kline.initOBD2();
+  if (result.connected) {
+    double start = nowNs();
+    for (unsigned i = 0; i < options.requests; i++) {
+      HondaLiveData data;
+      uint64_t requestUs = klineTimeUs();
+      double requestStart = nowNs();
+      bool ok = kline.getHondaLiveData(0x17, data);
+      if (!ok) continue;
+
+      result.latencyMs.push_back((nowNs() - requestStart) / 1e6);
+      result.ok++;
+      bool timed = data.timeUs > requestUs && data.timeUs <= klineTimeUs();
+      if (options.scenario) {
+        // Values move while the ECU answers: only the range is checked
+        int rpm = lroundf(data.engineSpeed_rpm);
+        if (result.ok == 1 || rpm < result.rpmMin) result.rpmMin = rpm;
+        if (rpm > result.rpmMax) result.rpmMax = rpm;
+        if (data.vehicleSpeed_kmh > result.speedMax) result.speedMax = data.vehicleSpeed_kmh;
+        if (!timed || rpm < 600 || rpm > 7000 || data.vehicleSpeed_kmh > 200 || data.ect_celsius < 0 ||
+            data.ect_celsius > 120) {
+          result.mismatches++;
+        }
+      } else if (lroundf(data.engineSpeed_rpm) != state.rpm || data.ect_celsius != (int)state.ect ||
+                 data.vehicleSpeed_kmh != state.speed || !timed) {
+        result.mismatches++;
+      }
+    }
+    result.seconds = (nowNs() - start) / 1e9;
+    result.requests = options.requests;
+    result.scenarioMs = (uint32_t)(result.seconds * 1000 * options.speedup);
+  }
+  return result;
+}
+
+// Times initOBD2() down one init path, each run with a fresh reader, and
+// checks the first reading after it
+static InitResult runInit(const Options &options, const std::string &path) {
+  InitResult result;
+  result.path = path;
+  result.protocol = path == "honda" ? PROTOCOL_ISO14230_HONDA : path == "fast" ? PROTOCOL_ISO14230_FAST : PROTOCOL_ISO14230_SLOW;
+  int master, slave;
+  if (!openBus(master, slave)) return result;
+  Bus bus(master, slave);
+
+  SimulatedEcu ecu(master, options);
+  for (unsigned run = 0; run < options.initRuns; run++) {
+    OBD2_KLine kline(Serial1, 10400, 16, READER_TX_PIN);
+    setupReader(kline, options, result.protocol);
+    result.runs++;
+
+    double start = nowNs();
+    if (!kline.initOBD2()) continue;
+    result.ms.push_back((nowNs() - start) / 1e6);
+    result.ok++;
+
+    bool match;
+    if (path == "honda") {
+      HondaLiveData data;
+      match = kline.getHondaLiveData(0x17, data) && lroundf(data.engineSpeed_rpm) == ECU_STATE.rpm;
+    } else {
+#if KLINE_SUPPORTED_PIDS
+      match = kline.readSupportedLiveData() > 0 && lroundf(kline.getLiveData(0x0C)) == ECU_STATE.rpm;
+#else
+      match = lroundf(kline.getLiveData(0x0C)) == ECU_STATE.rpm;
+#endif
+    }
+    if (!match) result.mismatches++;
+  }
+
+  return result;
+}
+
+// Same values two ways after a fast init: block 21 01 (9 values per answer)
+// and the mode 01 PIDs the simulator answers, one value per answer
+static BlockResult runBlocks(const Options &options) {
+  BlockResult result;
+  int master, slave;
+  if (!openBus(master, slave)) return result;
+  Bus bus(master, slave);
+
+  SimulatedEcu ecu(master, options);
+  OBD2_KLine kline(Serial1, 10400, 16, READER_TX_PIN);
+  setupReader(kline, options, PROTOCOL_ISO14230_FAST);
+  result.connected = kline.initOBD2();
+  if (!result.connected) return result;
+  setLocalIdLayout(0x01, SIMULATOR_BLOCK_01, 9);
+
+  double start = nowNs();
+  for (unsigned i = 0; i < options.blockReads; i++) {
+    LiveSample sample = {};
+    result.blockReads++;
+    if (!kline.readLocalIdentifier(0x01, sample)) continue;
+    result.blockOk++;
+    result.blockValues += __builtin_popcount(sample.validMask);
+    if (lroundf(sample.value[CH_ENGINE_SPEED]) != ECU_STATE.rpm ||
+        lroundf(sample.value[CH_COOLANT_TEMP]) != lroundf(ECU_STATE.ect)) {
+      result.mismatches++;
+    }
+  }
+  result.blockSeconds = (nowNs() - start) / 1e9;
+
+  static const uint8_t PIDS[] = {0x05, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x11};
+  start = nowNs();
+  for (unsigned i = 0; i < options.blockReads; i++) {
+    result.pidReads++;
+    if (kline.getLiveData(PIDS[i % sizeof(PIDS)]) >= 0) result.pidOk++;
+  }
+  result.pidSeconds = (nowNs() - start) / 1e9;
+  return result;
+}
+
+// Supported-PID bitmaps: the 0x20 / 0x40 range chaining of setRange(), the
+// simulator's mode 01 set read after a fast init, save / load including
+// blobs that must be refused, and getPID() skipping a PID the ECU lacks
+// without a request on the bus
+static CheckResult checkSupportedPids(const Options &options) {
+  CheckResult result;
+  result.name = "supported pids";
+
+  SupportedPids pids;
+  const uint8_t FIRST[] = {0x80, 0x00, 0x00, 0x01}, SECOND[] = {0x00, 0x00, 0x00, 0x01},
+                ALL[] = {0xFF, 0xFF, 0xFF, 0xFF}, NONE[] = {0x00, 0x00, 0x00, 0x00};
+  pids.setRange(0x01, 0x00, FIRST);
+  pids.setRange(0x01, 0x20, SECOND);
+  pids.setRange(0x01, 0x40, ALL);
+  expect(result, pids.count(0x01) == 35 && pids.pidAt(0x01, 0) == 0x01 && pids.pidAt(0x01, 1) == 0x20 &&
+                     pids.pidAt(0x01, 2) == 0x40 && pids.pidAt(0x01, 34) == 0x60 && pids.pidAt(0x01, 35) == 0,
+         "chained ranges: %u PIDs", pids.count(0x01));
+  pids.setRange(0x01, 0x20, NONE);
+  expect(result, pids.count(0x01) == 34 && pids.isSupported(0x01, 0x20) && !pids.isSupported(0x01, 0x40) &&
+                     pids.isSupported(0x01, 0x41),
+         "range 0x20 rewritten: %u PIDs", pids.count(0x01));
+  pids.setRange(0x01, 0xE0, ALL);
+  expect(result, pids.count(0x01) == 65 && pids.isSupported(0x01, 0xFF) && !pids.isSupported(0x01, 0x00),
+         "range 0xE0: %u PIDs, PID 00 %s", pids.count(0x01), pids.isSupported(0x01, 0x00) ? "set" : "clear");
+  expect(result, pids.mayRequest(0x01, 0x02) && !pids.isKnown(0x01), "unknown mode refused a PID");
+
+  int master, slave;
+  if (!expect(result, openBus(master, slave), "no pty for the bus")) return result;
+  Bus bus(master, slave);
+  SimulatedEcu ecu(master, options);
+  OBD2_KLine kline(Serial1, 10400, 16, READER_TX_PIN);
+  setupReader(kline, options, PROTOCOL_ISO14230_FAST);
+  if (!expect(result, kline.initOBD2(), "fast init failed")) {
+    reportCheck(result);
+    return result;
+  }
+
+  // Before the bitmap is read an unsupported PID still goes out and times out
+  expect(result, kline.getPID(0x01, 0x10) == -1, "PID 10 answered before the bitmap was read");
+
+  static const uint8_t SIMULATOR_PIDS[] = {0x05, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x11};
+  uint8_t count = kline.readSupportedLiveData();
+  bool listOk = count == sizeof(SIMULATOR_PIDS) && kline.getSupportedCount(0x01) == count;
+  for (uint8_t i = 0; listOk && i < count; i++) listOk = kline.getSupportedData(0x01, i) == SIMULATOR_PIDS[i];
+  expect(result, listOk, "mode 01: %u supported PIDs", count);
+
+  double start = nowNs();
+  float skipped = kline.getPID(0x01, 0x10);
+  double skippedMs = (nowNs() - start) / 1e6;
+  expect(result, skipped == -3 && skippedMs < 1, "unsupported PID: %.0f after %.1f ms",
+         skipped, skippedMs);
+  expect(result, kline.getPID(0x01, 0x0C) >= 0, "PID 0C not read after the bitmap");
+
+  // Round trip through a blank set, then blobs that must leave the set alone
+  uint8_t saved[SupportedPids::STORAGE_SIZE], blank[SupportedPids::STORAGE_SIZE];
+  expect(result, kline.saveSupportedData(saved, sizeof(saved) - 1) == 0, "saved into a short buffer");
+  expect(result, kline.saveSupportedData(saved, sizeof(saved)) == sizeof(saved), "save failed");
+  SupportedPids().save(blank, sizeof(blank));
+  expect(result, kline.loadSupportedData(blank, sizeof(blank)) && kline.getSupportedCount(0x01) == 0,
+         "blank set not loaded");
+  expect(result, kline.loadSupportedData(saved, sizeof(saved)), "saved set not loaded");
+  bool sameSet = kline.getSupportedCount(0x01) == count;
+  for (uint16_t pid = 0; sameSet && pid <= 0xFF; pid++) {
+    sameSet = kline.isSupported(0x01, pid) == (memchr(SIMULATOR_PIDS, pid, sizeof(SIMULATOR_PIDS)) != nullptr);
+  }
+  expect(result, sameSet && kline.getPID(0x01, 0x10) == -3, "loaded set differs from the one read");
+
+  uint8_t corrupt[SupportedPids::STORAGE_SIZE];
+  expect(result, !kline.loadSupportedData(blank, sizeof(blank) - 1), "truncated blob loaded");
+  memcpy(corrupt, blank, sizeof(corrupt));
+  corrupt[0]++;
+  expect(result, !kline.loadSupportedData(corrupt, sizeof(corrupt)), "blob of another version loaded");
+  memcpy(corrupt, blank, sizeof(corrupt));
+  corrupt[1] = 0x80;
+  expect(result, !kline.loadSupportedData(corrupt, sizeof(corrupt)), "blob with an unknown mode loaded");
+  expect(result, kline.getSupportedCount(0x01) == count, "refused blob changed the set: %u PIDs",
+         kline.getSupportedCount(0x01));
+
+  reportCheck(result);
+  return result;
+}
+
+static void setEcuDTCs(SimulatedEcu &ecu, uint8_t mode, std::vector<uint16_t> first, std::vector<uint16_t> second) {
+  ecu.configure([=](EcuResponder &responder) {
+    responder.setDTCs(mode, 0, first.data(), first.size());
+    responder.setDTCs(mode, 1, second.data(), second.size());
+  });
+}
+
+// Events of a number of DTC requests, as "+03 0171" / "-07 0420"; poll()
+// waits for bus-time credit in between
+static std::vector<std::string> pollDTCs(DTCMonitor &monitor, std::vector<std::string> &events, int requests) {
+  events.clear();
+  for (int done = 0; done < requests;) {
+    if (monitor.poll()) done++;
+    else delay(1);
+  }
+  return events;
+}
+
+static void onCheckDTC(const DTCEvent &event, void *context) {
+  char text[12];
+  snprintf(text, sizeof(text), "%c%02X %04X", event.appeared ? '+' : '-', event.mode, event.code);
+  static_cast<std::vector<std::string> *>(context)->push_back(text);
+}
+
+static std::string joinEvents(const std::vector<std::string> &events) {
+  std::string text;
+  for (const std::string &event : events) text += (text.empty() ? "" : ", ") + event;
+  return text.empty() ? "none" : text;
+}
+
+static bool expectEvents(CheckResult &result, const char *what, const std::vector<std::string> &events,
+                         const std::vector<std::string> &expected) {
+  return expect(result, events == expected, "%s: %s, expected %s", what, joinEvents(events).c_str(),
+                joinEvents(expected).c_str());
+}
+
+// DTCMonitor against the simulator after a fast init, two ECUs answering:
+// codes appearing and clearing, the same code from both ECUs, a 7F refusal,
+// an answer over MAX_DTCS codes, stored / pending taking turns, and the
+// share of bus time the monitor keeps to
+static CheckResult checkDtcMonitor(const Options &options) {
+  CheckResult result;
+  result.name = "dtc monitor";
+  int master, slave;
+  if (!expect(result, openBus(master, slave), "no pty for the bus")) return result;
+  Bus bus(master, slave);
+
+  SimulatedEcu ecu(master, options);
+  OBD2_KLine kline(Serial1, 10400, 16, READER_TX_PIN);
+  setupReader(kline, options, PROTOCOL_ISO14230_FAST);
+  if (!expect(result, kline.initOBD2(), "fast init failed")) {
+    reportCheck(result);
+    return result;
+  }
+
+  std::vector<std::string> events;
+  DTCMonitor monitor(kline);
+  monitor.setMinInterval(0);
+  monitor.setBusShare(100);
+  monitor.subscribe(onCheckDTC, &events);
+
+  // One poll reads stored codes, the next pending ones
+  setEcuDTCs(ecu, 0x03, {0x0300, 0x0171}, {0x0300});
+  setEcuDTCs(ecu, 0x07, {}, {0x0420});
+  expectEvents(result, "first reads", pollDTCs(monitor, events, 2), {"+03 0171", "+03 0300", "+07 0420"});
+  expect(result, monitor.count(0x03) == 2 && monitor.code(0x03, 0) == 0x0171 && monitor.code(0x03, 1) == 0x0300,
+         "stored set: %u codes", monitor.count(0x03));
+  expectEvents(result, "nothing changed", pollDTCs(monitor, events, 2), {});
+
+  ecu.configure([](EcuResponder &responder) { responder.setDTCRefusal(true); });
+  expectEvents(result, "7F refusal", pollDTCs(monitor, events, 2), {});
+  expect(result, monitor.count(0x03) == 2 && monitor.count(0x07) == 1, "refusal changed the sets: %u / %u codes",
+         monitor.count(0x03), monitor.count(0x07));
+  ecu.configure([](EcuResponder &responder) { responder.setDTCRefusal(false); });
+
+  setEcuDTCs(ecu, 0x03, {0x0113}, {0x0300});  // 0300 now from the second ECU only
+  expectEvents(result, "one replaced", pollDTCs(monitor, events, 2), {"+03 0113", "-03 0171"});
+
+  // 36 codes: the answer is cut at MAX_DTCS, the codes past the cut aren't cleared
+  std::vector<uint16_t> first, second;
+  for (uint16_t i = 0; i < ECU_MAX_DTCS; i++) {
+    first.push_back(0x0100 + i);
+    second.push_back(0x0200 + i);
+  }
+  setEcuDTCs(ecu, 0x03, first, second);
+  pollDTCs(monitor, events, 2);
+  size_t cleared = std::count_if(events.begin(), events.end(), [](const std::string &e) { return e[0] == '-'; });
+  expect(result, cleared == 0 && monitor.count(0x03) == DTCMonitor::MAX_DTCS,
+         "answer over MAX_DTCS: %zu cleared, %u codes kept", cleared, monitor.count(0x03));
+  setEcuDTCs(ecu, 0x03, {0x0113}, {0x0300});
+  pollDTCs(monitor, events, 2);
+
+  expect(result, kline.clearDTCs(), "clearDTCs() failed");
+  expectEvents(result, "after mode 04", pollDTCs(monitor, events, 2), {"-03 0113", "-03 0300", "-07 0420"});
+
+  // Bus share: the time poll() spends on requests over the time it was called for
+  const uint8_t SHARE = 25;
+  monitor.setBusShare(SHARE);
+  pollDTCs(monitor, events, 1);  // The first request's cost measured
+  double start = nowNs(), busyNs = 0;
+  unsigned requests = 0;
+  while (nowNs() - start < 4e9) {
+    double before = nowNs();
+    if (monitor.poll()) {
+      busyNs += nowNs() - before;
+      requests++;
+    }
+    delay(5);
+  }
+  double share = busyNs / (nowNs() - start) * 100;
+  expect(result, requests > 0 && share > SHARE * 0.6 && share < SHARE * 1.2, "bus share %.1f %% with %u requests, set %u %%",
+         share, requests, SHARE);
+
+  reportCheck(result);
+  return result;
+}
+
+// Mode 01 PIDs the simulator answers, with the error each channel may have
+static const struct {
+  uint8_t pid;
+  float tolerance;
+} ADAPTIVE_PIDS[] = {{0x0C, 50}, {0x0D, 1}, {0x11, 2}, {0x0B, 20}, {0x0E, 1}, {0x05, 1}, {0x0F, 1}};
+
+static const char *const ADAPTIVE_CYCLE = "city";
+static const double ADAPTIVE_SPEEDUP = 3;  // Without -s: the first minute of the city cycle in 20 s
+
+static float stateChannel(const EcuState &state, uint8_t channel) {
+  switch (channel) {
+    case CH_ENGINE_SPEED: return state.rpm;
+    case CH_VEHICLE_SPEED: return state.speed;
+    case CH_THROTTLE: return state.tps;
+    case CH_MAP: return state.mbar;
+    case CH_IGNITION: return state.ignitionDeg;
+    case CH_COOLANT_TEMP: return state.ect;
+    case CH_INTAKE_TEMP: return state.iat;
+    default: return 0;
+  }
+}
+
+// One schedule against a fresh ECU starting the cycle from 0. The readings
+// are interpolated every 50 ms over the time all channels were read and
+// compared with the scenario's values when the ECU built the answer.
+static bool runSchedule(const Options &options, bool adaptive, AdaptiveResult &result) {
+  int master, slave;
+  if (!openBus(master, slave)) return false;
+  Bus bus(master, slave);
+
+  const char *cycle = options.scenario ? options.scenario : ADAPTIVE_CYCLE;
+  double speedup = options.scenario ? options.speedup : ADAPTIVE_SPEEDUP;
+  Options ecuOptions = options;
+  ecuOptions.speedup = speedup;
+  DriveScenario scenario;
+  beginScenario(cycle, scenario);
+  SimulatedEcu ecu(master, ecuOptions, &scenario);
+  OBD2_KLine kline(Serial1, 10400, 16, READER_TX_PIN);
+  setupReader(kline, options, PROTOCOL_ISO14230_FAST);
+  if (!kline.initOBD2()) return false;
+
+  AdaptivePoller poller(kline);
+  for (const auto &p : ADAPTIVE_PIDS) poller.addPid(p.pid, p.tolerance);
+  poller.setAdaptive(adaptive);
+
+  std::vector<std::pair<uint64_t, float>> readings[CHANNEL_COUNT];
+  double start = nowNs();
+  while (nowNs() - start < options.adaptiveSeconds * 1e9) {
+    LiveSample sample = {};
+    if (!poller.poll(sample)) {
+      delay(1);
+      continue;
+    }
+    uint8_t channel = __builtin_ctz(sample.validMask);
+    readings[channel].push_back({sample.timeUs, sample.value[channel]});
+  }
+  result.requests[adaptive] = poller.requests();
+  result.seconds[adaptive] = (nowNs() - start) / 1e9;
+
+  uint64_t fromUs = 0, toUs = UINT64_MAX;
+  for (const auto &p : ADAPTIVE_PIDS) {
+    const auto &r = readings[channelForPid(p.pid)];
+    if (r.size() < 2) return false;
+    fromUs = std::max(fromUs, r.front().first);
+    toUs = std::min(toUs, r.back().first);
+  }
+
+  double total = 0;
+  for (const auto &p : ADAPTIVE_PIDS) {
+    uint8_t channel = channelForPid(p.pid);
+    const auto &r = readings[channel];
+    DriveScenario truth;
+    beginScenario(cycle, truth);
+    double sum = 0;
+    unsigned count = 0;
+    size_t j = 0;
+    for (uint64_t t = fromUs; t <= toUs; t += 50000) {
+      while (j + 2 < r.size() && r[j + 1].first < t) j++;
+      double fraction = (double)(t - r[j].first) / (r[j + 1].first - r[j].first);
+      double value = r[j].second + (r[j + 1].second - r[j].second) * std::min(std::max(fraction, 0.0), 1.0);
+      uint64_t builtUs = t - options.responseDelay * 1000;  // The answer leaves P2 after the ECU read its values
+      truth.advanceTo((uint32_t)((builtUs - ecu.startUs()) / 1000.0 * speedup));
+      double error = value - stateChannel(truth.state(), channel);
+      sum += error * error;
+      count++;
+    }
+    total += count ? sqrt(sum / count) / p.tolerance : 0;
+  }
+  result.error[adaptive] = total / (sizeof(ADAPTIVE_PIDS) / sizeof(ADAPTIVE_PIDS[0]));
+  return true;
+}
+
+static AdaptiveResult runAdaptive(const Options &options) {
+  AdaptiveResult result;
+  result.connected = runSchedule(options, false, result) && runSchedule(options, true, result);
+  return result;
+}
+
+static double percentile(std::vector<double> sorted, double p) {
+  if (sorted.empty()) return 0;
+  std::sort(sorted.begin(), sorted.end());
+  size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+  return sorted[rank ? rank - 1 : 0];
+}
+
+// ----------------------------------- Output -----------------------------------
+
+static void writeJson(FILE *out, const Options &options, const VerifyResult &verify, const CodecResult &codec,
+                      const std::vector<CheckResult> &checks,
+                      const std::vector<BenchResult> &benchmarks, const LoopbackResult &loopback,
+                      const std::vector<InitResult> &inits, const BlockResult &blocks,
+                      const AdaptiveResult &adaptive) {
+  fprintf(out, "{\n  \"bulk_decode_check\": {\"kernels\": [");
+  for (size_t i = 0; i < verify.kernels.size(); i++) fprintf(out, "%s\"%s\"", i ? ", " : "", verify.kernels[i].c_str());
+  fprintf(out, "], \"values\": %llu, \"mismatches\": %llu},\n", (unsigned long long)verify.values,
+          (unsigned long long)verify.mismatches);
+  fprintf(out,
+          "  \"sample_codec\": {\"samples\": %llu, \"blocks\": %llu, \"mismatches\": %llu, "
+          "\"bytes_per_sample\": {\"text\": %.2f, \"datagram\": %.2f, \"block\": %.2f}},\n",
+          (unsigned long long)codec.samples, (unsigned long long)codec.blocks, (unsigned long long)codec.mismatches,
+          codec.samples ? (double)codec.textBytes / codec.samples : 0.0,
+          codec.samples ? (double)codec.packetBytes / codec.samples : 0.0,
+          codec.samples ? (double)codec.blockBytes / codec.samples : 0.0);
+
+  fprintf(out, "  \"checks\": [");
+  for (size_t i = 0; i < checks.size(); i++) {
+    fprintf(out, "%s\n    {\"name\": \"%s\", \"checks\": %u, \"failures\": [", i ? "," : "", checks[i].name.c_str(),
+            checks[i].checks);
+    for (size_t f = 0; f < checks[i].failures.size(); f++) {
+      fprintf(out, "%s\"%s\"", f ? ", " : "", checks[i].failures[f].c_str());
+    }
+    fprintf(out, "]}");
+  }
+  fprintf(out, "%s],\n", checks.empty() ? "" : "\n  ");
+
+  fprintf(out, "  \"microbenchmarks\": [");
+  for (size_t i = 0; i < benchmarks.size(); i++) {
+    const BenchResult &b = benchmarks[i];
+    fprintf(out, "%s\n    {\"name\": \"%s\", \"ns_per_op\": %.3f, \"ns_per_op_median\": %.3f, \"ops\": %llu}",
+            i ? "," : "", b.name.c_str(), b.nsPerOp, b.nsPerOpMed, (unsigned long long)b.ops);
+  }
+  fprintf(out, "%s]", benchmarks.empty() ? "" : "\n  ");
+
+  if (loopback.ran) {
+    const std::vector<double> &lat = loopback.latencyMs;
+    fprintf(out,
+            ",\n  \"loopback\": {\n"
+            "    \"protocol\": \"ISO14230_Honda\", \"baud\": %u, \"byte_write_interval_ms\": %u,\n"
+            "    \"inter_byte_timeout_ms\": %u, \"response_delay_ms\": %u,\n"
+            "    \"connected\": %s, \"requests\": %u, \"ok\": %u, \"mismatches\": %u,\n"
+            "    \"samples_per_s\": %.3f,\n"
+            "    \"latency_ms\": {\"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f}",
+            options.baud, options.byteWriteInterval, options.interByteTimeout, options.responseDelay,
+            loopback.connected ? "true" : "false", loopback.requests, loopback.ok, loopback.mismatches,
+            loopback.seconds > 0 ? loopback.ok / loopback.seconds : 0.0, percentile(lat, 50), percentile(lat, 90),
+            percentile(lat, 99), percentile(lat, 100));
+    if (options.scenario) {
+      fprintf(out,
+              ",\n    \"scenario\": {\"name\": \"%s\", \"speedup\": %.1f, \"scenario_s\": %.1f, "
+              "\"rpm\": {\"min\": %d, \"max\": %d}, \"speed_max_kmh\": %d}",
+              traceByName(options.scenario) ? options.scenario : "script", options.speedup,
+              loopback.scenarioMs / 1000.0, loopback.rpmMin, loopback.rpmMax, loopback.speedMax);
+    }
+    fprintf(out, "\n  }");
+  }
+
+  if (!inits.empty()) {
+    fprintf(out, ",\n  \"init\": [");
+    for (size_t i = 0; i < inits.size(); i++) {
+      const InitResult &r = inits[i];
+      fprintf(out,
+              "%s\n    {\"path\": \"%s\", \"protocol\": \"%s\", \"runs\": %u, \"ok\": %u, \"mismatches\": %u, "
+              "\"ms\": {\"min\": %.3f, \"p50\": %.3f, \"max\": %.3f}}",
+              i ? "," : "", r.path.c_str(), protocolName(r.protocol), r.runs, r.ok, r.mismatches, percentile(r.ms, 0),
+              percentile(r.ms, 50), percentile(r.ms, 100));
+    }
+    fprintf(out, "\n  ]");
+  }
+
+  if (options.blockReads > 0) {
+    fprintf(out,
+            ",\n  \"blocks\": {\"connected\": %s, \"block_reads\": %u, \"block_ok\": %u, \"pid_reads\": %u, "
+            "\"pid_ok\": %u, \"mismatches\": %u,\n"
+            "    \"block_values_per_s\": %.3f, \"pid_values_per_s\": %.3f}",
+            blocks.connected ? "true" : "false", blocks.blockReads, blocks.blockOk, blocks.pidReads, blocks.pidOk,
+            blocks.mismatches, blocks.blockSeconds > 0 ? blocks.blockValues / blocks.blockSeconds : 0.0,
+            blocks.pidSeconds > 0 ? blocks.pidOk / blocks.pidSeconds : 0.0);
+  }
+
+  if (options.adaptiveSeconds > 0) {
+    fprintf(out, ",\n  \"adaptive\": {\"connected\": %s, \"cycle\": \"%s\", \"pids\": %u",
+            adaptive.connected ? "true" : "false",
+            !options.scenario ? ADAPTIVE_CYCLE : traceByName(options.scenario) ? options.scenario : "script",
+            (unsigned)(sizeof(ADAPTIVE_PIDS) / sizeof(ADAPTIVE_PIDS[0])));
+    static const char *const NAMES[] = {"static", "adaptive"};
+    for (int mode = 0; mode < 2; mode++) {
+      fprintf(out, ",\n    \"%s\": {\"requests\": %u, \"reads_per_s\": %.3f, \"error_per_tolerance\": %.3f}",
+              NAMES[mode], adaptive.requests[mode],
+              adaptive.seconds[mode] > 0 ? adaptive.requests[mode] / adaptive.seconds[mode] : 0.0, adaptive.error[mode]);
+    }
+    fprintf(out, "}");
+  }
+  fprintf(out, "\n}\n");
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: klbench [options]\n"
+          "  -m <ms>      time per microbenchmark (default 200)\n"
+          "  -b <name>    only microbenchmarks whose name contains <name>\n"
+          "  -n <count>   loopback requests, 0 skips the loopback (default 50)\n"
+          "  -w <ms>      reader byte write interval (default 5)\n"
+          "  -t <ms>      inter-byte timeout of reader and ECU (default 60)\n"
+          "  -d <ms>      ECU answer delay, P2 (default 20)\n"
+          "  -r <baud>    K-Line baud rate of ECU answers, 0 = unthrottled (default 10400)\n"
+          "  -i <paths>   init paths to time: honda,fast,slow or \"\" for none (default all)\n"
+          "  -k <runs>    runs per init path (default 3)\n"
+          "  -l <count>   KWP2000 block reads and PID reads to compare, 0 skips it (default 10)\n"
+          "  -o <file>    JSON output file (default stdout)\n"
+          "  -s <cycle>   loopback ECU replays idle, city, highway, wltp or \"<s>:<km/h> ...\"\n"
+          "  -x <factor>  scenario speed against real time (default 1)\n"
+          "  -a <s>       seconds per schedule of the adaptive benchmark, 0 skips it (default 0)\n");
+}
+
+static bool parseOptions(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (arg[0] != '-' || !arg[1]) return false;
+
+    // Value either attached ("-n10") or in the next argument ("-n 10")
+    char flag = arg[1];
+    const char *value = arg[2] ? arg + 2 : (i + 1 < argc ? argv[++i] : nullptr);
+    if (!value) return false;
+
+    switch (flag) {
+      case 'm': options.minTimeMs = atoi(value); break;
+      case 'b': options.filter = value; break;
+      case 'n': options.requests = atoi(value); break;
+      case 'w': options.byteWriteInterval = atoi(value); break;
+      case 't': options.interByteTimeout = atoi(value); break;
+      case 'd': options.responseDelay = atoi(value); break;
+      case 'r': options.baud = atoi(value); break;
+      case 'i': options.initPaths = value; break;
+      case 'k': options.initRuns = atoi(value); break;
+      case 'l': options.blockReads = atoi(value); break;
+      case 'o': options.outPath = value; break;
+      case 's': options.scenario = value; break;
+      case 'x': options.speedup = atof(value); break;
+      case 'a': options.adaptiveSeconds = atoi(value); break;
+      default: return false;
+    }
+  }
+  if (options.scenario && !traceByName(options.scenario)) {
+    DriveKeyframe keyframes[SCENARIO_MAX_KEYFRAMES];
+    if (parseKeyframes(options.scenario, keyframes, SCENARIO_MAX_KEYFRAMES) < 2) return false;
+  }
+  return options.minTimeMs > 0 && options.speedup > 0;
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    usage();
+    return 2;
+  }
+
+  VerifyResult verify = verifyBulkDecode();
+  CodecResult codec = checkSampleCodec(driveSamples());
+  std::string tools = argv[0];
+  tools.erase(tools.find_last_of('/') + 1);  // klconvert is built next to klbench
+  std::vector<CheckResult> checks = {checkSplitter(), checkLogConvert(tools + "klconvert"),
+                                     checkCommandQueue(), checkChannelStats(),
+                                     checkFramePool(), checkCaptureBuffer(),
+                                     checkSupportedPids(options), checkDtcMonitor(options)};
+
+  std::vector<BenchResult> benchmarks;
+  fprintf(stderr, "microbenchmarks:\n");
+  runMicrobenchmarks(options, benchmarks);
+
+  std::vector<InitResult> inits;
+  for (const char *p = options.initPaths; *p;) {
+    const char *comma = strchr(p, ',');
+    std::string path = comma ? std::string(p, comma) : std::string(p);
+    p = comma ? comma + 1 : p + path.size();
+    if (path != "honda" && path != "fast" && path != "slow") continue;
+
+    fprintf(stderr, "init %s: %u runs\n", path.c_str(), options.initRuns);
+    inits.push_back(runInit(options, path));
+    const InitResult &r = inits.back();
+    fprintf(stderr, "  %u/%u ok, %u bad readings, p50 %.1f ms\n", r.ok, r.runs, r.mismatches, percentile(r.ms, 50));
+  }
+
+  BlockResult blocks;
+  if (options.blockReads > 0) {
+    fprintf(stderr, "blocks: %u reads of 21 01 and of mode 01 PIDs, ISO14230_Fast\n", options.blockReads);
+    blocks = runBlocks(options);
+    if (!blocks.connected) {
+      fprintf(stderr, "  init failed\n");
+    } else {
+      double blockRate = blocks.blockSeconds > 0 ? blocks.blockValues / blocks.blockSeconds : 0.0;
+      double pidRate = blocks.pidSeconds > 0 ? blocks.pidOk / blocks.pidSeconds : 0.0;
+      fprintf(stderr, "  block %u/%u ok, %.1f values/s; PID %u/%u ok, %.1f values/s (x%.1f)\n", blocks.blockOk,
+              blocks.blockReads, blockRate, blocks.pidOk, blocks.pidReads, pidRate, pidRate > 0 ? blockRate / pidRate : 0.0);
+    }
+  }
+
+  LoopbackResult loopback;
+  if (options.requests > 0) {
+    fprintf(stderr, "loopback: %u requests, ISO14230_Honda at %u baud\n", options.requests, options.baud);
+    loopback = runLoopback(options);
+    if (!loopback.connected) {
+      fprintf(stderr, "  init failed\n");
+    } else {
+      fprintf(stderr, "  %u/%u ok, %.2f samples/s, p50 %.1f ms, p99 %.1f ms\n", loopback.ok, loopback.requests,
+              loopback.seconds > 0 ? loopback.ok / loopback.seconds : 0.0, percentile(loopback.latencyMs, 50),
+              percentile(loopback.latencyMs, 99));
+      if (options.scenario) {
+        fprintf(stderr, "  scenario %s x%.1f, %.0f s: rpm %d..%d, up to %d km/h, %u out of range\n", options.scenario,
+                options.speedup, loopback.scenarioMs / 1000.0, loopback.rpmMin, loopback.rpmMax, loopback.speedMax,
+                loopback.mismatches);
+      }
+    }
+  }
+
+  AdaptiveResult adaptive = {};
+  if (options.adaptiveSeconds > 0) {
+    fprintf(stderr, "adaptive: %u PIDs, %u s fixed and %u s adaptive, ISO14230_Fast\n",
+            (unsigned)(sizeof(ADAPTIVE_PIDS) / sizeof(ADAPTIVE_PIDS[0])), options.adaptiveSeconds,
+            options.adaptiveSeconds);
+    adaptive = runAdaptive(options);
+    if (!adaptive.connected) {
+      fprintf(stderr, "  init failed\n");
+    } else {
+      for (int mode = 0; mode < 2; mode++) {
+        fprintf(stderr, "  %-8s %.1f reads/s, error %.2f x tolerance\n", mode ? "adaptive" : "fixed",
+                adaptive.seconds[mode] > 0 ? adaptive.requests[mode] / adaptive.seconds[mode] : 0.0,
+                adaptive.error[mode]);
+      }
+    }
+  }
+
+  FILE *out = options.outPath ? fopen(options.outPath, "w") : stdout;
+  if (!out) {
+    perror(options.outPath);
+    return 1;
+  }
+  writeJson(out, options, verify, codec, checks, benchmarks, loopback, inits, blocks, adaptive);
+  if (out != stdout) fclose(out);
+
+  if (verify.mismatches || codec.mismatches) return 1;
+  for (const CheckResult &c : checks) {
+    if (!c.failures.empty()) return 1;
+  }
+  for (const InitResult &r : inits) {
+    if (r.ok < r.runs || r.mismatches) return 1;
+  }
+  if (options.blockReads > 0 && (!blocks.connected || blocks.blockOk < blocks.blockReads || blocks.mismatches)) return 1;
+  if (options.adaptiveSeconds > 0 && !adaptive.connected) return 1;
+  return options.requests > 0 && (!loopback.connected || loopback.ok == 0) ? 1 : 0;
+}
@@ -0,0 +1,510 @@
+// klconvert - converts K-Line logs to CSV, JSON lines or a columnar file
+//
+// Input is either a .klog binary log (KLineLog.h), with raw frames or
+// compressed sample blocks (SampleCodec.h), or a raw K-Line byte capture.
+// The file is memory-mapped, cut into chunks and the chunks are decoded in
+// parallel with the same sources the ESP32 uses (KLineFrame, OBD2_Decode,
+// LiveChannels). Output keeps the order of the input.
+//
+// With -g a .klog comes out as one row per grid time instead of one per frame,
+// every channel resampled to that time by ChannelAligner.
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ChannelAligner.h"
+#include "KLineFrame.h"
+#include "KLineLog.h"
+#include "LiveChannels.h"
+#include "SampleCodec.h"
+
+enum InputKind { INPUT_KLOG, INPUT_RAW };
+enum OutputFormat { OUTPUT_CSV, OUTPUT_JSON, OUTPUT_COLUMNS };
+
+struct Options {
+  InputKind input = INPUT_KLOG;
+  bool inputGiven = false;
+  KLineFraming framing = FRAMING_KWP2000;
+  OutputFormat format = OUTPUT_CSV;
+  unsigned threads = 0;
+  size_t chunkSize = 8u << 20;
+  uint32_t gridUs = 0;  // 0 = a row per frame
+  AlignMode align = ALIGN_LINEAR;
+  const char *inPath = nullptr;
+  const char *outPath = nullptr;
+};
+
+// Bytes scanned before a chunk so the decoder is in sync when it reaches it
+static const size_t LEAD_IN = 4096;
+static const size_t RAW_WINDOW = 4096;
+// Aligned output needs every channel's last reading before the chunk, which
+// can be up to the aligner's max age (2 s) back
+static const size_t ALIGN_LEAD_IN = 256 * 1024;
+// Grid rows wait this long for the reading after them to interpolate towards
+static const uint32_t ALIGN_LATENCY_US = 500000;
+
+struct Row {
+  uint64_t offset;
+  uint8_t source;
+  LiveSample sample;  // sample.timeUs is the record time, 0 for raw captures
+};
+
+// Output of one chunk: text for CSV/JSON, columns for the columnar format
+struct ChunkResult {
+  std::string text;
+  std::vector<uint64_t> offsets, times;
+  std::vector<uint8_t> sources;
+  std::vector<uint16_t> masks;
+  std::vector<float> values[CHANNEL_COUNT];
+  uint64_t rows = 0;
+  uint64_t records = 0;
+  uint64_t dropped = 0;
+  bool done = false;
+};
+
+static void appendNumber(std::string &out, uint64_t value) {
+  char buf[24];
+  auto res = std::to_chars(buf, buf + sizeof(buf), value);
+  out.append(buf, res.ptr);
+}
+
+static void appendNumber(std::string &out, float value) {
+  char buf[32];
+  auto res = std::to_chars(buf, buf + sizeof(buf), value);  // Shortest text that reads back to the same float
+  out.append(buf, res.ptr);
+}
+
+class RowSink {
+ public:
+  RowSink(const Options &options, bool hasTime, ChunkResult &result)
+      : _options(options), _hasTime(hasTime), _result(result) {}
+
+  void emit(const Row &row) {
+    _result.rows++;
+    if (_options.format == OUTPUT_CSV) {
+      std::string &out = _result.text;
+      appendNumber(out, row.offset);
+      out += ',';
+      if (_hasTime) appendNumber(out, row.sample.timeUs);
+      out += ',';
+      appendNumber(out, (uint64_t)row.source);
+      for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+        out += ',';
+        if (row.sample.validMask & (1 << ch)) appendNumber(out, row.sample.value[ch]);
+      }
+      out += '\n';
+    } else if (_options.format == OUTPUT_JSON) {
+      std::string &out = _result.text;
+      out += "{\"offset\":";
+      appendNumber(out, row.offset);
+      if (_hasTime) {
+        out += ",\"time_us\":";
+        appendNumber(out, row.sample.timeUs);
+      }
+      out += ",\"source\":";
+      appendNumber(out, (uint64_t)row.source);
+      for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+        if (!(row.sample.validMask & (1 << ch))) continue;
+        out += ",\"";
+        out += CHANNEL_NAMES[ch];
+        out += "\":";
+        appendNumber(out, row.sample.value[ch]);
+      }
+      out += "}\n";
+    } else {
+      _result.offsets.push_back(row.offset);
+      _result.times.push_back(row.sample.timeUs);
+      _result.sources.push_back(row.source);
+      _result.masks.push_back(row.sample.validMask);
+      for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+        _result.values[ch].push_back((row.sample.validMask & (1 << ch)) ? row.sample.value[ch] : NAN);
+      }
+    }
+  }
+
+ private:
+  const Options &_options;
+  bool _hasTime;
+  ChunkResult &_result;
+};
+
+// Emits a row for every frame of a raw capture window that starts inside [begin, end)
+static void emitFrames(const KLineFrameSplitter &splitter, uint64_t streamOffset, uint64_t begin, uint64_t end,
+                       RowSink &sink, ChunkResult &result, bool &pastEnd) {
+  for (uint8_t f = 0; f < splitter.frameCount(); f++) {
+    uint64_t offset = streamOffset + splitter.frame(f).offset;
+    if (offset >= end) {
+      pastEnd = true;
+      return;
+    }
+    if (offset < begin) continue;
+
+    result.records++;
+    Row row = {offset, splitter.frame(f).source, {0, 0, {0}}};
+    if (decodeFrameData(splitter.data(f), splitter.frame(f).dataLength, row.sample)) sink.emit(row);
+  }
+}
+
+// Aligned output: a chunk emits the grid rows from the time of its first
+// record up to the time of the next chunk's first record. Records past the
+// chunk end are read until those rows are out, the ones before it only feed
+// the aligner, so the rows come out the same however the file is cut.
+static void decodeKlogChunk(const uint8_t *base, size_t size, size_t begin, size_t end, const Options &options,
+                            RowSink &sink, ChunkResult &result) {
+  bool aligned = options.gridUs > 0;
+  size_t leadIn = aligned ? ALIGN_LEAD_IN : LEAD_IN;
+  size_t pos = begin > leadIn + KLOG_FILE_HEADER_SIZE ? begin - leadIn : KLOG_FILE_HEADER_SIZE;
+  KLineFrameSplitter splitter;
+
+  ChannelAligner aligner;
+  aligner.setMode(options.align);
+  aligner.setGrid(options.gridUs, ALIGN_LATENCY_US);
+  bool started = false, ended = false;
+  uint64_t startUs = 0, endUs = 0;
+  uint64_t lastPos = pos;
+
+  // Emits the grid rows that are ready, true once past the chunk
+  auto emitGrid = [&](bool flush) {
+    Row row = {lastPos, 0, {0, 0, {0}}};
+    while (aligner.next(row.sample, flush)) {
+      if (ended && row.sample.timeUs >= endUs) return true;
+      if (started && row.sample.timeUs >= startUs) sink.emit(row);
+    }
+    return false;
+  };
+
+  while (pos < size && (aligned || pos < end)) {
+    KLogRecord record;
+    int n = parseLogRecord(base + pos, size - pos, record);
+    if (n == 0) break;  // Cut-off record at the end of the file
+    if (n < 0) {
+      if (pos >= begin && pos < end) result.dropped++;
+      pos++;
+      continue;
+    }
+
+    bool hasRows = (record.type == KLOG_FRAME && record.length > 1) || record.type == KLOG_SAMPLES;
+    if (hasRows && (aligned || pos >= begin)) {
+      if (pos >= end && !ended) {
+        ended = true;
+        endUs = record.timeUs;
+      }
+      if (pos >= begin && !started) {
+        started = true;
+        startUs = record.timeUs;
+      }
+      if (pos >= begin && pos < end) result.records++;
+
+      if (record.type == KLOG_SAMPLES) {
+        // Samples decoded on the reader already, source 0. A block holds
+        // more readings than the aligner keeps, so its rows go out as it goes.
+        SampleDecoder decoder;
+        Row row = {pos, 0, {0, 0, {0}}};
+        decoder.begin(record.payload, record.length);
+        lastPos = pos;
+        while (decoder.next(row.sample)) {
+          if (!aligned) {
+            sink.emit(row);
+            continue;
+          }
+          aligner.push(row.sample);
+          if (emitGrid(false)) return;
+        }
+      } else {
+        // Each record holds one answer, decode all of its frames
+        splitter.begin((KLineFraming)record.payload[0], record.payload + 1);
+        splitter.feed(record.length - 1, true);
+        for (uint8_t f = 0; f < splitter.frameCount(); f++) {
+          Row row = {pos, splitter.frame(f).source, {record.timeUs, 0, {0}}};
+          if (!decodeFrameData(splitter.data(f), splitter.frame(f).dataLength, row.sample)) continue;
+          if (aligned) aligner.push(row.sample);
+          else sink.emit(row);
+        }
+      }
+
+      lastPos = pos;
+      if (aligned && emitGrid(false)) return;
+    }
+    pos += n;
+  }
+  if (aligned) emitGrid(true);
+}
+
+static void decodeRawChunk(const uint8_t *base, size_t size, size_t begin, size_t end, KLineFraming framing,
+                           RowSink &sink, ChunkResult &result) {
+  size_t pos = begin > LEAD_IN ? begin - LEAD_IN : 0;
+  KLineFrameSplitter splitter;
+  bool pastEnd = false;
+
+  while (pos < end && !pastEnd) {
+    size_t window = size - pos < RAW_WINDOW ? size - pos : RAW_WINDOW;
+    bool last = pos + window == size;
+
+    splitter.begin(framing, base + pos);
+    splitter.feed(window, last);
+    emitFrames(splitter, pos, begin, end, sink, result, pastEnd);
+    if (pos >= begin) result.dropped += splitter.droppedBytes();
+
+    size_t consumed = splitter.consumed();
+    if (consumed == 0) {
+      if (last) break;
+      consumed = 1;
+    }
+    pos += consumed;
+  }
+}
+
+static bool writeAll(FILE *out, const void *data, size_t length) {
+  return length == 0 || fwrite(data, 1, length, out) == length;
+}
+
+static bool writeColumnsHeader(FILE *out) {
+  uint8_t header[6] = {'K', 'C', 'O', 'L', 1, CHANNEL_COUNT};
+  if (!writeAll(out, header, sizeof(header))) return false;
+  for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+    if (!writeAll(out, CHANNEL_NAMES[ch], strlen(CHANNEL_NAMES[ch]) + 1)) return false;
+  }
+  return true;
+}
+
+// Block: <rows u32> <offset u64[rows]> <time_us u64[rows]> <source u8[rows]>
+//        <valid mask u16[rows]> <value f32[rows]> per channel (NaN = no reading)
+static bool writeColumnsBlock(FILE *out, const ChunkResult &result) {
+  uint32_t rows = result.offsets.size();
+  if (rows == 0) return true;
+  bool ok = writeAll(out, &rows, sizeof(rows)) &&
+            writeAll(out, result.offsets.data(), rows * sizeof(uint64_t)) &&
+            writeAll(out, result.times.data(), rows * sizeof(uint64_t)) &&
+            writeAll(out, result.sources.data(), rows * sizeof(uint8_t)) &&
+            writeAll(out, result.masks.data(), rows * sizeof(uint16_t));
+  for (uint8_t ch = 0; ch < CHANNEL_COUNT && ok; ch++) {
+    ok = writeAll(out, result.values[ch].data(), rows * sizeof(float));
+  }
+  return ok;
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: klconvert [options] <input>\n"
+          "  -i klog|raw             input kind (default: klog if the file has a KLOG header, else raw)\n"
+          "  -p kwp|iso9141|honda    framing of a raw capture (default kwp)\n"
+          "  -f csv|json|columns     output format (default csv)\n"
+          "  -o <file>               output file (default stdout)\n"
+          "  -j <threads>            decoder threads (default: all cores)\n"
+          "  -c <MiB>                chunk size per task (default 8)\n"
+          "  -g <ms>                 .klog only: a row every <ms> with all channels aligned to it\n"
+          "  -a linear|hold          how -g fills a channel between readings (default linear)\n");
+}
+
+static bool parseOptions(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+
+    if (arg[0] != '-') {
+      options.inPath = arg;
+      continue;
+    }
+
+    // Value either attached ("-j4") or in the next argument ("-j 4")
+    char flag[3] = {arg[0], arg[1], '\0'};
+    const char *value = arg[1] && arg[2] ? arg + 2 : (i + 1 < argc ? argv[++i] : nullptr);
+    if (!value) return false;
+    arg = flag;
+
+    if (strcmp(arg, "-i") == 0) {
+      if (strcmp(value, "klog") == 0) options.input = INPUT_KLOG;
+      else if (strcmp(value, "raw") == 0) options.input = INPUT_RAW;
+      else return false;
+      options.inputGiven = true;
+    } else if (strcmp(arg, "-p") == 0) {
+      if (strcmp(value, "kwp") == 0) options.framing = FRAMING_KWP2000;
+      else if (strcmp(value, "iso9141") == 0) options.framing = FRAMING_ISO9141;
+      else if (strcmp(value, "honda") == 0) options.framing = FRAMING_HONDA;
+      else return false;
+    } else if (strcmp(arg, "-f") == 0) {
+      if (strcmp(value, "csv") == 0) options.format = OUTPUT_CSV;
+      else if (strcmp(value, "json") == 0) options.format = OUTPUT_JSON;
+      else if (strcmp(value, "columns") == 0) options.format = OUTPUT_COLUMNS;
+      else return false;
+    } else if (strcmp(arg, "-o") == 0) {
+      options.outPath = value;
+    } else if (strcmp(arg, "-j") == 0) {
+      options.threads = atoi(value);
+    } else if (strcmp(arg, "-c") == 0) {
+      options.chunkSize = (size_t)atoi(value) << 20;
+      if (options.chunkSize == 0) return false;
+    } else if (strcmp(arg, "-g") == 0) {
+      options.gridUs = (uint32_t)(atof(value) * 1000);
+      if (options.gridUs == 0) return false;
+    } else if (strcmp(arg, "-a") == 0) {
+      if (strcmp(value, "linear") == 0) options.align = ALIGN_LINEAR;
+      else if (strcmp(value, "hold") == 0) options.align = ALIGN_HOLD;
+      else return false;
+    } else {
+      return false;
+    }
+  }
+  return options.inPath != nullptr;
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    usage();
+    return 2;
+  }
+
+  int fd = open(options.inPath, O_RDONLY);
+  if (fd < 0) {
+    perror(options.inPath);
+    return 1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    perror(options.inPath);
+    return 1;
+  }
+  size_t size = st.st_size;
+
+  const uint8_t *base = nullptr;
+  if (size > 0) {
+    void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+      perror("mmap");
+      return 1;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+    base = (const uint8_t *)map;
+  }
+
+  bool isKlog = isLogFileHeader(base, size);
+  if (!options.inputGiven) options.input = isKlog ? INPUT_KLOG : INPUT_RAW;
+  if (options.input == INPUT_KLOG && !isKlog) {
+    fprintf(stderr, "%s: not a .klog file (use -i raw for a byte capture)\n", options.inPath);
+    return 1;
+  }
+  if (options.gridUs && options.input != INPUT_KLOG) {
+    fprintf(stderr, "%s: -g needs a .klog, a raw capture has no times\n", options.inPath);
+    return 1;
+  }
+
+  FILE *out = options.outPath ? fopen(options.outPath, "wb") : stdout;
+  if (!out) {
+    perror(options.outPath);
+    return 1;
+  }
+
+  bool hasTime = options.input == INPUT_KLOG;
+  bool ok = true;
+  if (options.format == OUTPUT_CSV) {
+    std::string header = "offset,time_us,source";
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+      header += ',';
+      header += CHANNEL_NAMES[ch];
+    }
+    header += '\n';
+    ok = writeAll(out, header.data(), header.size());
+  } else if (options.format == OUTPUT_COLUMNS) {
+    ok = writeColumnsHeader(out);
+  }
+
+  size_t dataStart = options.input == INPUT_KLOG ? KLOG_FILE_HEADER_SIZE : 0;
+  size_t chunkCount = size > dataStart ? (size - dataStart + options.chunkSize - 1) / options.chunkSize : 0;
+  unsigned threadCount = options.threads ? options.threads : std::thread::hardware_concurrency();
+  if (threadCount == 0) threadCount = 1;
+
+  // Workers take chunks in order; at most 2 chunks per thread are decoded
+  // ahead of the writer so memory stays bounded however big the input is
+  std::vector<ChunkResult> results(chunkCount);
+  std::atomic<size_t> nextChunk(0);
+  size_t written = 0;
+  std::mutex lock;
+  std::condition_variable changed;
+  const size_t ahead = 2 * threadCount;
+
+  auto started = std::chrono::steady_clock::now();
+
+  auto worker = [&]() {
+    for (;;) {
+      size_t index = nextChunk++;
+      if (index >= chunkCount) return;
+      {
+        std::unique_lock<std::mutex> guard(lock);
+        changed.wait(guard, [&] { return index < written + ahead; });
+      }
+
+      size_t begin = dataStart + index * options.chunkSize;
+      size_t end = begin + options.chunkSize < size ? begin + options.chunkSize : size;
+      ChunkResult &result = results[index];
+      RowSink sink(options, hasTime, result);
+
+      if (options.input == INPUT_KLOG) {
+        decodeKlogChunk(base, size, begin, end, options, sink, result);
+      } else {
+        decodeRawChunk(base, size, begin, end, options.framing, sink, result);
+      }
+
+      std::lock_guard<std::mutex> guard(lock);
+      result.done = true;
+      changed.notify_all();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threadCount && t < chunkCount; t++) workers.emplace_back(worker);
+
+  uint64_t records = 0, rows = 0, dropped = 0;
+  for (size_t index = 0; index < chunkCount; index++) {
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      changed.wait(guard, [&] { return results[index].done; });
+    }
+
+    ChunkResult &result = results[index];
+    if (ok) {
+      ok = options.format == OUTPUT_COLUMNS ? writeColumnsBlock(out, result)
+                                            : writeAll(out, result.text.data(), result.text.size());
+    }
+    records += result.records;
+    dropped += result.dropped;
+    rows += result.rows;
+    result = ChunkResult();
+    result.done = true;
+
+    std::lock_guard<std::mutex> guard(lock);
+    written = index + 1;
+    changed.notify_all();
+  }
+
+  for (auto &thread : workers) thread.join();
+  if (out != stdout) ok = (fclose(out) == 0) && ok;
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  fprintf(stderr, "%s: %zu bytes, %llu %s, %llu rows, %llu dropped, %u threads, %.1f MB/s\n", options.inPath, size,
+          (unsigned long long)records, options.input == INPUT_KLOG ? "records" : "frames", (unsigned long long)rows,
+          (unsigned long long)dropped, threadCount, seconds > 0 ? size / seconds / 1e6 : 0.0);
+
+  if (base) munmap((void *)base, size);
+  close(fd);
+
+  if (!ok) {
+    fprintf(stderr, "write error\n");
+    return 1;
+  }
+  return 0;
+}
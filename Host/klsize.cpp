@@ -0,0 +1,81 @@
+// klsize - RAM taken by one OBD2_KLine with the KLineConfig.h settings it was built with
+//
+// `make sizes` links it once per configuration with the reader sources and
+// -Wl,--gc-sections, and once as a baseline without the reader calls; the
+// difference is what the reader adds to a program. The calls below run only
+// with an argument no one passes, they keep the linker from dropping the code.
+// Pointers, String and alignment are those of the host, an AVR build comes
+// out smaller but in the same ratio.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "OBD2_KLine.h"
+
+// The Arduino core calls the reader makes, in both builds, so the core's
+// share is in the baseline and drops out of the difference
+static long useCore() {
+  Serial1.begin(10400, SERIAL_8N1, 16, 17);
+  Serial1.write((uint8_t)0x00);
+  long sink = Serial1.available() + Serial1.read();
+  Serial1.end();
+  pinMode(16, INPUT_PULLDOWN);
+  pinMode(17, OUTPUT);
+  digitalWrite(17, HIGH);
+  delay(1);
+  Serial.print(F("x"));
+  Serial.println(F("x"));
+  Serial.print("x");
+  Serial.println("x");
+  Serial.print(sink, HEX);
+  return sink + millis() + micros();
+}
+
+#ifndef KLSIZE_BASELINE
+// The public API a sketch uses, in this configuration
+static float useReader() {
+  OBD2_KLine kline(Serial1, 10400, 16, 17);
+  if (!kline.initOBD2()) return 0;
+
+  float sink = kline.getLiveData(0x0C) + kline.getFreezeFrame(0x05);
+  HondaLiveData data;
+  sink += kline.getHondaLiveData(0x17, data);
+  uint16_t codes[8];
+  sink += kline.readDTCCodes(0x03, codes, 8) + kline.clearDTCs();
+  LiveSample sample = {};
+  sink += kline.readLocalIdentifier(0x01, sample);
+  sink += kline.lastResponse().frames().frameCount();
+#if KLINE_DTC_STORAGE
+  sink += kline.readStoredDTCs() + kline.getStoredDTC(0).length();
+#endif
+#if KLINE_VEHICLE_INFO
+  sink += kline.getVehicleInfo(0x02).length();
+#endif
+#if KLINE_SUPPORTED_PIDS
+  sink += kline.readSupportedLiveData();
+#endif
+  return sink;
+}
+#endif
+
+int main(int argc, char **argv) {
+  const char *name = argc > 1 ? argv[1] : "default";
+  if (argc > 2 && strcmp(argv[2], "--run-core") == 0) return useCore() > 0;
+#ifndef KLSIZE_BASELINE
+  if (argc > 2 && strcmp(argv[2], "--run-reader") == 0) return useReader() > 0;
+#endif
+
+  size_t dtcText = 0;
+#if KLINE_DTC_STORAGE
+  dtcText = 2 * KLINE_MAX_DTCS * sizeof(String);
+#endif
+  size_t pidBitmaps = 0;
+#if KLINE_SUPPORTED_PIDS
+  pidBitmaps = sizeof(SupportedPids);
+#endif
+
+  printf("%-10s RAM %5zu B  frame pool %5zu (%d x %d B + %d frames)  DTC text %4zu  PID bitmaps %3zu  debug %s\n",
+         name, sizeof(OBD2_KLine), sizeof(FramePool), FRAME_POOL_SIZE, FRAME_BUFFER_SIZE, KLINE_MAX_FRAMES, dtcText,
+         pidBitmaps, KLINE_DEBUG ? "on" : "off");
+  return 0;
+}
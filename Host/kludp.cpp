@@ -0,0 +1,188 @@
+// kludp - listens to the reader's UDP sample stream (UdpStream.h)
+//
+// Subscribes to the reader with "SUB" (renewed every couple of seconds) or
+// just listens for broadcast datagrams, prints every sample and reports the
+// samples lost on the way from the sequence numbers (LossCounter). Takes a
+// datagram per sample and compressed block datagrams alike.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "LiveChannels.h"
+#include "SamplePacket.h"
+
+enum ListenMode { LISTEN_SUBSCRIBE, LISTEN_BROADCAST };
+enum OutputFormat { OUTPUT_TEXT, OUTPUT_JSON, OUTPUT_QUIET };
+
+struct Options {
+  const char *address = "192.168.4.1";
+  uint16_t port = 3334;
+  ListenMode mode = LISTEN_SUBSCRIBE;
+  uint16_t localPort = 0;  // 0 = any port (subscribe), the stream port (broadcast)
+  double seconds = 0;      // 0 = until Ctrl-C
+  OutputFormat format = OUTPUT_TEXT;
+};
+
+static const int RENEW_MS = 2000;  // Well inside the reader's UDP_SUBSCRIPTION_MS
+
+static volatile sig_atomic_t stopping = 0;
+
+static void onSignal(int) {
+  stopping = 1;
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: kludp [options]\n"
+          "  -a <address>            reader address (default 192.168.4.1)\n"
+          "  -p <port>               reader stream port (default 3334)\n"
+          "  -m sub|bcast            subscribe to the reader or listen for broadcasts (default sub)\n"
+          "  -l <port>               local port (default: any for sub, the stream port for bcast)\n"
+          "  -t <seconds>            stop after this long (default: until Ctrl-C)\n"
+          "  -f text|json|quiet      output per sample (default text); loss stats go to stderr\n");
+}
+
+static bool parseOptions(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (arg[0] != '-') return false;
+
+    // Value either attached ("-p3334") or in the next argument ("-p 3334")
+    char flag[3] = {arg[0], arg[1], '\0'};
+    const char *value = arg[1] && arg[2] ? arg + 2 : (i + 1 < argc ? argv[++i] : nullptr);
+    if (!value) return false;
+    arg = flag;
+
+    if (strcmp(arg, "-a") == 0) {
+      options.address = value;
+    } else if (strcmp(arg, "-p") == 0) {
+      options.port = atoi(value);
+    } else if (strcmp(arg, "-m") == 0) {
+      if (strcmp(value, "sub") == 0) options.mode = LISTEN_SUBSCRIBE;
+      else if (strcmp(value, "bcast") == 0) options.mode = LISTEN_BROADCAST;
+      else return false;
+    } else if (strcmp(arg, "-l") == 0) {
+      options.localPort = atoi(value);
+    } else if (strcmp(arg, "-t") == 0) {
+      options.seconds = atof(value);
+    } else if (strcmp(arg, "-f") == 0) {
+      if (strcmp(value, "text") == 0) options.format = OUTPUT_TEXT;
+      else if (strcmp(value, "json") == 0) options.format = OUTPUT_JSON;
+      else if (strcmp(value, "quiet") == 0) options.format = OUTPUT_QUIET;
+      else return false;
+    } else {
+      return false;
+    }
+  }
+  return options.port != 0;
+}
+
+static void printSample(const Options &options, uint32_t sequence, const LiveSample &sample) {
+  if (options.format == OUTPUT_TEXT) {
+    char line[256];
+    formatSample(sample, line, sizeof(line));
+    printf("#%u %s\n", sequence, line);
+  } else if (options.format == OUTPUT_JSON) {
+    printf("{\"seq\":%u,\"time_us\":%llu", sequence, (unsigned long long)sample.timeUs);
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+      if (sample.validMask & (1 << ch)) printf(",\"%s\":%g", CHANNEL_NAMES[ch], sample.value[ch]);
+    }
+    printf("}\n");
+  }
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    usage();
+    return 2;
+  }
+
+  sockaddr_in reader = {};
+  reader.sin_family = AF_INET;
+  reader.sin_port = htons(options.port);
+  if (inet_pton(AF_INET, options.address, &reader.sin_addr) != 1) {
+    fprintf(stderr, "%s: not an IPv4 address\n", options.address);
+    return 2;
+  }
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    perror("socket");
+    return 1;
+  }
+  int enable = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+  sockaddr_in local = {};
+  local.sin_family = AF_INET;
+  local.sin_addr.s_addr = htonl(INADDR_ANY);
+  uint16_t localPort = options.localPort || options.mode == LISTEN_SUBSCRIBE ? options.localPort : options.port;
+  local.sin_port = htons(localPort);
+  if (bind(fd, (sockaddr *)&local, sizeof(local)) < 0) {
+    perror("bind");
+    return 1;
+  }
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  auto subscribe = [&](const char *message) {
+    if (options.mode != LISTEN_SUBSCRIBE) return;
+    if (sendto(fd, message, strlen(message), 0, (sockaddr *)&reader, sizeof(reader)) < 0) perror("sendto");
+  };
+
+  using Clock = std::chrono::steady_clock;
+  auto started = Clock::now();
+  auto renewAt = started;
+  LossCounter loss;
+  uint64_t bytes = 0;
+
+  while (!stopping) {
+    auto now = Clock::now();
+    if (options.seconds > 0 && std::chrono::duration<double>(now - started).count() >= options.seconds) break;
+    if (now >= renewAt) {
+      subscribe("SUB");
+      renewAt = now + std::chrono::milliseconds(RENEW_MS);
+    }
+
+    pollfd waiting = {fd, POLLIN, 0};
+    if (poll(&waiting, 1, 100) <= 0) continue;
+
+    uint8_t packet[1472];
+    ssize_t n = recv(fd, packet, sizeof(packet), 0);
+    uint32_t sequence;
+    LiveSample sample;
+    SampleDecoder block;
+    if (n <= 0) continue;
+    if (decodeSamplePacket(packet, n, sequence, sample)) {
+      loss.add(sequence);
+      printSample(options, sequence, sample);
+    } else if (decodeSampleBlockPacket(packet, n, sequence, block)) {
+      for (; block.next(sample); sequence++) {
+        loss.add(sequence);
+        printSample(options, sequence, sample);
+      }
+    } else {
+      continue;
+    }
+    bytes += n;
+  }
+  subscribe("UNSUB");
+  close(fd);
+  fflush(stdout);
+
+  fprintf(stderr, "received %u, lost %u (%.2f%%), late %u, duplicates %u, restarts %u, %.1f bytes/sample\n",
+          loss.received(), loss.lost(), loss.lossRatio() * 100.0f, loss.late(), loss.duplicates(), loss.restarts(),
+          loss.received() ? (double)bytes / loss.received() : 0.0);
+  return 0;
+}